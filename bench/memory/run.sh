@@ -0,0 +1,92 @@
+#!/bin/sh
+# Memory footprint regression check. Starts the shell with each reference configuration (configs/)
+# under a headless sway with three simulated monitors, loads the static test frontend (frontend/) and
+# compares the settled PSS against the configuration's section in budgets.toml.
+# Runs all configurations and exits non-zero if any of them exceeded one of its budgets.
+#
+# Usage: run.sh <path to the wss binary> [configuration name...]
+# Needs sway, python3 (serves the frontend) and dbus-run-session. The shell's dispatch socket is fixed,
+# so this can't run next to another running shell.
+set -eu
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 <wss binary> [configuration name...]" >&2
+    exit 2
+fi
+
+# The shell registers D-Bus services (notifications, ...), keep them off the desktop's session bus.
+if [ -z "${WSS_BENCH_BUS:-}" ]; then
+    WSS_BENCH_BUS=1 exec dbus-run-session -- "$0" "$@"
+fi
+
+wss=$(realpath "$1")
+shift
+here=$(dirname "$(realpath "$0")")
+if [ $# -eq 0 ]; then
+    set -- 1-widget 4-widgets 12-widgets
+fi
+
+work=$(mktemp -d)
+pids=""
+cleanup() {
+    for pid in $pids; do
+        kill "$pid" 2>/dev/null || true
+    done
+    wait 2>/dev/null || true
+    rm -rf "$work"
+}
+trap cleanup EXIT INT TERM
+
+# Waits up to $2 seconds for the command $1 to succeed.
+wait_for() {
+    tries=$(($2 * 10))
+    while ! sh -c "$1" >/dev/null 2>&1; do
+        tries=$((tries - 1))
+        if [ "$tries" -le 0 ]; then
+            return 1
+        fi
+        sleep 0.1
+    done
+}
+
+export XDG_RUNTIME_DIR="$work/runtime"
+export XDG_CACHE_HOME="$work/cache"
+export XDG_DATA_HOME="$work/data"
+mkdir -m 700 "$XDG_RUNTIME_DIR"
+
+WLR_BACKENDS=headless WLR_HEADLESS_OUTPUTS=3 WLR_LIBINPUT_NO_DEVICES=1 sway -c /dev/null >"$work/sway.log" 2>&1 &
+pids="$pids $!"
+if ! wait_for "ls '$XDG_RUNTIME_DIR' | grep -q '^wayland-[0-9]*$'" 10; then
+    echo "The headless compositor did not start, see its log:" >&2
+    cat "$work/sway.log" >&2
+    exit 1
+fi
+WAYLAND_DISPLAY=$(ls "$XDG_RUNTIME_DIR" | grep '^wayland-[0-9]*$' | head -n 1)
+export WAYLAND_DISPLAY
+
+python3 -m http.server 39170 --bind 127.0.0.1 --directory "$here/frontend" >"$work/frontend.log" 2>&1 &
+pids="$pids $!"
+
+failed=0
+for name in "$@"; do
+    echo "== $name"
+    # Every configuration starts from a cold cache, like a fresh login.
+    rm -rf "$XDG_CACHE_HOME" "$XDG_DATA_HOME"
+
+    "$wss" start -c "$here/configs/$name.toml" >"$work/$name.log" 2>&1 &
+    shell=$!
+    if ! wait_for "'$wss' dispatch stats --json | grep -q renderers" 30; then
+        echo "The shell did not come up, see its log:" >&2
+        cat "$work/$name.log" >&2
+        kill "$shell" 2>/dev/null || true
+        exit 1
+    fi
+
+    if ! "$wss" dispatch bench memory --budget "$here/budgets.toml" --section "$name"; then
+        failed=1
+    fi
+    kill "$shell" 2>/dev/null || true
+    wait "$shell" 2>/dev/null || true
+done
+
+exit "$failed"
@@ -1,5 +1,49 @@
 #include "dispatcher.h"
 
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <thread>
+#include <zmq_addon.hpp>
+
+#include "fastpath.h"
+#include "util/dbus_vreader.h"
+#include "zmq_pub.h"
+
+/**
+ * Prints min, median, mean and max of latency samples in milliseconds.
+ */
+static void PrintLatencySummary(const std::string& label, std::vector<double> samples, const int iterations) {
+    if (samples.empty()) {
+        std::cerr << "No frame was presented within the timeout." << std::endl;
+        return;
+    }
+    std::ranges::sort(samples);
+
+    double total = 0;
+    for (const double sample : samples) {
+        total += sample;
+    }
+    std::cout << std::format("{}: {}/{} samples, min {:.2f} ms, median {:.2f} ms, mean {:.2f} ms, max {:.2f} ms", label,
+                             samples.size(), iterations, samples.front(), samples[samples.size() / 2], total / samples.size(),
+                             samples.back())
+              << std::endl;
+}
+
+json WSS::Dispatcher::Request(const std::string& type, const json& payload, const std::string& action, const int timeoutMs) {
+    json response = m_ZMQReq.Request(type, payload, timeoutMs);
+    if (response.value("status", "") != "success") {
+        std::cerr << "Failed to " << action << ": " << response.value("details", response.value("error", response.dump()))
+                  << std::endl;
+        throw CLI::RuntimeError(1);
+    }
+    WSS_DEBUG("{} took {:.2f} ms", type, response.value("durationMs", 0.0));
+    return response;
+}
+
 void WSS::Dispatcher::InitCommands(CLI::App& app) {
     const auto dispatch = app.add_subcommand("dispatch", "Run the WSS dispatch server");
 
@@ -12,7 +56,7 @@ void WSS::Dispatcher::InitCommands(CLI::App& app) {
 
         json payload = {{"widgetName", widgetName}, {"monitorId", monitorId}, {"visible", true}};
 
-        m_ZMQReq.Request("widget-set-visible", payload);
+        Request("widget-set-visible", payload, "show widget");
     });
 
     const auto hide = dispatch->add_subcommand("hide", "Hide a widget");
@@ -24,7 +68,7 @@ void WSS::Dispatcher::InitCommands(CLI::App& app) {
 
         json payload = {{"widgetName", widgetName}, {"monitorId", monitorId}, {"visible", false}};
 
-        m_ZMQReq.Request("widget-set-visible", payload);
+        Request("widget-set-visible", payload, "hide widget");
     });
 
     const auto toggle = dispatch->add_subcommand("toggle", "Toggle visibility of a widget");
@@ -36,6 +80,387 @@ void WSS::Dispatcher::InitCommands(CLI::App& app) {
 
         json payload = {{"widgetName", widgetName}, {"monitorId", monitorId}};
 
-        m_ZMQReq.Request("widget-toggle-visible", payload);
+        Request("widget-toggle-visible", payload, "toggle widget");
+    });
+
+    const auto spawn = dispatch->add_subcommand("spawn", "Spawn a widget from a template");
+    spawn->add_option("template", "The name of the template to spawn")->required();
+    spawn->add_option("name", "The name of the new widget (generated if omitted)");
+    spawn->add_option("-m,--monitor", "A monitor ID or name to spawn the widget on, repeatable (template's if omitted)")
+        ->multi_option_policy(CLI::MultiOptionPolicy::TakeAll);
+    spawn->callback([this, spawn]() {
+        std::string templateName = spawn->get_option("template")->as<std::string>();
+        std::string name = spawn->get_option("name")->empty() ? "" : spawn->get_option("name")->as<std::string>();
+
+        json monitors = json::array();
+        for (const auto& monitor : spawn->get_option("--monitor")->as<std::vector<std::string>>()) {
+            if (monitor.empty()) {
+                continue;
+            }
+            if (std::ranges::all_of(monitor, ::isdigit)) {
+                monitors.push_back(std::stoi(monitor));
+            } else {
+                monitors.push_back(monitor);
+            }
+        }
+
+        json payload = {{"template", templateName}, {"name", name}, {"monitors", monitors}};
+        json response = Request("widget-spawn", payload, "spawn widget");
+        std::cout << response["result"]["name"].get<std::string>() << std::endl;
+    });
+
+    const auto destroy = dispatch->add_subcommand("destroy", "Destroy a widget spawned from a template");
+    destroy->add_option("widget", "The name of the widget to destroy")->required();
+    destroy->callback([this, destroy]() {
+        std::string widgetName = destroy->get_option("widget")->as<std::string>();
+
+        json payload = {{"name", widgetName}};
+        Request("widget-destroy", payload, "destroy widget");
+    });
+
+    const auto batch = dispatch->add_subcommand("batch", "Apply several visibility changes at once");
+    batch->add_option("operations", "Changes as <show|hide|toggle>:<widget>[:<monitor>]")->required()->expected(1, -1);
+    batch->add_flag("-w,--wait", "Wait until the shown widgets presented their first frame");
+    batch->callback([this, batch]() {
+        json payload = {{"operations", batch->get_option("operations")->as<std::vector<std::string>>()},
+                        {"wait", batch->get_option("--wait")->as<bool>()}};
+        Request("widget-batch", payload, "apply batch", 6000);
+    });
+
+    const auto emit = dispatch->add_subcommand("emit", "Push a value to the widgets subscribed to a custom topic");
+    emit->add_option("topic", "The topic, pages receive it as \"custom:<topic>\"")->required();
+    emit->add_option("value", "The value as JSON, anything that isn't valid JSON is sent as a string")->required();
+    emit->callback([this, emit]() {
+        std::string topic = emit->get_option("topic")->as<std::string>();
+        std::string value = emit->get_option("value")->as<std::string>();
+
+        json payload = json::parse(value, nullptr, false);
+        if (payload.is_discarded()) {
+            payload = value;
+        }
+        Request("emit", {{"topic", topic}, {"payload", payload}}, "emit");
+    });
+
+    const auto subscribe = dispatch->add_subcommand("subscribe", "Stream events as newline-delimited JSON");
+    subscribe->add_option("topics", "Topics (or topic prefixes) to subscribe to, all events if omitted")->expected(0, -1);
+    subscribe->callback([subscribe]() {
+        auto topics = subscribe->get_option("topics")->empty()
+                          ? std::vector<std::string>{""}
+                          : subscribe->get_option("topics")->as<std::vector<std::string>>();
+
+        zmq::context_t context(1);
+        zmq::socket_t socket(context, zmq::socket_type::sub);
+        socket.connect(ZMQPub::GetEndpoint());
+        for (const auto& topic : topics) {
+            socket.set(zmq::sockopt::subscribe, topic);
+        }
+
+        // Runs until interrupted, a shell restart is picked up by ZMQ reconnecting on its own.
+        while (true) {
+            std::vector<zmq::message_t> frames;
+            if (!zmq::recv_multipart(socket, std::back_inserter(frames)) || frames.size() != 2) {
+                continue;
+            }
+            std::cout << frames[1].to_string_view() << std::endl;
+        }
+    });
+
+    const auto stats = dispatch->add_subcommand("stats", "Show the renderer resource usage of all widgets");
+    stats->add_flag("-j,--json", "Print the raw JSON response");
+    stats->callback([this, stats]() {
+        json response = m_ZMQReq.Request("stats", json::object());
+        if (!response.contains("result")) {
+            std::cerr << "Failed to get stats: " << response.dump() << std::endl;
+            return;
+        }
+        const json& result = response["result"];
+        if (stats->get_option("--json")->as<bool>()) {
+            std::cout << result.dump(2) << std::endl;
+            return;
+        }
+
+        std::cout << std::format("{:<32} {:>7} {:>8} {:>10} {:>7} {:>8}", "WIDGET", "MONITOR", "PID", "RSS (MB)", "CPU %",
+                                 "RECYCLES")
+                  << std::endl;
+        for (const auto& entry : result["widgets"]) {
+            std::cout << std::format("{:<32} {:>7} {:>8} {:>10.1f} {:>7.1f} {:>8}", entry["widget"].get<std::string>(),
+                                     entry["monitorId"].get<int>(), entry["pid"].get<int64_t>(),
+                                     entry["rss"].get<uint64_t>() / (1024.0 * 1024.0), entry["cpu"].get<double>(),
+                                     entry["recycles"].get<uint32_t>())
+                      << std::endl;
+        }
+        std::cout << std::format("{} renderers, {:.1f} MB total", result["renderers"].get<size_t>(),
+                                 result["totalRss"].get<uint64_t>() / (1024.0 * 1024.0))
+                  << std::endl;
+    });
+
+    const auto dnd = dispatch->add_subcommand("dnd", "Turn do-not-disturb for notifications on or off");
+    dnd->add_option("state", "on, off, toggle or status")
+        ->default_val("status")
+        ->check(CLI::IsMember({"on", "off", "toggle", "status"}));
+    dnd->callback([this, dnd]() {
+        const std::string state = dnd->get_option("state")->as<std::string>();
+        json payload = json::object();
+        if (state == "toggle") {
+            payload["toggle"] = true;
+        } else if (state != "status") {
+            payload["enabled"] = state == "on";
+        }
+        json response = Request("notifd-dnd", payload, "change do-not-disturb");
+        std::cout << (response["result"]["enabled"].get<bool>() ? "on" : "off") << std::endl;
+    });
+
+    InitBenchCommands(dispatch);
+}
+
+void WSS::Dispatcher::InitBenchCommands(CLI::App* dispatch) {
+    const auto bench = dispatch->add_subcommand("bench", "Run benchmarks against the running shell");
+    bench->require_subcommand(1);
+
+    const auto showLatency =
+        bench->add_subcommand("show-latency", "Measure the time from dispatch until a widget presents its first frame");
+    showLatency->add_option("widget", "The name of the widget to measure")->required();
+    showLatency->add_option("monitor", "The monitor ID of the widget to measure")->default_val(0);
+    showLatency->add_option("-n,--iterations", "How many times to hide and show the widget")->default_val(20);
+    showLatency->callback([this, showLatency]() {
+        std::string widgetName = showLatency->get_option("widget")->as<std::string>();
+        int monitorId = showLatency->get_option("monitor")->as<int>();
+        int iterations = showLatency->get_option("--iterations")->as<int>();
+
+        json payload = {{"widgetName", widgetName}, {"monitorId", monitorId}, {"iterations", iterations}};
+        json response = m_ZMQReq.Request("widget-benchmark-show", payload, iterations * 3500);
+        if (!response.contains("result")) {
+            std::cerr << "Benchmark failed: " << response.dump() << std::endl;
+            return;
+        }
+
+        std::vector<double> samples;
+        for (const auto& sample : response["result"]["samples"]) {
+            if (sample.get<double>() >= 0) {
+                samples.push_back(sample.get<double>());
+            }
+        }
+        PrintLatencySummary(std::format("{} ({} mode)", widgetName, response["result"]["showMode"].get<std::string>()),
+                            samples, iterations);
+    });
+
+    const auto keybind = bench->add_subcommand(
+        "keybind", "Measure the time from starting the keybind client until a widget presents its first frame");
+    keybind->add_option("widget", "The name of the widget to measure")->required();
+    keybind->add_option("monitor", "The monitor ID of the widget to measure")->default_val(0);
+    keybind->add_option("-n,--iterations", "How many times to hide and show the widget")->default_val(20);
+    keybind->add_option("--client", "The client to start, as a keybind would")->default_val("wssctl");
+    keybind->callback([keybind]() {
+        std::string widgetName = keybind->get_option("widget")->as<std::string>();
+        std::string monitor = std::to_string(keybind->get_option("monitor")->as<int>());
+        int iterations = keybind->get_option("--iterations")->as<int>();
+        std::string client = keybind->get_option("--client")->as<std::string>();
+
+        std::vector<double> samples;
+        for (int i = 0; i < iterations; i++) {
+            // Give the compositor time to actually unmap the surface before measuring the next show.
+            if (FastPath::Request("hide:" + widgetName + ":" + monitor) != "ok") {
+                std::cerr << "Failed to hide the widget through " << FastPath::GetSocketPath() << std::endl;
+                throw CLI::RuntimeError(1);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+            std::vector<std::string> args = {client, "-w", "show", widgetName, monitor};
+            std::vector<char*> argv;
+            for (auto& arg : args) {
+                argv.push_back(arg.data());
+            }
+            argv.push_back(nullptr);
+
+            const auto start = std::chrono::steady_clock::now();
+            pid_t pid = 0;
+            int status = 0;
+            if (posix_spawnp(&pid, client.c_str(), nullptr, nullptr, argv.data(), environ) != 0 ||
+                waitpid(pid, &status, 0) < 0) {
+                std::cerr << "Failed to start " << client << std::endl;
+                throw CLI::RuntimeError(1);
+            }
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+
+        PrintLatencySummary(std::format("{} via {}", widgetName, client), samples, iterations);
+    });
+
+    const auto notifyFlood = bench->add_subcommand(
+        "notify-flood", "Send a burst of notifications over D-Bus and report the thread count of the shell");
+    notifyFlood->add_option("-n,--count", "How many notifications to send")->default_val(500);
+    notifyFlood->callback([this, notifyFlood]() {
+        const int count = notifyFlood->get_option("--count")->as<int>();
+
+        const auto status = [this]() { return Request("notifd-status", json::object(), "get the notifd status")["result"]; };
+        const json before = status();
+
+        auto proxy = sdbus::createProxy(sdbus::ServiceName{"org.freedesktop.Notifications"},
+                                        sdbus::ObjectPath{"/org/freedesktop/Notifications"});
+        int peakThreads = before["threads"].get<int>();
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            uint32_t id = 0;
+            proxy->callMethod("Notify")
+                .onInterface("org.freedesktop.Notifications")
+                .withArguments(std::string("wss-bench"), uint32_t{0}, std::string(), std::format("Flood {}", i), std::string(),
+                               std::vector<std::string>{}, std::map<std::string, sdbus::Variant>{}, int32_t{-1})
+                .storeResultsTo(id);
+            if (i % 50 == 49) {
+                peakThreads = std::max(peakThreads, status()["threads"].get<int>());
+            }
+        }
+        const double sendMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const json flooded = status();
+        peakThreads = std::max(peakThreads, flooded["threads"].get<int>());
+
+        // The shell applies its notification_timeout setting to every notification, wait until all of them expired.
+        json after = flooded;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while (after["pendingExpiries"].get<size_t>() > before["pendingExpiries"].get<size_t>() &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            after = status();
+            peakThreads = std::max(peakThreads, after["threads"].get<int>());
+        }
+
+        std::cout << std::format("Sent {} notifications in {:.1f} ms, {} pending expiries", count, sendMs,
+                                 flooded["pendingExpiries"].get<size_t>())
+                  << std::endl;
+        std::cout << std::format("Threads: {} before, {} peak, {} after expiry", before["threads"].get<int>(), peakThreads,
+                                 after["threads"].get<int>())
+                  << std::endl;
+    });
+
+    const auto dbusHints = bench->add_subcommand(
+        "dbus-hints", "Measure the conversion of typical notification hints from D-Bus variants to JSON");
+    dbusHints->add_option("-n,--iterations", "How many times to convert the hints")->default_val(100000);
+    dbusHints->add_option("--image-size", "Edge length of the image-data hint in pixels")->default_val(64);
+    dbusHints->add_flag("-p,--print", "Print the converted hints once");
+    dbusHints->callback([dbusHints]() {
+        const int iterations = dbusHints->get_option("--iterations")->as<int>();
+        const int size = dbusHints->get_option("--image-size")->as<int>();
+
+        // The hints a chat client typically sends: urgency, category, sound, an image and a vendor dictionary.
+        const std::map<std::string, sdbus::Variant> hints = {
+            {"urgency", sdbus::Variant(uint8_t{1})},
+            {"category", sdbus::Variant(std::string("im.received"))},
+            {"desktop-entry", sdbus::Variant(std::string("org.example.Chat"))},
+            {"transient", sdbus::Variant(false)},
+            {"x", sdbus::Variant(int32_t{1280})},
+            {"sound-file", sdbus::Variant(sdbus::ObjectPath("/usr/share/sounds/message"))},
+            {"image-data", sdbus::Variant(sdbus::Struct<int32_t, int32_t, int32_t, bool, int32_t, int32_t, std::vector<uint8_t>>(
+                               size, size, size * 4, true, 8, 4, std::vector<uint8_t>(size * size * 4, 0x7f)))},
+            {"x-vendor", sdbus::Variant(std::map<std::string, sdbus::Variant>{
+                             {"thread", sdbus::Variant(uint64_t{42})}, {"tags", sdbus::Variant(std::vector<std::string>{"a", "b"})}})},
+        };
+
+        size_t converted = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            converted += ReadDbusMap(hints).size();
+        }
+        const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (dbusHints->get_option("--print")->as<bool>()) {
+            json printed = ReadDbusMap(hints);
+            printed["image-data"][6] = std::format("<{} bytes>", printed["image-data"][6].size());
+            std::cout << printed.dump(2) << std::endl;
+        }
+        std::cout << std::format("{} conversions of {} hints in {:.1f} ms, {:.2f} us per conversion", iterations,
+                                 converted / std::max(iterations, 1), totalMs, totalMs * 1000.0 / std::max(iterations, 1))
+                  << std::endl;
+    });
+
+    const auto memory = bench->add_subcommand(
+        "memory", "Wait for all pages to settle, then report the PSS of the shell and its web engine processes");
+    memory->add_option("-b,--budget", "TOML file with budgets in MB: total_mb, browser_mb, gpu_mb, renderer_mb, utility_mb")
+        ->check(CLI::ExistingFile);
+    memory->add_option("-s,--section", "Table of the budget file to compare against, e.g. one per reference configuration");
+    memory->add_option("-t,--timeout", "Seconds to wait for the pages to settle")->default_val(60);
+    memory->add_option("--settle-ms", "Interval in which the total may change by less than 1% to count as settled")
+        ->default_val(2000);
+    memory->add_flag("-j,--json", "Print the raw JSON report");
+    memory->callback([this, memory]() {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(memory->get_option("--timeout")->as<int>());
+        const auto interval = std::chrono::milliseconds(memory->get_option("--settle-ms")->as<int>());
+
+        // Pages keep allocating for a while after they finished loading (fonts, images, JIT), so the
+        // report is only taken once the total stopped moving.
+        json report;
+        uint64_t previousTotal = 0;
+        bool settled = false;
+        while (std::chrono::steady_clock::now() < deadline) {
+            json response = m_ZMQReq.Request("memory-report", json::object(), 5000);
+            if (!response.contains("result")) {
+                std::cerr << "Failed to get memory report: " << response.dump() << std::endl;
+                throw CLI::RuntimeError(1);
+            }
+            report = response["result"];
+
+            const auto total = report["total"].get<uint64_t>();
+            if (report["loading"].get<int>() == 0 && previousTotal > 0 &&
+                std::abs(static_cast<double>(total) - static_cast<double>(previousTotal)) < previousTotal * 0.01) {
+                settled = true;
+                break;
+            }
+            previousTotal = report["loading"].get<int>() == 0 ? total : 0;
+            std::this_thread::sleep_for(interval);
+        }
+        if (!settled) {
+            std::cerr << "Pages did not settle within the timeout, reporting the last sample." << std::endl;
+        }
+
+        if (memory->get_option("--json")->as<bool>()) {
+            std::cout << report.dump(2) << std::endl;
+        } else {
+            for (const auto& process : report["processes"]) {
+                std::cout << std::format("{:>8} {:<10} {:>10.1f} MB", process["pid"].get<int64_t>(),
+                                         process["type"].get<std::string>(), process["pss"].get<uint64_t>() / (1024.0 * 1024.0))
+                          << std::endl;
+            }
+            for (const auto& [type, pss] : report["types"].items()) {
+                std::cout << std::format("{:<10} {:>10.1f} MB", type, pss.get<uint64_t>() / (1024.0 * 1024.0)) << std::endl;
+            }
+            std::cout << std::format("{:<10} {:>10.1f} MB", "total", report["total"].get<uint64_t>() / (1024.0 * 1024.0))
+                      << std::endl;
+        }
+
+        if (memory->get_option("--budget")->empty()) {
+            return;
+        }
+        toml::table budgets = toml::parse_file(memory->get_option("--budget")->as<std::string>());
+        const toml::table* budget = &budgets;
+        if (!memory->get_option("--section")->empty()) {
+            const std::string section = memory->get_option("--section")->as<std::string>();
+            budget = budgets[section].as_table();
+            if (!budget) {
+                std::cerr << "Budget file has no section '" << section << "'." << std::endl;
+                throw CLI::RuntimeError(1);
+            }
+        }
+
+        bool exceeded = false;
+        for (const auto& [key, node] : *budget) {
+            const std::string name(key.str());
+            const auto limit = node.value<int64_t>();
+            if (!name.ends_with("_mb") || !limit) {
+                continue;
+            }
+            const std::string type = name.substr(0, name.size() - 3);
+            const uint64_t actual = type == "total" ? report["total"].get<uint64_t>() : report["types"].value(type, uint64_t{0});
+            if (actual > static_cast<uint64_t>(*limit) * 1024 * 1024) {
+                std::cerr << std::format("Budget exceeded: {} is {:.1f} MB, budget is {} MB", type, actual / (1024.0 * 1024.0),
+                                         *limit)
+                          << std::endl;
+                exceeded = true;
+            }
+        }
+        if (exceeded) {
+            throw CLI::RuntimeError(1);
+        }
+        std::cout << "All budgets met." << std::endl;
     });
-}
\ No newline at end of file
+}
@@ -8,6 +8,16 @@ class Dispatcher {
   private:
     ZMQReq m_ZMQReq;
 
+    void InitBenchCommands(CLI::App* dispatch);
+
+    /**
+     * Sends a request and waits for the shell to complete it.
+     * @param action What the request does, for the error message.
+     * @return The response, which has a "result" if the listener returned one.
+     * @throws CLI::RuntimeError If the request failed, after printing why.
+     */
+    json Request(const std::string& type, const json& payload, const std::string& action, int timeoutMs = 4000);
+
   public:
     Dispatcher() = default;
     ~Dispatcher() = default;
@@ -0,0 +1,88 @@
+#ifndef FASTPATH_H
+#define FASTPATH_H
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+
+/*
+ * The fast path is a plain unix socket next to the ZMQ dispatch socket, meant for keybinds.
+ * A request is a single line of space-separated visibility operations, the reply is a single line:
+ *
+ *     [wait] <show|hide|toggle>:<widget>[:<monitor>] ...   ->   ok | error: <message>
+ *
+ * All operations of a line are applied in the same main loop iteration. With the leading "wait",
+ * the reply is only sent once the shown windows presented their first frame.
+ * This header has no dependencies besides libc, so tiny clients (wssctl) can use it without
+ * pulling in Qt, ZMQ or the rest of the shell.
+ */
+namespace WSS::FastPath {
+
+/**
+ * Gets the path of the fast path socket: $XDG_RUNTIME_DIR/wss.sock, or /tmp/wss-<uid>.sock without a runtime directory.
+ */
+inline std::string GetSocketPath() {
+    if (const char* runtimeDir = std::getenv("XDG_RUNTIME_DIR"); runtimeDir && *runtimeDir) {
+        return std::string(runtimeDir) + "/wss.sock";
+    }
+    return "/tmp/wss-" + std::to_string(getuid()) + ".sock";
+}
+
+/**
+ * Sends a request line to the shell and waits for the reply.
+ * @param request The request, without the trailing newline.
+ * @param timeoutMs How long to wait for the reply.
+ * @return The reply without the trailing newline, or std::nullopt if the shell isn't reachable or didn't answer in time.
+ */
+inline std::optional<std::string> Request(const std::string& request, const int timeoutMs = 3000) {
+    const std::string path = GetSocketPath();
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        return std::nullopt;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return std::nullopt;
+    }
+
+    const std::string line = request + "\n";
+    if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(line.size())) {
+        close(fd);
+        return std::nullopt;
+    }
+
+    std::string reply;
+    char buffer[512];
+    pollfd pfd{.fd = fd, .events = POLLIN, .revents = 0};
+    while (reply.find('\n') == std::string::npos && poll(&pfd, 1, timeoutMs) > 0) {
+        const ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            break;
+        }
+        reply.append(buffer, received);
+    }
+    close(fd);
+
+    const size_t end = reply.find('\n');
+    if (end == std::string::npos) {
+        return std::nullopt;
+    }
+    return reply.substr(0, end);
+}
+
+} // namespace WSS::FastPath
+
+#endif // FASTPATH_H
@@ -0,0 +1,161 @@
+#ifndef FASTPATH_SERVER_H
+#define FASTPATH_SERVER_H
+
+#include <pch.h>
+
+#include <sys/stat.h>
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "fastpath.h"
+
+namespace WSS {
+
+/**
+ * Serves the fast path socket (see fastpath.h). A few worker threads accept connections on their own,
+ * so a request waiting for a frame doesn't hold up the ones behind it. A request is expected to arrive
+ * right after connecting.
+ */
+class FastPathServer {
+    static constexpr int WorkerCount = 4;
+
+    int m_Socket = -1;
+    std::string m_Path;
+
+    std::atomic_bool m_Running{false};
+    std::vector<std::thread> m_Workers;
+
+    std::function<std::string(const std::string&)> m_Handler;
+
+    void Accept() const {
+        pollfd pfd{.fd = m_Socket, .events = POLLIN, .revents = 0};
+        while (m_Running) {
+            // Woken up regularly, so the worker notices shutdown.
+            if (poll(&pfd, 1, 250) <= 0) {
+                continue;
+            }
+            // The socket is non-blocking, another worker may have taken the connection.
+            const int client = accept4(m_Socket, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) {
+                continue;
+            }
+            Serve(client);
+            close(client);
+        }
+    }
+
+    /**
+     * Checks whether another instance is serving the socket at m_Path.
+     */
+    [[nodiscard]] bool IsServedElsewhere(const sockaddr_un& address) const {
+        const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (probe < 0) {
+            return false;
+        }
+        const bool connected = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        close(probe);
+        return connected;
+    }
+
+    void Serve(int client) const {
+        timeval timeout{.tv_sec = 1, .tv_usec = 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::string request;
+        char buffer[512];
+        while (request.find('\n') == std::string::npos && request.size() < 4096) {
+            const ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                break;
+            }
+            request.append(buffer, received);
+        }
+        if (const size_t end = request.find('\n'); end != std::string::npos) {
+            request.resize(end);
+        }
+        if (request.empty()) {
+            return;
+        }
+
+        std::string reply;
+        try {
+            reply = m_Handler(request);
+        } catch (const std::exception& e) {
+            reply = std::string("error: ") + e.what();
+        }
+        reply += "\n";
+        send(client, reply.data(), reply.size(), MSG_NOSIGNAL);
+    }
+
+  public:
+    FastPathServer() = default;
+    ~FastPathServer() { Stop(); }
+
+    FastPathServer(const FastPathServer&) = delete;
+    FastPathServer(FastPathServer&&) = delete;
+    FastPathServer& operator=(FastPathServer&&) = delete;
+
+    /**
+     * Binds the socket and starts serving requests on the worker threads. Doesn't start if another
+     * instance is already serving the socket.
+     * @param handler Turns a request line into the reply line, runs on the worker threads (concurrently).
+     */
+    void RunAsync(std::function<std::string(const std::string&)> handler) {
+        m_Handler = std::move(handler);
+        m_Path = FastPath::GetSocketPath();
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (m_Path.size() >= sizeof(address.sun_path)) {
+            WSS_ERROR("Fast path socket path is too long: {}", m_Path);
+            return;
+        }
+        std::memcpy(address.sun_path, m_Path.c_str(), m_Path.size() + 1);
+
+        if (IsServedElsewhere(address)) {
+            WSS_ERROR("Another instance is serving the fast path socket at {}, not starting the fast path.", m_Path);
+            return;
+        }
+
+        m_Socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        unlink(m_Path.c_str()); // Left behind by a previous instance that didn't shut down cleanly
+        // Only the user may connect, the /tmp fallback is shared with everyone. Set before listening, so
+        // no connection can come in earlier.
+        if (m_Socket < 0 || bind(m_Socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            chmod(m_Path.c_str(), 0600) != 0 || listen(m_Socket, 16) != 0) {
+            WSS_ERROR("Failed to bind the fast path socket at {}: {}", m_Path, strerror(errno));
+            if (m_Socket >= 0) {
+                close(m_Socket);
+                m_Socket = -1;
+            }
+            return;
+        }
+
+        m_Running = true;
+        for (int i = 0; i < WorkerCount; i++) {
+            m_Workers.emplace_back([this]() { Accept(); });
+        }
+        WSS_INFO("Fast path dispatch socket listening at {}", m_Path);
+    }
+
+    /**
+     * Stops serving requests, after the ones in progress got their reply, and removes the socket.
+     */
+    void Stop() {
+        m_Running = false;
+        for (auto& worker : m_Workers) {
+            worker.join();
+        }
+        m_Workers.clear();
+        if (m_Socket >= 0) {
+            close(m_Socket);
+            unlink(m_Path.c_str());
+            m_Socket = -1;
+        }
+    }
+};
+} // namespace WSS
+
+#endif // FASTPATH_SERVER_H
@@ -0,0 +1,56 @@
+// Minimal client for the fast path socket, meant to be bound to keys.
+// It links nothing but libc, so starting it costs a fraction of starting `wss dispatch`.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "fastpath.h"
+
+static int Usage() {
+    std::fprintf(stderr, "Usage: wssctl [-w] <show|hide|toggle> <widget> [monitor]\n"
+                         "       wssctl [-w] batch <show|hide|toggle>:<widget>[:<monitor>]...\n"
+                         "  -w  Wait until the shown widgets presented their first frame\n");
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    int arg = 1;
+    std::string request;
+    if (arg < argc && std::strcmp(argv[arg], "-w") == 0) {
+        request = "wait ";
+        arg++;
+    }
+    if (arg >= argc) {
+        return Usage();
+    }
+
+    const std::string command = argv[arg++];
+    if (command == "batch") {
+        if (arg >= argc) {
+            return Usage();
+        }
+        for (; arg < argc; arg++) {
+            request += std::string(argv[arg]) + " ";
+        }
+    } else if (command == "show" || command == "hide" || command == "toggle") {
+        if (arg >= argc || argc - arg > 2) {
+            return Usage();
+        }
+        request += command + ":" + argv[arg];
+        request += ":" + std::string(arg + 1 < argc ? argv[arg + 1] : "0");
+    } else {
+        return Usage();
+    }
+
+    const auto reply = WSS::FastPath::Request(request);
+    if (!reply) {
+        std::fprintf(stderr, "wssctl: no reply from %s, is WSS running?\n", WSS::FastPath::GetSocketPath().c_str());
+        return 1;
+    }
+    if (*reply != "ok") {
+        std::fprintf(stderr, "wssctl: %s\n", reply->c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef ZMQ_PUB_H
+#define ZMQ_PUB_H
+
+#include <pch.h>
+
+#include <mutex>
+#include <string>
+#include <zmq.hpp>
+
+namespace WSS {
+
+/**
+ * Publishes the IPC topics on a PUB socket, so scripts can follow events without polling.
+ * Every event is sent as two frames: the topic, and the same {"type", "payload"} JSON pages receive.
+ * Subscriptions are prefix matches ("zone" gets "zone-enter" and "zone-leave") and are filtered by
+ * ZMQ on the publishing side, so events nobody subscribed to never leave the shell.
+ * Publish() can be called from any thread.
+ */
+class ZMQPub {
+    static constexpr auto Endpoint = "ipc:///tmp/wss_events";
+
+    zmq::context_t m_Context;
+    zmq::socket_t m_Socket;
+    std::mutex m_SocketMutex;
+    bool m_Bound = false;
+
+  public:
+    ZMQPub() = default;
+    ~ZMQPub() {
+        if (m_Socket.handle() != nullptr)
+            m_Socket.close();
+        if (m_Context.handle() != nullptr)
+            m_Context.close();
+    }
+
+    ZMQPub(const ZMQPub&) = delete;
+    ZMQPub(ZMQPub&&) = delete;
+    ZMQPub& operator=(ZMQPub&&) = delete;
+
+    [[nodiscard]] static const char* GetEndpoint() { return Endpoint; }
+
+    void Start() {
+        std::lock_guard lock(m_SocketMutex);
+        try {
+            m_Socket = zmq::socket_t(m_Context, zmq::socket_type::pub);
+            m_Socket.set(zmq::sockopt::linger, 0);
+            // A subscriber that stops reading loses events instead of growing the shell's memory.
+            m_Socket.set(zmq::sockopt::sndhwm, 1000);
+            m_Socket.bind(Endpoint);
+            m_Bound = true;
+            WSS_INFO("Event publisher listening at {}", Endpoint);
+        } catch (const zmq::error_t& e) {
+            WSS_ERROR("[WSS-ZMQ] Failed to bind the event publisher: {}", e.what());
+        }
+    }
+
+    /**
+     * Publishes an event to the subscribers of its topic. Never blocks.
+     * @param topic The IPC topic of the event.
+     * @param message The serialized {"type", "payload"} message.
+     */
+    void Publish(const std::string& topic, const std::string& message) {
+        std::lock_guard lock(m_SocketMutex);
+        if (!m_Bound) {
+            return;
+        }
+        m_Socket.send(zmq::buffer(topic), zmq::send_flags::sndmore | zmq::send_flags::dontwait);
+        m_Socket.send(zmq::buffer(message), zmq::send_flags::dontwait);
+    }
+};
+} // namespace WSS
+
+#endif // ZMQ_PUB_H
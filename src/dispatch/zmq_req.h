@@ -42,6 +42,7 @@ inline json ZMQReq::Request(const std::string& message, const json request, int
         const std::string reqStr = req.dump();
         zmq::message_t zmqReq(reqStr.size());
         memcpy(zmqReq.data(), reqStr.data(), reqStr.size());
+        m_Socket.set(zmq::sockopt::rcvtimeo, timeout_ms);
         m_Socket.send(zmqReq, zmq::send_flags::none);
 
         zmq::message_t zmq_resp;
@@ -0,0 +1,283 @@
+#ifndef ZMQ_ROUTER_H
+#define ZMQ_ROUTER_H
+
+#include <pch.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>
+#include <zmq.hpp>
+#include <zmq_addon.hpp>
+
+namespace WSS {
+
+/**
+ * Serves dispatch requests on a ROUTER socket.
+ * Listeners run on a fixed pool of worker threads, so a slow request (e.g. a benchmark) doesn't hold
+ * up the others, and the reply is only sent once the listener returned, i.e. once whatever it waited
+ * for (usually the main thread) is actually done. REQ clients work unchanged, replies are:
+ *
+ *     {"status": "success", "durationMs": 1.2, "result": ...}
+ *     {"status": "error", "durationMs": 1.2, "error": "...", "details": "..."}
+ *
+ * ZMQ sockets must only be used from the thread that polls them, so finished listeners hand their
+ * reply over through a queue and wake the router thread with an eventfd.
+ */
+class ZMQRouter {
+    static constexpr int WorkerCount = 8;
+    static constexpr int MaxInFlight = 32; // Running and queued requests
+
+    struct Reply {
+        zmq::message_t Identity;
+        std::string Body;
+    };
+
+    struct Job {
+        zmq::message_t Identity;
+        std::function<json(const json&)> Listener;
+        json Message;
+        std::chrono::steady_clock::time_point Start;
+    };
+
+    zmq::context_t m_Context;
+    zmq::socket_t m_Socket;
+    int m_WakeFd = -1;
+
+    std::atomic_bool m_Running{false};
+    std::thread m_Thread;
+
+    std::vector<std::thread> m_Workers;
+    std::deque<Job> m_Jobs;
+    int m_InFlight = 0;
+    std::mutex m_JobsMutex;
+    std::condition_variable m_JobsChanged;
+
+    std::unordered_map<std::string, std::function<json(const json&)>> m_Listeners;
+    std::mutex m_ListenersMutex;
+
+    std::deque<Reply> m_Replies;
+    std::mutex m_RepliesMutex;
+
+    void Dispatch(zmq::message_t identity, const std::string& message);
+    void Work();
+    void PostReply(zmq::message_t identity, const json& response);
+    void SendReplies();
+
+  public:
+    ZMQRouter() = default;
+    ~ZMQRouter();
+
+    ZMQRouter(const ZMQRouter&) = delete;
+    ZMQRouter(ZMQRouter&&) = delete;
+    ZMQRouter& operator=(ZMQRouter&&) = delete;
+
+    void RunAsync();
+
+    /**
+     * Stops serving requests and joins all threads, after the listeners still running returned.
+     */
+    void Stop();
+
+    /**
+     * Registers a listener for the specified message type.
+     * Whatever the listener returns (unless null) is sent back to the requester as the "result" field.
+     * Throwing from the listener reports the failure back to the requester. Listeners run on the
+     * worker threads, and may block until the requested action completed.
+     * @param type The message type to listen for.
+     * @param listener The listener to run.
+     */
+    void Listen(const std::string& type, std::function<json(const json&)> listener);
+};
+
+inline ZMQRouter::~ZMQRouter() {
+    Stop();
+
+    if (m_Socket.handle() != nullptr)
+        m_Socket.close();
+    if (m_Context.handle() != nullptr)
+        m_Context.close();
+    if (m_WakeFd >= 0)
+        close(m_WakeFd);
+}
+
+inline void ZMQRouter::Stop() {
+    {
+        std::lock_guard lock(m_JobsMutex);
+        m_Running = false;
+    }
+    m_JobsChanged.notify_all();
+    if (m_Thread.joinable()) {
+        m_Thread.join();
+    }
+    // Listeners that are still running finish first (they time out on their own), queued requests are dropped.
+    for (auto& worker : m_Workers) {
+        worker.join();
+    }
+    m_Workers.clear();
+}
+
+inline void ZMQRouter::PostReply(zmq::message_t identity, const json& response) {
+    {
+        std::lock_guard lock(m_RepliesMutex);
+        m_Replies.push_back({std::move(identity), response.dump()});
+    }
+    const uint64_t one = 1;
+    if (write(m_WakeFd, &one, sizeof(one)) != sizeof(one)) {
+        WSS_ERROR("[WSS-ZMQ] Failed to wake the router thread: {}", strerror(errno));
+    }
+}
+
+inline void ZMQRouter::SendReplies() {
+    // Only resets the counter, the replies are taken from the queue either way.
+    uint64_t count = 0;
+    if (read(m_WakeFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        WSS_ERROR("[WSS-ZMQ] Failed to reset the wake-up counter: {}", strerror(errno));
+    }
+
+    std::deque<Reply> replies;
+    {
+        std::lock_guard lock(m_RepliesMutex);
+        replies.swap(m_Replies);
+    }
+    for (auto& reply : replies) {
+        // ROUTER envelope: identity, empty delimiter (as added by REQ sockets), body.
+        m_Socket.send(reply.Identity, zmq::send_flags::sndmore);
+        m_Socket.send(zmq::message_t(), zmq::send_flags::sndmore);
+        if (!m_Socket.send(zmq::buffer(reply.Body), zmq::send_flags::none))
+            fprintf(stderr, "WSS-ZMQRouter send failed: %s\n", zmq_strerror(zmq_errno()));
+        WSS_DEBUG("[WSS-ZMQ] Sent response: {}", reply.Body);
+    }
+}
+
+inline void ZMQRouter::Dispatch(zmq::message_t identity, const std::string& message) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto elapsed = [start]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    json msg = json::parse(message, nullptr, false);
+    if (msg.is_discarded() || !msg.is_object() || !msg.contains("type") || !msg["type"].is_string()) {
+        PostReply(std::move(identity), {{"status", "error"}, {"error", "Malformed request"}, {"durationMs", elapsed()}});
+        return;
+    }
+
+    std::function<json(const json&)> listener;
+    {
+        std::lock_guard lock(m_ListenersMutex);
+        if (const auto it = m_Listeners.find(msg["type"]); it != m_Listeners.end()) {
+            listener = it->second;
+        }
+    }
+    if (!listener) {
+        PostReply(std::move(identity),
+                  {{"status", "error"}, {"error", "No listener for this message type"}, {"durationMs", elapsed()}});
+        return;
+    }
+    {
+        std::lock_guard lock(m_JobsMutex);
+        if (m_InFlight < MaxInFlight) {
+            m_InFlight++;
+            m_Jobs.push_back({std::move(identity), std::move(listener), std::move(msg), start});
+            m_JobsChanged.notify_one();
+            return;
+        }
+    }
+    PostReply(std::move(identity), {{"status", "error"}, {"error", "Too many requests in flight"}, {"durationMs", elapsed()}});
+}
+
+inline void ZMQRouter::Work() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(m_JobsMutex);
+            m_JobsChanged.wait(lock, [this]() { return !m_Running || !m_Jobs.empty(); });
+            if (!m_Running) {
+                return;
+            }
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+        }
+
+        const auto elapsed = [&job]() {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.Start).count();
+        };
+        json response;
+        try {
+            json result = job.Listener(job.Message.value("payload", json::object()));
+            response = {{"status", "success"}, {"durationMs", elapsed()}};
+            if (!result.is_null()) {
+                response["result"] = std::move(result);
+            }
+        } catch (const std::exception& e) {
+            response = {{"status", "error"}, {"error", "Listener execution failed"}, {"details", e.what()},
+                        {"durationMs", elapsed()}};
+        }
+
+        std::lock_guard lock(m_JobsMutex);
+        m_InFlight--;
+        if (m_Running) {
+            PostReply(std::move(job.Identity), response);
+        }
+    }
+}
+
+inline void ZMQRouter::RunAsync() {
+    m_Socket = zmq::socket_t(m_Context, zmq::socket_type::router);
+    m_Socket.set(zmq::sockopt::linger, 0); // Set linger to 0 to avoid blocking on close
+    m_WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_Running = true;
+    for (int i = 0; i < WorkerCount; i++) {
+        m_Workers.emplace_back([this]() { Work(); });
+    }
+    m_Thread = std::thread([this]() {
+        try {
+            m_Socket.bind("ipc:///tmp/wss_ipc");
+
+            zmq::pollitem_t items[] = {
+                {m_Socket.handle(), 0, ZMQ_POLLIN, 0},
+                {nullptr, m_WakeFd, ZMQ_POLLIN, 0},
+            };
+            while (m_Running) {
+                // Woken up regularly, so the thread notices shutdown.
+                zmq::poll(items, 2, std::chrono::milliseconds(250));
+
+                if (items[1].revents & ZMQ_POLLIN) {
+                    SendReplies();
+                }
+                if (!(items[0].revents & ZMQ_POLLIN)) {
+                    continue;
+                }
+
+                std::vector<zmq::message_t> frames;
+                if (!zmq::recv_multipart(m_Socket, std::back_inserter(frames), zmq::recv_flags::dontwait) ||
+                    frames.size() < 2) {
+                    continue;
+                }
+                std::string message = frames.back().to_string();
+                WSS_DEBUG("[WSS-ZMQ] Received message: {}", message);
+                Dispatch(std::move(frames.front()), message);
+            }
+        } catch (const std::exception& e) {
+            WSS_ERROR("[WSS-ZMQ] Exception in ZMQRouter thread: {}", e.what());
+        } catch (...) {
+            WSS_ERROR("[WSS-ZMQ] Unknown exception in ZMQRouter thread.");
+        }
+    });
+}
+
+inline void ZMQRouter::Listen(const std::string& type, std::function<json(const json&)> listener) {
+    std::lock_guard lock(m_ListenersMutex);
+    if (m_Listeners.find(type) != m_Listeners.end()) {
+        WSS_WARN("[WSS-ZMQ] Listener for type '{}' already exists, replacing it.", type);
+    }
+    m_Listeners[type] = std::move(listener);
+    WSS_DEBUG("[WSS-ZMQ] Registered listener for type '{}'", type);
+}
+} // namespace WSS
+
+#endif // ZMQ_ROUTER_H
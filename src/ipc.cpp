@@ -6,6 +6,28 @@
 
 #include "shell.h"
 
+/**
+ * Reads a dimension expression from an IPC payload. Pages can send either pixels as a number or an
+ * expression like in the configuration ("50%", "1/3 - 20"). Missing fields are returned empty.
+ */
+static std::string GetDimension(const json& payload, const std::string& key) {
+    if (!payload.contains(key) || payload[key].is_null()) {
+        return "";
+    }
+    if (payload[key].is_number()) {
+        return std::to_string(payload[key].get<int>());
+    }
+    return payload[key].get<std::string>();
+}
+
+/**
+ * Topics the shell assigns: replies to one client ("client:<id>") and messages to one widget
+ * ("widget:<name>[:<monitor ID>]", subscribed at handshake). Pages can't subscribe to them.
+ */
+static bool IsPrivateTopic(const std::string& topic) {
+    return topic.starts_with("client:") || topic.starts_with("widget:");
+}
+
 void WSS::IPC::IPCCallback(WSClient* ws, std::string_view message, uWS::OpCode opCode) {
     json jobj;
     try {
@@ -29,6 +51,15 @@ void WSS::IPC::IPCCallback(WSClient* ws, std::string_view message, uWS::OpCode o
         int monitorId = payload["monitorId"];
         std::string widgetName = payload["widgetName"];
 
+        // Messages from other widgets are routed through per-widget topics. Pooled pages handshake
+        // again when they get their identity, so the topics of the old one are dropped first.
+        if (!ws->getUserData()->widgetName.empty()) {
+            ws->unsubscribe("widget:" + ws->getUserData()->widgetName);
+            ws->unsubscribe("widget:" + ws->getUserData()->widgetName + ":" + std::to_string(ws->getUserData()->monitorId));
+        }
+        ws->subscribe("widget:" + widgetName);
+        ws->subscribe("widget:" + widgetName + ":" + std::to_string(monitorId));
+
         ws->getUserData()->monitorId = monitorId;
         ws->getUserData()->widgetName = widgetName;
         WSS_DEBUG("Client identified with monitor ID: {}, widget name: {}", monitorId, widgetName);
@@ -44,14 +75,28 @@ void WSS::IPC::IPCCallback(WSClient* ws, std::string_view message, uWS::OpCode o
 }
 
 WSS::IPC::~IPC() {
-    if (m_Running) {
-        m_Running = false;
-        m_App->close();
+    Stop();
+    WSS_DEBUG("IPC context destroyed and resources cleaned up.");
+}
+
+void WSS::IPC::Stop() {
+    m_MousePositionRunning = false;
+    if (m_MousePositionThread.joinable()) {
+        m_MousePositionThread.join();
+    }
+    if (m_Running.exchange(false)) {
+        Defer([this]() { m_App->close(); });
         if (m_Thread.joinable()) {
             m_Thread.join();
         }
     }
-    WSS_DEBUG("IPC context destroyed and resources cleaned up.");
+}
+
+void WSS::IPC::Defer(std::function<void()> callback) {
+    std::lock_guard lock(m_LoopMutex);
+    if (m_Loop) {
+        m_Loop->defer(std::move(callback));
+    }
 }
 
 void WSS::IPC::Start() {
@@ -72,13 +117,33 @@ void WSS::IPC::Start() {
             .Y = payload["y"],
             .Width = payload["width"],
             .Height = payload["height"],
-            ._QT_padding = widget->GetInfo()._QT_padding,
         };
 
         const std::string regionName = payload["name"];
         widget->SetClickableRegion(monitorId, regionName, regionInfo);
     });
 
+    Listen("window-update-opaque-region", [this](Shell* shell, WSClient* client, const json& payload) {
+        int monitorId = client->getUserData()->monitorId;
+        std::string widgetName = client->getUserData()->widgetName;
+
+        auto widget = shell->GetWidget(widgetName);
+        if (!widget) {
+            WSS_ERROR("Widget '{}' not found for monitor ID: {}", widgetName, monitorId);
+            return;
+        }
+
+        WidgetClickRegionInfo regionInfo{
+            .X = payload["x"],
+            .Y = payload["y"],
+            .Width = payload["width"],
+            .Height = payload["height"],
+        };
+
+        const std::string regionName = payload["name"];
+        widget->SetOpaqueRegion(monitorId, regionName, regionInfo);
+    });
+
     Listen("notifd-notification-dismiss", [this](Shell* shell, WSClient* client, const json& payload) {
         uint32_t id = payload["id"];
         shell->GetNotifd().SignalNotificationClosed(id, NotificationCloseReason::DISMISSED);
@@ -90,6 +155,28 @@ void WSS::IPC::Start() {
         shell->GetNotifd().SignalActionInvoked(id, action);
     });
 
+    Listen("notifd-set-dnd", [this](Shell* shell, WSClient* client, const json& payload) {
+        shell->GetNotifd().SetDoNotDisturb(payload["enabled"].get<bool>());
+    });
+
+    Listen("notifd-history-request", [this](Shell* shell, WSClient* client, const json& payload) {
+        const HistoryQuery query{.Before = payload.value("before", UINT64_MAX),
+                                 .Limit = std::clamp<size_t>(payload.value("limit", 20), 1, 200),
+                                 .AppName = payload.value("appName", ""),
+                                 .MinUrgency = payload.value("minUrgency", 0),
+                                 .Since = payload.value("since", int64_t{0}),
+                                 .Grouped = payload.value("grouped", false)};
+        json response = shell->GetNotifd().GetHistory().Query(query);
+        if (payload.contains("requestId")) {
+            response["requestId"] = payload["requestId"];
+        }
+        Send(client, "notifd-history-response", response);
+    });
+
+    Listen("notifd-history-clear", [this](Shell* shell, WSClient* client, const json& payload) {
+        shell->GetNotifd().GetHistory().Clear();
+    });
+
     Listen("appd-application-run", [this](Shell* shell, WSClient* client, const json& payload) {
         std::string prefix = payload["prefix"];
         std::string appId = payload["appId"];
@@ -113,7 +200,6 @@ void WSS::IPC::Start() {
     });
 
     Listen("monitor-info-request", [this](Shell* shell, WSClient* client, const json& payload) {
-        auto monitor = shell->GetWidget(client->getUserData()->widgetName)->GetMonitorInfo(client->getUserData()->monitorId);
         int id = client->getUserData()->monitorId;
 
         json response = {
@@ -125,9 +211,13 @@ void WSS::IPC::Start() {
         Send(client, "monitor-info-response", response);
     });
 
+    Listen("stats-request", [this](Shell* shell, WSClient* client, const json& payload) {
+        Send(client, "stats-response", shell->GetStatd().GetStatsJson());
+    });
+
     Listen("widget-set-keyboard-interactivity", [this](Shell* shell, WSClient* client, const json& payload) {
-        std::string widgetName = client->getUserData()->widgetName;
-        int monitorId = client->getUserData()->monitorId;
+        std::string widgetName = payload.value("widget", client->getUserData()->widgetName);
+        int monitorId = payload.value("monitorId", client->getUserData()->monitorId);
         auto widget = shell->GetWidget(widgetName);
         if (!widget) {
             WSS_ERROR("Widget '{}' not found for setting keyboard interactivity.", widgetName);
@@ -138,10 +228,184 @@ void WSS::IPC::Start() {
         widget->SetKeyboardInteractivity(monitorId, interactive);
     });
 
+    // Control of any widget from a page, e.g. a bar button opening the launcher. The target defaults
+    // to the sending widget, and the monitor to the one the sender is on. Windows only exist on the
+    // main thread, so the change is applied there and a failure is reported back from there.
+    for (const auto& [type, op] : {std::pair{"widget-show", VisibilityOp::SHOW}, std::pair{"widget-hide", VisibilityOp::HIDE},
+                                   std::pair{"widget-toggle", VisibilityOp::TOGGLE}}) {
+        Listen(type, [this, op](Shell* shell, WSClient* client, const json& payload) {
+            std::string widgetName = payload.value("widget", client->getUserData()->widgetName);
+            int monitorId = payload.value("monitorId", client->getUserData()->monitorId);
+            const uint64_t clientId = client->getUserData()->id;
+            DispatchToMainThread([this, shell, op, widgetName, monitorId, clientId]() {
+                const auto widget = shell->GetWidget(widgetName);
+                if (!widget || monitorId < 0 || monitorId >= 256 ||
+                    !widget->ApplyVisibilityOp(static_cast<uint8_t>(monitorId), op)) {
+                    WSS_ERROR("Widget '{}' has no window on monitor ID: {}.", widgetName, monitorId);
+                    SendLater(clientId, "widget-control-error",
+                              {{"widget", widgetName}, {"monitorId", monitorId}, {"error", "not found"}});
+                }
+            });
+        });
+    }
+
+    Listen("widget-message", [this](Shell* shell, WSClient* client, const json& payload) {
+        std::string widgetName = payload["widget"];
+        std::string topic = "widget:" + widgetName;
+        if (payload.contains("monitorId")) {
+            topic += ":" + std::to_string(payload["monitorId"].get<int>());
+        }
+
+        // Runs on the event loop thread, so it's delivered right away.
+        if (m_App->numSubscribers(topic) == 0) {
+            Send(client, "widget-control-error", {{"widget", widgetName}, {"error", "no page to deliver to"}});
+            return;
+        }
+        json message = {{"type", "widget-message"},
+                        {"payload",
+                         {{"from", {{"widget", client->getUserData()->widgetName}, {"monitorId", client->getUserData()->monitorId}}},
+                          {"payload", payload.value("payload", json())}}}};
+        m_App->publish(topic, message.dump(), uWS::TEXT, true);
+    });
+
+    Listen("widget-spawn", [this](Shell* shell, WSClient* client, const json& payload) {
+        std::string templateName = payload["template"];
+        std::string name = payload.value("name", "");
+        auto monitors = MonitorSelector::FromJson(payload.value("monitors", json::array()));
+        try {
+            // Only answered once the widget exists, the name might have been taken in the meantime.
+            const uint64_t clientId = client->getUserData()->id;
+            shell->SpawnWidget(templateName, name, monitors,
+                               [this, clientId, templateName](const std::string& spawned, const std::string& error) {
+                                   if (!error.empty()) {
+                                       WSS_ERROR("Failed to spawn widget from template '{}': {}", templateName, error);
+                                   }
+                                   SendLater(clientId, "widget-spawn-response",
+                                             error.empty() ? json{{"template", templateName}, {"name", spawned}}
+                                                           : json{{"template", templateName}, {"error", error}});
+                               });
+        } catch (const std::invalid_argument& e) {
+            WSS_ERROR("Failed to spawn widget from template '{}': {}", templateName, e.what());
+            Send(client, "widget-spawn-response", {{"template", templateName}, {"error", e.what()}});
+        }
+    });
+
+    Listen("widget-destroy", [this](Shell* shell, WSClient* client, const json& payload) {
+        std::string name = payload["name"];
+        try {
+            shell->DestroyWidget(name);
+        } catch (const std::invalid_argument& e) {
+            WSS_ERROR("Failed to destroy widget '{}': {}", name, e.what());
+        }
+    });
+
+    Listen("widget-set-geometry", [this](Shell* shell, WSClient* client, const json& payload) {
+        std::string widgetName = client->getUserData()->widgetName;
+        auto widget = shell->GetWidget(widgetName);
+        if (!widget) {
+            WSS_ERROR("Widget '{}' not found for geometry update.", widgetName);
+            return;
+        }
+        widget->SetSize(GetDimension(payload, "width"), GetDimension(payload, "height"));
+    });
+
+    Listen("widget-set-margins", [this](Shell* shell, WSClient* client, const json& payload) {
+        std::string widgetName = client->getUserData()->widgetName;
+        auto widget = shell->GetWidget(widgetName);
+        if (!widget) {
+            WSS_ERROR("Widget '{}' not found for margin update.", widgetName);
+            return;
+        }
+        widget->SetMargins(GetDimension(payload, "top"), GetDimension(payload, "bottom"), GetDimension(payload, "left"),
+                           GetDimension(payload, "right"));
+    });
+
+    Listen("widget-set-exclusive-zone", [this](Shell* shell, WSClient* client, const json& payload) {
+        std::string widgetName = client->getUserData()->widgetName;
+        auto widget = shell->GetWidget(widgetName);
+        if (!widget) {
+            WSS_ERROR("Widget '{}' not found for exclusive zone update.", widgetName);
+            return;
+        }
+        int zone = payload["zone"];
+        widget->SetExclusiveZone(zone);
+    });
+
+    Listen("popup-open", [this](Shell* shell, WSClient* client, const json& payload) {
+        std::string widgetName = client->getUserData()->widgetName;
+        int monitorId = client->getUserData()->monitorId;
+        std::string popupName = payload["name"];
+        std::string route = payload["route"];
+        QRect rect(payload.value("x", 0), payload.value("y", 0), payload["width"], payload["height"]);
+        bool keyboard = payload.value("keyboard", false);
+        try {
+            std::string name = shell->OpenPopup(widgetName, monitorId, popupName, route, rect, keyboard);
+            Send(client, "popup-open-response", {{"popup", popupName}, {"name", name}});
+        } catch (const std::invalid_argument& e) {
+            WSS_ERROR("Failed to open popup '{}' of widget '{}': {}", popupName, widgetName, e.what());
+            Send(client, "popup-open-response", {{"popup", popupName}, {"error", e.what()}});
+        }
+    });
+
+    Listen("popup-close", [this](Shell* shell, WSClient* client, const json& payload) {
+        std::string widgetName = client->getUserData()->widgetName;
+        std::string popupName = payload.value("name", "");
+        try {
+            // A popup closes itself without a name, its parent closes it by name.
+            if (const auto widget = shell->GetWidget(widgetName); widget && widget->IsPopup() && popupName.empty()) {
+                const auto& parent = widget->GetInfo().Parent;
+                shell->ClosePopup(parent, widgetName.substr(parent.size() + 1));
+            } else {
+                shell->ClosePopup(widgetName, popupName);
+            }
+        } catch (const std::invalid_argument& e) {
+            WSS_ERROR("Failed to close popup '{}' of widget '{}': {}", popupName, widgetName, e.what());
+        }
+    });
+
+    Listen("ipc-subscribe", [this](Shell* shell, WSClient* client, const json& payload) {
+        for (const std::string topic : payload["topics"]) {
+            if (IsPrivateTopic(topic)) {
+                WSS_WARN("Refusing subscription to the private topic '{}'.", topic);
+                continue;
+            }
+            if (topic == "mouse-position-update" && !client->getUserData()->mousePosition) {
+                client->getUserData()->mousePosition = true;
+                m_MousePositionSubscribers++;
+            }
+            client->subscribe(topic);
+
+            // Late joiners get the current value of emitted topics right away.
+            std::lock_guard lock(m_EmittedMutex);
+            if (const auto it = m_Emitted.find(topic); it != m_Emitted.end()) {
+                Send(client, topic, it->second.Latest);
+            }
+        }
+    });
+
+    Listen("ipc-unsubscribe", [this](Shell* shell, WSClient* client, const json& payload) {
+        for (const std::string topic : payload["topics"]) {
+            if (IsPrivateTopic(topic)) {
+                continue; // Assigned by the shell, see ipc-subscribe
+            }
+            if (topic == "mouse-position-update" && client->getUserData()->mousePosition) {
+                client->getUserData()->mousePosition = false;
+                m_MousePositionSubscribers--;
+            }
+            client->unsubscribe(topic);
+        }
+    });
+
     m_MousePositionRunning = true;
     m_MousePositionThread = std::thread([this]() {
         try {
             while (m_MousePositionRunning) {
+                // Nobody to tell, don't spawn hyprctl ten times a second for nothing.
+                if (m_MousePositionSubscribers == 0 && m_Shell->GetZones().IsEmpty()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                    continue;
+                }
+
                 const char* cmd = "hyprctl cursorpos";
                 FILE* pipe = popen(cmd, "r");
                 if (!pipe) {
@@ -173,9 +437,11 @@ void WSS::IPC::Start() {
                 int mousePosX = std::stoi(result.substr(0, commaPos));
                 int mousePosY = std::stoi(result.substr(commaPos + 1));
 
-                json payload = {{"x", mousePosX}, {"y", mousePosY}};
-
-                Broadcast("mouse-position-update", payload);
+                m_Shell->GetZones().Test(mousePosX, mousePosY);
+                if (m_MousePositionSubscribers > 0) {
+                    json payload = {{"x", mousePosX}, {"y", mousePosY}};
+                    Broadcast("mouse-position-update", payload);
+                }
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
             }
         } catch (const std::exception& e) {
@@ -190,16 +456,42 @@ void WSS::IPC::Start() {
         const int port = m_Shell->GetSettings().m_IpcPort;
         try {
             m_App = new uWS::App();
+            {
+                std::lock_guard lock(m_LoopMutex);
+                m_Loop = uWS::Loop::get();
+            }
             m_App
-                ->ws<IPCClientInfo>("/*", {.compression = uWS::DEDICATED_COMPRESSOR_256KB,
+                ->get("/notifd/image/:key",
+                      [this](auto* res, auto* req) {
+                          const auto image = m_Shell->GetNotifd().GetImageCache().Get(std::string(req->getParameter(0)));
+                          if (!image) {
+                              res->writeStatus("404 Not Found")->end();
+                              return;
+                          }
+                          // Keys are derived from the content, so the image behind a URL never changes.
+                          res->writeHeader("Content-Type", image->MimeType)
+                              ->writeHeader("Cache-Control", "public, max-age=31536000, immutable")
+                              ->end(*image->Data);
+                      })
+                .ws<IPCClientInfo>("/*", {.compression = uWS::DEDICATED_COMPRESSOR_256KB,
                                            .maxPayloadLength = 16 * 1024 * 1024,
                                            .idleTimeout = 60,
                                            .open =
                                                [this](WSClient* ws) {
+                                                   // Replies sent with SendLater() are published to a private topic.
+                                                   ws->getUserData()->id = ++m_ClientCounter;
+                                                   ws->subscribe("client:" + std::to_string(ws->getUserData()->id));
                                                    ws->subscribe("monitor-info-response");
                                                    ws->subscribe("appd-application-list-response");
                                                    ws->subscribe("appd-application-added");
-                                                   ws->subscribe("mouse-position-update");
+                                                   ws->subscribe("zone-enter");
+                                                   ws->subscribe("zone-leave");
+                                               },
+                                           .close =
+                                               [this](WSClient* ws, int, std::string_view) {
+                                                   if (ws->getUserData()->mousePosition) {
+                                                       m_MousePositionSubscribers--;
+                                                   }
                                                },
                                            .message = [this](WSClient* ws, const std::string_view message,
                                                              const uWS::OpCode opCode) { IPCCallback(ws, message, opCode); }})
@@ -212,6 +504,8 @@ void WSS::IPC::Start() {
                             }
                         })
                 .run();
+            std::lock_guard lock(m_LoopMutex);
+            m_Loop = nullptr;
 
             WSS_DEBUG("IPC service loop exited, cleaning up resources.");
         } catch (const std::exception& e) {
@@ -227,7 +521,77 @@ void WSS::IPC::Broadcast(const std::string& type, const json& payload) {
 
     std::string jsonStr = message.dump();
 
-    m_App->publish(type, jsonStr, uWS::TEXT, true);
+    // Widgets report their initial visibility before the WebSocket server is up, that's dropped.
+    Defer([this, type, jsonStr]() { m_App->publish(type, jsonStr, uWS::TEXT, true); });
+    m_Shell->GetPublisher().Publish(type, jsonStr);
+}
+
+void WSS::IPC::Emit(const std::string& topic, const json& payload) {
+    const std::string type = "custom:" + topic;
+    const auto now = std::chrono::steady_clock::now();
+
+    std::unique_lock lock(m_EmittedMutex);
+    auto it = m_Emitted.find(type);
+    if (it == m_Emitted.end()) {
+        if (m_Emitted.size() >= MaxEmittedTopics) {
+            // Topics waiting for their flush are kept, they're in use.
+            const auto oldest = std::ranges::min_element(m_Emitted, {}, [](const auto& entry) {
+                return entry.second.FlushPending ? std::chrono::steady_clock::time_point::max() : entry.second.LastEmitAt;
+            });
+            WSS_DEBUG("Forgetting the emitted topic '{}', too many topics.", oldest->first);
+            m_Emitted.erase(oldest);
+        }
+        it = m_Emitted.emplace(type, EmittedTopic{}).first;
+    }
+    auto& emitted = it->second;
+    emitted.Latest = payload;
+    emitted.LastEmitAt = now;
+    if (emitted.FlushPending) {
+        return; // Goes out with the pending flush
+    }
+
+    const auto sinceLast = now - emitted.LastBroadcastAt;
+    if (sinceLast >= EmitCoalesceWindow) {
+        lock.unlock();
+        FlushEmitted(type);
+        return;
+    }
+
+    emitted.FlushPending = true;
+    const int delay = static_cast<int>(
+        std::chrono::ceil<std::chrono::milliseconds>(EmitCoalesceWindow - sinceLast).count());
+    DispatchToMainThread([this, type, delay]() {
+        QTimer::singleShot(delay, qApp, [this, type]() { FlushEmitted(type); });
+    });
+}
+
+void WSS::IPC::FlushEmitted(const std::string& type) {
+    json payload;
+    {
+        std::lock_guard lock(m_EmittedMutex);
+        const auto it = m_Emitted.find(type);
+        if (it == m_Emitted.end()) {
+            return;
+        }
+        auto& emitted = it->second;
+        emitted.FlushPending = false;
+        // The first value always goes out, even if it is null.
+        if (emitted.Broadcasted && emitted.Latest == emitted.LastBroadcast) {
+            return;
+        }
+        emitted.Broadcasted = true;
+        emitted.LastBroadcast = emitted.Latest;
+        emitted.LastBroadcastAt = std::chrono::steady_clock::now();
+        payload = emitted.Latest;
+    }
+    Broadcast(type, payload);
+}
+
+void WSS::IPC::SendLater(const uint64_t clientId, const std::string& type, const json& payload) {
+    json message = {{"type", type}, {"payload", payload}};
+    Defer([this, topic = "client:" + std::to_string(clientId), message = message.dump()]() {
+        m_App->publish(topic, message, uWS::TEXT, true);
+    });
 }
 
 void WSS::IPC::Send(WSClient* wsi, const std::string& type, const json& payload) {
@@ -17,14 +17,33 @@ struct PendingMessage {
 };
 
 struct IPCClientInfo {
+    uint64_t id = 0; // Unique per connection, see IPC::SendLater
     int monitorId;
     std::string widgetName;
+    bool mousePosition = false; // Whether the client subscribed to the raw cursor stream
 };
 
 typedef uWS::WebSocket<false, true, IPCClientInfo> WSClient;
 
+/**
+ * Represents the state of a topic pushed in by scripts (see IPC::Emit).
+ */
+struct EmittedTopic {
+    json Latest;        // Last-value cache, sent to pages as soon as they subscribe
+    json LastBroadcast; // What subscribers currently have, if Broadcasted
+    bool Broadcasted = false;
+    std::chrono::steady_clock::time_point LastEmitAt;
+    std::chrono::steady_clock::time_point LastBroadcastAt;
+    bool FlushPending = false;
+};
+
 class IPC {
+    // Only used on the IPC thread, everyone else goes through Defer().
     uWS::App* m_App = nullptr;
+    uint64_t m_ClientCounter = 0;
+
+    uWS::Loop* m_Loop = nullptr; // While the IPC thread runs its loop
+    std::mutex m_LoopMutex;
     Shell* m_Shell = nullptr;
 
     std::thread m_Thread;
@@ -32,13 +51,29 @@ class IPC {
 
     std::thread m_MousePositionThread;
     std::atomic_bool m_MousePositionRunning{false};
+    // The raw cursor stream is opt-in, most pages only need the zone events.
+    std::atomic_int m_MousePositionSubscribers{0};
 
     using ListenerCallback = std::function<void(Shell* shell, WSClient* client, const json& payload)>;
 
     std::mutex m_ListenersMutex;
     std::unordered_map<std::string, std::vector<ListenerCallback>> m_Listeners;
 
+    // Emits of a topic within this window are collapsed into one broadcast of the latest value.
+    static constexpr auto EmitCoalesceWindow = std::chrono::milliseconds(50);
+    // Topics are made up by scripts, beyond this many the least recently emitted one is forgotten.
+    static constexpr size_t MaxEmittedTopics = 1024;
+
+    std::mutex m_EmittedMutex;
+    std::unordered_map<std::string, EmittedTopic> m_Emitted;
+
     void IPCCallback(WSS::WSClient* ws, std::string_view message, uWS::OpCode opCode);
+    void FlushEmitted(const std::string& type);
+
+    /**
+     * Runs the callback on the IPC thread, dropped if the server isn't running.
+     */
+    void Defer(std::function<void()> callback);
 
    public:
     explicit IPC(Shell* shell) : m_Shell(shell) {
@@ -52,9 +87,39 @@ class IPC {
     IPC& operator=(IPC&&) = delete;
 
     void Start();
+
+    /**
+     * Closes all connections and joins the IPC threads. Called before the rest of the shell goes away,
+     * since the handlers use it.
+     */
+    void Stop();
+
+    /**
+     * Sends a message to all pages subscribed to its type, and to the ZMQ event stream. Can be called from any thread.
+     */
     void Broadcast(const std::string& type, const json& payload);
     void Send(WSClient* wsi, const std::string& type, const json& payload);
 
+    /**
+     * Sends a message to a client from any thread, e.g. the reply to a request that completes on the
+     * main thread. The message goes through the event loop of the IPC thread and is dropped if the
+     * client disconnected in the meantime.
+     * @param clientId The ID of the client (IPCClientInfo::id).
+     */
+    void SendLater(uint64_t clientId, const std::string& type, const json& payload);
+
+    /**
+     * Publishes a value from outside the shell (scripts, `wss dispatch emit`) as the "custom:<topic>"
+     * message to the pages subscribed to it. The latest value of every topic is cached and sent to
+     * pages right when they subscribe. Rapid emits are coalesced: the first one goes out right away,
+     * further ones within the coalescing window only as their latest value at the end of it, and a
+     * value equal to what subscribers already have isn't sent again. Only the latest MaxEmittedTopics
+     * topics are cached. Can be called from any thread.
+     * @param topic The topic, without the "custom:" prefix.
+     * @param payload The value.
+     */
+    void Emit(const std::string& topic, const json& payload);
+
     void Listen(const std::string& type, ListenerCallback callback) {
         std::lock_guard lock(m_ListenersMutex);
         m_Listeners[type].push_back(std::move(callback));
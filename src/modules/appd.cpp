@@ -4,34 +4,9 @@
 #include <sys/inotify.h>
 
 #include <filesystem>
-#include <regex>
 
 namespace fs = std::filesystem;
 
-std::vector<int> GetAvailableIconSizes(const std::string& iconName) {
-    std::vector<int> sizes;
-    std::string basePath = "/usr/share/icons/hicolor";
-
-    std::regex sizeDirRegex(R"((\d+)x\1)"); // matches "16x16", "32x32", etc.
-
-    for (const auto& entry : std::filesystem::directory_iterator(basePath)) {
-        if (!entry.is_directory()) continue;
-
-        std::smatch match;
-        std::string dirName = entry.path().filename().string();
-        if (std::regex_match(dirName, match, sizeDirRegex)) {
-            int size = std::stoi(match[1]);
-
-            std::filesystem::path iconPath = entry.path() / "apps" / (iconName + ".png");
-            if (std::filesystem::exists(iconPath)) {
-                sizes.push_back(size);
-            }
-        }
-    }
-
-    return sizes;
-}
-
 static const char b64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
 std::string EncodeBase64(const std::vector<unsigned char>& data) {
@@ -50,29 +25,6 @@ std::string EncodeBase64(const std::vector<unsigned char>& data) {
     return result;
 }
 
-std::optional<fs::path> FindIconPath(const std::string& iconName, int sizeHint = 64) {
-    const std::vector<std::string> iconDirs = {
-        "/usr/share/icons/hicolor",
-        "/usr/share/icons",
-        "/usr/share/pixmaps",
-        std::string(getenv("HOME")) + "/.local/share/icons",
-    };
-
-    const std::vector<std::string> extensions = {".png", ".svg", ".xpm"};
-
-    for (const auto& dir : iconDirs) {
-        for (const auto& ext : extensions) {
-            fs::path iconPath =
-                fs::path(dir) / (std::to_string(sizeHint) + "x" + std::to_string(sizeHint)) / "apps" / (iconName + ext);
-            if (fs::exists(iconPath)) return iconPath;
-
-            iconPath = fs::path(dir) / (iconName + ext);
-            if (fs::exists(iconPath)) return iconPath;
-        }
-    }
-    return std::nullopt;
-}
-
 std::vector<unsigned char> ReadFileBytes(const fs::path& filePath) {
     std::ifstream file(filePath, std::ios::binary);
     return std::vector<unsigned char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
@@ -128,44 +80,12 @@ WSS::Application WSS::Appd::ReadDesktopFile(const std::string& filePath) {
     std::string iconSmallBase64, iconLargeBase64;
 
     if (!icon.empty()) {
-        auto availableSizes = GetAvailableIconSizes(icon); // Returns list like {16, 24, 32, 48, 64, 128, 256}
-
-        auto findClosestSize = [&](int targetSize) -> std::optional<int> {
-            if (availableSizes.empty()) return std::nullopt;
-
-            auto closest = availableSizes.front();
-            for (int size : availableSizes) {
-                if (std::abs(size - targetSize) < std::abs(closest - targetSize)) {
-                    closest = size;
-                }
-            }
-            return closest;
-        };
-
-        // Small icon
-        if (auto smallSize = findClosestSize(48)) {
-            if (auto smallPath = FindIconPath(icon, *smallSize)) {
-                iconSmallBase64 = EncodeBase64(ReadFileBytes(*smallPath));
-            }
-        }
-        if (iconSmallBase64.empty()) {
-            std::filesystem::path pixmapPath = "/usr/share/pixmaps/" + icon + ".png";
-            if (std::filesystem::exists(pixmapPath)) {
-                iconSmallBase64 = EncodeBase64(ReadFileBytes(pixmapPath.string()));
-            }
+        const IconTheme& iconTheme = m_Shell->GetIconTheme();
+        if (auto smallPath = iconTheme.Lookup(icon, 48)) {
+            iconSmallBase64 = EncodeBase64(ReadFileBytes(*smallPath));
         }
-
-        // Large icon
-        if (auto largeSize = findClosestSize(128)) {
-            if (auto largePath = FindIconPath(icon, *largeSize)) {
-                iconLargeBase64 = EncodeBase64(ReadFileBytes(*largePath));
-            }
-        }
-        if (iconLargeBase64.empty()) {
-            std::filesystem::path pixmapPath = "/usr/share/pixmaps/" + icon + ".png";
-            if (std::filesystem::exists(pixmapPath)) {
-                iconLargeBase64 = EncodeBase64(ReadFileBytes(pixmapPath.string()));
-            }
+        if (auto largePath = iconTheme.Lookup(icon, 128)) {
+            iconLargeBase64 = EncodeBase64(ReadFileBytes(*largePath));
         }
     }
     std::string fileId = fs::path(filePath).filename().string();
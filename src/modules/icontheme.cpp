@@ -0,0 +1,366 @@
+#include "icontheme.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+static const std::vector<std::string> IconExtensions = {".png", ".svg", ".xpm"}; // In order of preference
+
+static std::vector<std::string> SplitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+/**
+ * Reads an index.theme into section -> key -> value.
+ */
+static std::unordered_map<std::string, std::unordered_map<std::string, std::string>> ReadThemeIndex(const fs::path& path) {
+    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> sections;
+    std::ifstream file(path);
+    std::string line;
+    std::string section;
+    while (std::getline(file, line)) {
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        if (line.front() == '[' && line.back() == ']') {
+            section = line.substr(1, line.size() - 2);
+            continue;
+        }
+        const auto pos = line.find('=');
+        if (pos == std::string::npos) {
+            continue;
+        }
+
+        std::string key = line.substr(0, pos);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        std::string value = line.substr(pos + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        sections[section][key] = value;
+    }
+    return sections;
+}
+
+static int ParseInt(const std::unordered_map<std::string, std::string>& values, const std::string& key, const int fallback) {
+    const auto it = values.find(key);
+    if (it == values.end()) {
+        return fallback;
+    }
+    try {
+        return std::stoi(it->second);
+    } catch (const std::exception&) {
+        return fallback;
+    }
+}
+
+bool WSS::IconDirectory::MatchesSize(const int size, const int scale) const {
+    if (Scale != scale) {
+        return false;
+    }
+    switch (Type) {
+    case IconDirectoryType::FIXED:
+        return Size == size;
+    case IconDirectoryType::SCALABLE:
+        return MinSize <= size && size <= MaxSize;
+    case IconDirectoryType::THRESHOLD:
+        return Size - Threshold <= size && size <= Size + Threshold;
+    }
+    return false;
+}
+
+int WSS::IconDirectory::SizeDistance(const int size, const int scale) const {
+    const int scaled = size * scale;
+    switch (Type) {
+    case IconDirectoryType::FIXED:
+        return std::abs(Size * Scale - scaled);
+    case IconDirectoryType::SCALABLE:
+        if (scaled < MinSize * Scale) {
+            return MinSize * Scale - scaled;
+        }
+        if (scaled > MaxSize * Scale) {
+            return scaled - MaxSize * Scale;
+        }
+        return 0;
+    case IconDirectoryType::THRESHOLD:
+        if (scaled < (Size - Threshold) * Scale) {
+            return (Size - Threshold) * Scale - scaled;
+        }
+        if (scaled > (Size + Threshold) * Scale) {
+            return scaled - (Size + Threshold) * Scale;
+        }
+        return 0;
+    }
+    return INT_MAX;
+}
+
+WSS::IconTheme::~IconTheme() {
+    if (m_Running.exchange(false)) {
+        const uint64_t one = 1;
+        if (write(m_WakeFd, &one, sizeof(one)) != sizeof(one)) {
+            WSS_ERROR("Failed to wake the icon theme watcher: {}", strerror(errno));
+        }
+        if (m_Thread.joinable()) {
+            m_Thread.join();
+        }
+    }
+    if (m_WakeFd >= 0) {
+        close(m_WakeFd);
+    }
+}
+
+void WSS::IconTheme::Start(const std::string& themeName) {
+    m_ThemeName = themeName;
+
+    // The lookup order of the icon theme specification.
+    if (const char* home = getenv("HOME")) {
+        m_BaseDirs.push_back(fs::path(home) / ".icons");
+    }
+    if (const char* dataHome = getenv("XDG_DATA_HOME"); dataHome && *dataHome) {
+        m_BaseDirs.push_back(fs::path(dataHome) / "icons");
+    } else if (const char* home = getenv("HOME")) {
+        m_BaseDirs.push_back(fs::path(home) / ".local/share/icons");
+    }
+    const char* dataDirs = getenv("XDG_DATA_DIRS");
+    std::stringstream stream(dataDirs && *dataDirs ? dataDirs : "/usr/local/share:/usr/share");
+    std::string dir;
+    while (std::getline(stream, dir, ':')) {
+        if (!dir.empty()) {
+            m_BaseDirs.push_back(fs::path(dir) / "icons");
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    Build();
+    WSS_INFO("Indexed {} icons of theme '{}' in {:.1f} ms.", GetIconCount(), m_ThemeName.empty() ? "hicolor" : m_ThemeName,
+             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    m_WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_Running = true;
+    m_Thread = std::thread([this]() { Watch(); });
+}
+
+void WSS::IconTheme::Build() {
+    std::vector<IconDirectory> directories;
+    std::unordered_map<std::string, std::vector<IconCandidate>> icons;
+    std::unordered_map<std::string, fs::path> pixmaps;
+    std::vector<fs::path> watched;
+    std::unordered_set<std::string> watchedSet;
+    // Watches the directory, or if it doesn't exist (yet) the closest parent in the base directory,
+    // so creating it (e.g. installing a theme, or a size the theme didn't ship) triggers a rebuild.
+    const auto watch = [&](fs::path path, const fs::path& base) {
+        std::error_code error;
+        while (path != base && !fs::is_directory(path, error)) {
+            path = path.parent_path();
+        }
+        if (fs::is_directory(path, error) && watchedSet.insert(path.string()).second) {
+            watched.push_back(path);
+        }
+    };
+
+    const auto findIndex = [this](const std::string& theme) -> std::optional<fs::path> {
+        for (const auto& base : m_BaseDirs) {
+            std::error_code error;
+            if (fs::path index = base / theme / "index.theme"; fs::exists(index, error)) {
+                return index;
+            }
+        }
+        return std::nullopt;
+    };
+
+    // The current theme, the themes it inherits from (breadth first), then hicolor.
+    std::vector<std::string> chain;
+    std::unordered_set<std::string> seen;
+    if (!m_ThemeName.empty() && m_ThemeName != "hicolor") {
+        chain.push_back(m_ThemeName);
+        seen.insert(m_ThemeName);
+    }
+    std::vector<std::unordered_map<std::string, std::unordered_map<std::string, std::string>>> indexes;
+    for (size_t i = 0; i < chain.size(); i++) {
+        const auto index = findIndex(chain[i]);
+        indexes.push_back(index ? ReadThemeIndex(*index) : decltype(indexes)::value_type{});
+        for (const auto& parent : SplitList(indexes.back()["Icon Theme"]["Inherits"])) {
+            if (parent != "hicolor" && seen.insert(parent).second) {
+                chain.push_back(parent);
+            }
+        }
+    }
+    chain.push_back("hicolor");
+    const auto hicolor = findIndex("hicolor");
+    indexes.push_back(hicolor ? ReadThemeIndex(*hicolor) : decltype(indexes)::value_type{});
+
+    for (size_t rank = 0; rank < chain.size(); rank++) {
+        auto& index = indexes[rank];
+        auto subdirs = SplitList(index["Icon Theme"]["Directories"]);
+        const auto scaled = SplitList(index["Icon Theme"]["ScaledDirectories"]);
+        subdirs.insert(subdirs.end(), scaled.begin(), scaled.end());
+
+        for (const auto& base : m_BaseDirs) {
+            watch(base / chain[rank], base);
+        }
+
+        for (const auto& subdir : subdirs) {
+            const auto& values = index[subdir];
+            IconDirectory directory{.Size = ParseInt(values, "Size", 0), .Scale = ParseInt(values, "Scale", 1)};
+            directory.MinSize = ParseInt(values, "MinSize", directory.Size);
+            directory.MaxSize = ParseInt(values, "MaxSize", directory.Size);
+            directory.Threshold = ParseInt(values, "Threshold", 2);
+            const auto type = values.contains("Type") ? values.at("Type") : "Threshold";
+            directory.Type = type == "Fixed"      ? IconDirectoryType::FIXED
+                             : type == "Scalable" ? IconDirectoryType::SCALABLE
+                                                  : IconDirectoryType::THRESHOLD;
+            if (directory.Size <= 0) {
+                continue;
+            }
+
+            const auto directoryIndex = static_cast<uint32_t>(directories.size());
+            directories.push_back(directory);
+
+            for (const auto& base : m_BaseDirs) {
+                const fs::path path = base / chain[rank] / subdir;
+                watch(path, base);
+                std::error_code error;
+                if (!fs::is_directory(path, error)) {
+                    continue;
+                }
+
+                for (const auto& entry : fs::directory_iterator(path, error)) {
+                    const auto extension = entry.path().extension().string();
+                    if (std::ranges::find(IconExtensions, extension) == IconExtensions.end()) {
+                        continue;
+                    }
+                    icons[entry.path().stem().string()].push_back(
+                        {.Theme = static_cast<uint16_t>(rank), .Directory = directoryIndex, .Path = entry.path()});
+                }
+            }
+        }
+    }
+
+    // Unthemed icons, the last resort: loose icons in the base directories (e.g. /usr/share/icons/foo.png),
+    // then /usr/share/pixmaps.
+    std::vector<fs::path> unthemed = m_BaseDirs;
+    if (std::ranges::find(unthemed, fs::path("/usr/share/icons")) == unthemed.end()) {
+        unthemed.emplace_back("/usr/share/icons");
+    }
+    unthemed.emplace_back("/usr/share/pixmaps");
+    for (const auto& dir : unthemed) {
+        watch(dir, dir);
+        std::error_code error;
+        for (const auto& entry : fs::directory_iterator(dir, error)) {
+            const auto extension = entry.path().extension().string();
+            if (std::ranges::find(IconExtensions, extension) == IconExtensions.end() || !entry.is_regular_file(error)) {
+                continue;
+            }
+            pixmaps.try_emplace(entry.path().stem().string(), entry.path());
+        }
+    }
+
+    std::unique_lock lock(m_Mutex);
+    m_Directories = std::move(directories);
+    m_Icons = std::move(icons);
+    m_Pixmaps = std::move(pixmaps);
+    m_WatchedDirs = std::move(watched);
+}
+
+std::optional<fs::path> WSS::IconTheme::Lookup(const std::string& name, const int size, const int scale) const {
+    if (name.empty()) {
+        return std::nullopt;
+    }
+    if (name.starts_with('/')) {
+        std::error_code error;
+        return fs::exists(name, error) ? std::optional<fs::path>(name) : std::nullopt;
+    }
+
+    std::shared_lock lock(m_Mutex);
+    if (const auto it = m_Icons.find(name); it != m_Icons.end()) {
+        // Only the first theme in the chain that has the icon counts, even if a parent has a better size.
+        uint16_t theme = UINT16_MAX;
+        for (const auto& candidate : it->second) {
+            theme = std::min(theme, candidate.Theme);
+        }
+
+        const IconCandidate* best = nullptr;
+        int bestDistance = INT_MAX;
+        for (const auto& candidate : it->second) {
+            if (candidate.Theme != theme) {
+                continue;
+            }
+            const auto& directory = m_Directories[candidate.Directory];
+            const int distance = directory.MatchesSize(size, scale) ? -1 : directory.SizeDistance(size, scale);
+            const bool preferred = best && distance == bestDistance && best->Directory == candidate.Directory &&
+                                   std::ranges::find(IconExtensions, candidate.Path.extension().string()) <
+                                       std::ranges::find(IconExtensions, best->Path.extension().string());
+            if (distance < bestDistance || preferred) {
+                best = &candidate;
+                bestDistance = distance;
+            }
+        }
+        if (best) {
+            return best->Path;
+        }
+    }
+
+    if (const auto it = m_Pixmaps.find(name); it != m_Pixmaps.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+void WSS::IconTheme::Watch() {
+    while (m_Running) {
+        const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            WSS_ERROR("Failed to watch the icon themes: {}", strerror(errno));
+            return;
+        }
+        {
+            std::shared_lock lock(m_Mutex);
+            for (const auto& dir : m_WatchedDirs) {
+                inotify_add_watch(fd, dir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM | IN_CLOSE_WRITE);
+            }
+        }
+
+        // Package installs touch many files at once, the index is rebuilt once they went quiet.
+        bool changed = false;
+        pollfd fds[] = {{.fd = fd, .events = POLLIN, .revents = 0}, {.fd = m_WakeFd, .events = POLLIN, .revents = 0}};
+        while (m_Running) {
+            const int ready = poll(fds, 2, changed ? 1000 : -1);
+            if (ready == 0) {
+                break; // Quiet again after a change
+            }
+            if (ready < 0 || !(fds[0].revents & POLLIN)) {
+                continue;
+            }
+            char buffer[4096];
+            while (read(fd, buffer, sizeof(buffer)) > 0) {
+            }
+            changed = true;
+        }
+        close(fd);
+
+        if (changed && m_Running) {
+            WSS_DEBUG("Icon themes changed, rebuilding the icon index.");
+            Build();
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef ICONTHEME_H
+#define ICONTHEME_H
+
+#include <pch.h>
+
+#include <filesystem>
+#include <optional>
+#include <shared_mutex>
+
+namespace WSS {
+enum class IconDirectoryType { FIXED, SCALABLE, THRESHOLD };
+
+/**
+ * A directory of an icon theme, as described by its index.theme.
+ */
+struct IconDirectory {
+    int Size = 0;
+    int Scale = 1;
+    int MinSize = 0;
+    int MaxSize = 0;
+    int Threshold = 2;
+    IconDirectoryType Type = IconDirectoryType::THRESHOLD;
+
+    [[nodiscard]] bool MatchesSize(int size, int scale) const;
+    [[nodiscard]] int SizeDistance(int size, int scale) const;
+};
+
+struct IconCandidate {
+    uint16_t Theme;     // Position in the inheritance chain, the current theme is 0
+    uint32_t Directory; // Index into the directory table
+    std::filesystem::path Path;
+};
+
+/**
+ * Index of the freedesktop icon themes, built once by reading every theme directory, so looking up
+ * an icon is a hash map lookup instead of probing the file system.
+ * Covers the current theme and the themes it inherits from (hicolor last), in all XDG data dirs
+ * and ~/.icons, and the unsized icons directly in those directories and in /usr/share/pixmaps.
+ * Lookups pick the size like the icon theme specification does (exact match, scalable and threshold
+ * directories, else the closest size). The index is rebuilt in the background when icons, themes or
+ * theme directories are installed or removed (watched with inotify).
+ * All methods are thread-safe.
+ */
+class IconTheme {
+    std::string m_ThemeName;
+    std::vector<std::filesystem::path> m_BaseDirs;
+
+    std::vector<IconDirectory> m_Directories;
+    std::unordered_map<std::string, std::vector<IconCandidate>> m_Icons;
+    std::unordered_map<std::string, std::filesystem::path> m_Pixmaps;
+    std::vector<std::filesystem::path> m_WatchedDirs;
+    mutable std::shared_mutex m_Mutex;
+
+    std::thread m_Thread;
+    std::atomic_bool m_Running{false};
+    int m_WakeFd = -1;
+
+    void Build();
+    void Watch();
+
+   public:
+    IconTheme() = default;
+    ~IconTheme();
+
+    IconTheme(const IconTheme&) = delete;
+    IconTheme(IconTheme&&) = delete;
+    IconTheme& operator=(IconTheme&&) = delete;
+
+    /**
+     * Builds the index and starts watching the theme directories.
+     * @param themeName The current icon theme, e.g. "Adwaita". Empty for hicolor only.
+     */
+    void Start(const std::string& themeName);
+
+    /**
+     * Finds the file of an icon.
+     * @param name The icon name (e.g. "firefox"), file paths are returned as they are if they exist.
+     * @param size The size in pixels the icon is displayed at.
+     * @param scale The scale of the display.
+     */
+    [[nodiscard]] std::optional<std::filesystem::path> Lookup(const std::string& name, int size = 64, int scale = 1) const;
+
+    [[nodiscard]] size_t GetIconCount() const {
+        std::shared_lock lock(m_Mutex);
+        return m_Icons.size();
+    }
+};
+} // namespace WSS
+
+#endif // ICONTHEME_H
@@ -0,0 +1,248 @@
+#include "imagecache.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QUrl>
+#include <format>
+
+#include "icontheme.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * FNV-1a, enough to tell images apart without pulling in a crypto library.
+ */
+static uint64_t HashBytes(const void* data, const size_t size, uint64_t hash = 14695981039346656037ULL) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @return The MIME type of an image format (as named by QImageReader) that pages can display as it
+ *         is, or nothing if the image has to be re-encoded.
+ */
+static std::optional<std::string> GetWebMimeType(const QByteArray& format) {
+    if (format == "png") {
+        return "image/png";
+    }
+    if (format == "jpeg" || format == "jpg") {
+        return "image/jpeg";
+    }
+    if (format == "gif") {
+        return "image/gif";
+    }
+    if (format == "webp") {
+        return "image/webp";
+    }
+    return std::nullopt;
+}
+
+static std::shared_ptr<const std::string> EncodePng(const QImage& image) {
+    QByteArray encoded;
+    QBuffer buffer(&encoded);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "PNG")) {
+        return nullptr;
+    }
+    return std::make_shared<const std::string>(encoded.constData(), encoded.size());
+}
+
+void WSS::ImageCache::SetMaxBytes(const size_t maxBytes) {
+    std::lock_guard lock(m_Mutex);
+    m_MaxBytes = maxBytes;
+    Evict();
+}
+
+bool WSS::ImageCache::TouchAndPin(const std::string& key) {
+    std::lock_guard lock(m_Mutex);
+    const auto it = m_Entries.find(key);
+    if (it == m_Entries.end()) {
+        return false;
+    }
+    it->second.Pins++;
+    m_Recent.splice(m_Recent.begin(), m_Recent, it->second.Recent);
+    return true;
+}
+
+void WSS::ImageCache::InsertAndPin(const std::string& key, CachedImage image) {
+    std::lock_guard lock(m_Mutex);
+    if (const auto it = m_Entries.find(key); it != m_Entries.end()) {
+        it->second.Pins++; // Encoded concurrently
+        return;
+    }
+    m_Bytes += image.Data->size();
+    m_Recent.push_front(key);
+    m_Entries[key] = {.Image = std::move(image), .Recent = m_Recent.begin(), .Pins = 1};
+    Evict();
+}
+
+void WSS::ImageCache::Evict() {
+    // Pinned entries are kept even if they alone exceed the limit, an open notification refers to them.
+    auto it = m_Recent.end();
+    while (m_Bytes > m_MaxBytes && it != m_Recent.begin()) {
+        --it;
+        const auto entry = m_Entries.find(*it);
+        if (entry->second.Pins > 0) {
+            continue;
+        }
+        m_Bytes -= entry->second.Image.Data->size();
+        WSS_DEBUG("Evicted notification image {} from the cache.", entry->first);
+        m_Entries.erase(entry);
+        it = m_Recent.erase(it);
+    }
+}
+
+void WSS::ImageCache::Unpin(const std::string& key) {
+    if (key.empty()) {
+        return;
+    }
+    std::lock_guard lock(m_Mutex);
+    const auto it = m_Entries.find(key);
+    if (it == m_Entries.end() || it->second.Pins == 0) {
+        return;
+    }
+    if (--it->second.Pins == 0) {
+        Evict();
+    }
+}
+
+std::optional<std::string> WSS::ImageCache::AddPixels(const sdbus::Variant& imageData) {
+    using PixelStruct = sdbus::Struct<int32_t, int32_t, int32_t, bool, int32_t, int32_t, std::vector<uint8_t>>;
+
+    PixelStruct pixels;
+    try {
+        pixels = imageData.get<PixelStruct>();
+    } catch (const sdbus::Error& e) {
+        WSS_WARN("Notification image data is not a (iiibiiay) struct: {}", e.what());
+        return std::nullopt;
+    }
+    const int32_t width = std::get<0>(pixels);
+    const int32_t height = std::get<1>(pixels);
+    const int32_t rowstride = std::get<2>(pixels);
+    const bool hasAlpha = std::get<3>(pixels);
+    const int32_t bitsPerSample = std::get<4>(pixels);
+    const int32_t channels = std::get<5>(pixels);
+    const auto& data = std::get<6>(pixels);
+
+    if (width <= 0 || height <= 0 || width > 4096 || height > 4096 || bitsPerSample != 8 ||
+        channels != (hasAlpha ? 4 : 3) || rowstride < width * channels ||
+        data.size() < static_cast<size_t>(rowstride) * (height - 1) + static_cast<size_t>(width) * channels) {
+        WSS_WARN("Ignoring malformed notification image data ({}x{}, rowstride {}, {} channels, {} bytes).", width, height,
+                 rowstride, channels, data.size());
+        return std::nullopt;
+    }
+
+    const int32_t header[] = {width, height, rowstride, channels};
+    const std::string key = std::format("{:016x}", HashBytes(data.data(), data.size(), HashBytes(header, sizeof(header))));
+    if (TouchAndPin(key)) {
+        return key;
+    }
+
+    const QImage image(data.data(), width, height, rowstride, hasAlpha ? QImage::Format_RGBA8888 : QImage::Format_RGB888);
+    auto encoded = EncodePng(image);
+    if (!encoded) {
+        WSS_WARN("Failed to encode notification image data.");
+        return std::nullopt;
+    }
+
+    InsertAndPin(key, {.MimeType = "image/png", .Data = std::move(encoded)});
+    return key;
+}
+
+std::optional<std::string> WSS::ImageCache::AddFile(const fs::path& path) {
+    // Clients name any path they like, only images the cache can hold are read.
+    std::error_code typeError, sizeError, timeError;
+    const bool regular = fs::is_regular_file(path, typeError);
+    const auto size = fs::file_size(path, sizeError);
+    const auto modified = fs::last_write_time(path, timeError);
+    if (!regular || typeError || sizeError || timeError) {
+        return std::nullopt;
+    }
+    size_t maxBytes = 0;
+    {
+        std::lock_guard lock(m_Mutex);
+        maxBytes = std::min(m_MaxBytes, MaxFileBytes);
+    }
+    if (size == 0 || size > maxBytes) {
+        WSS_WARN("Ignoring notification image {}: {} bytes, at most {} are allowed.", path.string(), size, maxBytes);
+        return std::nullopt;
+    }
+
+    const std::string source = std::format("{}:{}:{}", path.string(), size, modified.time_since_epoch().count());
+    const std::string key = std::format("{:016x}", HashBytes(source.data(), source.size()));
+    if (TouchAndPin(key)) {
+        return key;
+    }
+
+    QFile file(QString::fromStdString(path.string()));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    // Read at most one byte more than allowed, in case the file grew since it was checked.
+    QByteArray bytes = file.read(static_cast<qint64>(maxBytes) + 1);
+    if (bytes.isEmpty() || static_cast<size_t>(bytes.size()) > maxBytes) {
+        return std::nullopt;
+    }
+
+    // Only actual images are served, typed by their content rather than their extension. Formats
+    // pages can't display (or that can carry scripts, like SVG) are re-encoded to PNG.
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    reader.setDecideFormatFromContent(true);
+    const QByteArray format = reader.format();
+    const QSize imageSize = reader.size();
+    if (imageSize.isValid() && (imageSize.width() > 4096 || imageSize.height() > 4096)) {
+        reader.setScaledSize(imageSize.scaled(4096, 4096, Qt::KeepAspectRatio));
+    }
+    const QImage image = reader.read();
+    if (image.isNull()) {
+        WSS_WARN("Ignoring notification image {}: {}", path.string(), reader.errorString().toStdString());
+        return std::nullopt;
+    }
+
+    CachedImage cached;
+    if (const auto mimeType = GetWebMimeType(format); mimeType && !reader.scaledSize().isValid()) {
+        cached = {.MimeType = *mimeType, .Data = std::make_shared<const std::string>(bytes.constData(), bytes.size())};
+    } else if (auto encoded = EncodePng(image)) {
+        cached = {.MimeType = "image/png", .Data = std::move(encoded)};
+    } else {
+        WSS_WARN("Failed to encode notification image {}.", path.string());
+        return std::nullopt;
+    }
+    InsertAndPin(key, std::move(cached));
+    return key;
+}
+
+std::optional<std::string> WSS::ImageCache::AddIcon(const std::string& icon) {
+    if (icon.empty()) {
+        return std::nullopt;
+    }
+    if (icon.starts_with("file://")) {
+        return AddFile(QUrl(QString::fromStdString(icon)).toLocalFile().toStdString());
+    }
+    if (icon.starts_with('/')) {
+        return AddFile(icon);
+    }
+    if (!m_IconTheme) {
+        return std::nullopt;
+    }
+    if (const auto path = m_IconTheme->Lookup(icon)) {
+        return AddFile(*path);
+    }
+    return std::nullopt;
+}
+
+std::optional<WSS::CachedImage> WSS::ImageCache::Get(const std::string& key) {
+    std::lock_guard lock(m_Mutex);
+    const auto it = m_Entries.find(key);
+    if (it == m_Entries.end()) {
+        return std::nullopt;
+    }
+    return it->second.Image;
+}
@@ -0,0 +1,97 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <pch.h>
+
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <optional>
+
+namespace WSS {
+class IconTheme;
+
+struct CachedImage {
+    std::string MimeType;
+    std::shared_ptr<const std::string> Data;
+};
+
+/**
+ * Caches the images notifications refer to, so pages load them by URL instead of receiving them
+ * inline. Entries are keyed by a hash of their source (the raw pixels, or a file's path, size and
+ * modification time), so an image that is sent again (e.g. the same app icon) is only encoded once.
+ * Least recently used entries are dropped once the cache exceeds its size, except for pinned ones:
+ * every Add*() pins the entry it returns, until the notification referring to it is gone and Unpin()
+ * is called, so a page never gets a 404 for the image of an open notification.
+ * All methods are thread-safe.
+ */
+class ImageCache {
+    static constexpr size_t MaxFileBytes = 8 * 1024 * 1024; // Of an image file, also capped by the cache size
+
+    struct Entry {
+        CachedImage Image;
+        std::list<std::string>::iterator Recent;
+        int Pins = 0;
+    };
+
+    size_t m_MaxBytes;
+    size_t m_Bytes = 0;
+    std::unordered_map<std::string, Entry> m_Entries;
+    std::list<std::string> m_Recent; // Most recently used first
+    mutable std::mutex m_Mutex;
+    const IconTheme* m_IconTheme = nullptr;
+
+    bool TouchAndPin(const std::string& key);
+    void InsertAndPin(const std::string& key, CachedImage image);
+    /**
+     * Drops the least recently used unpinned entries until the cache fits its size. Requires the lock.
+     */
+    void Evict();
+
+  public:
+    explicit ImageCache(const size_t maxBytes = 32 * 1024 * 1024) : m_MaxBytes(maxBytes) {}
+
+    void SetMaxBytes(size_t maxBytes);
+
+    /**
+     * Sets the theme icon names are looked up in, without one only paths are accepted.
+     */
+    void SetIconTheme(const IconTheme* iconTheme) { m_IconTheme = iconTheme; }
+
+    /**
+     * Encodes raw pixels, as sent in the image-data hint, to PNG.
+     * @param imageData The (iiibiiay) struct: width, height, rowstride, has alpha, bits per sample, channels, data.
+     * @return The key of the image (pinned), or nothing if the struct is malformed.
+     */
+    std::optional<std::string> AddPixels(const sdbus::Variant& imageData);
+
+    /**
+     * Adds an image by file path, file:// URI or icon theme name, as in the app_icon argument and the
+     * image-path hint.
+     * @return The key of the image (pinned), or nothing if it could not be found.
+     */
+    std::optional<std::string> AddIcon(const std::string& icon);
+
+    /**
+     * Adds an image file. Only regular files that fit the cache and decode as an image are accepted,
+     * formats pages can't display as they are (SVG, XPM, ...) are re-encoded to PNG.
+     * @return The key of the image (pinned), or nothing if the file was rejected.
+     */
+    std::optional<std::string> AddFile(const std::filesystem::path& path);
+
+    /**
+     * Releases a pin taken by one of the Add*() methods, the entry may be evicted once it has none left.
+     * @param key The key of the image, ignored if empty.
+     */
+    void Unpin(const std::string& key);
+
+    [[nodiscard]] std::optional<CachedImage> Get(const std::string& key);
+
+    [[nodiscard]] size_t GetSize() const {
+        std::lock_guard lock(m_Mutex);
+        return m_Bytes;
+    }
+};
+} // namespace WSS
+
+#endif // IMAGECACHE_H
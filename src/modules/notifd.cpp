@@ -3,19 +3,30 @@
 #include "shell.h"
 #include "util/dbus_vreader.h"
 
+#include <algorithm>
+#include <format>
+#include <fstream>
+
 void WSS::Notifd::StartExpirationTimer(uint32_t id, int32_t timeoutMs) {
-    std::thread([this, id, timeoutMs]() {
-        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+    const uint64_t key = ++m_TimerKeyCounter;
+    if (const auto previous = m_ExpiryKeys.find(id); previous != m_ExpiryKeys.end()) {
+        m_Timers.Cancel(previous->second);
+    }
+    m_ExpiryKeys[id] = key;
+
+    m_Timers.Schedule(key, std::chrono::milliseconds(timeoutMs), [this, id, key, timeoutMs]() {
         {
             std::lock_guard lock(m_NotificationsMutex);
-            if (m_Notifications.find(id) != m_Notifications.end()) {
-                WSS_DEBUG("Notification ID={} expired after {} ms", id, timeoutMs);
-            } else {
-                return; // Already removed or closed
+            const auto expiry = m_ExpiryKeys.find(id);
+            const auto it = m_Notifications.find(id);
+            if (expiry == m_ExpiryKeys.end() || expiry->second != key || it == m_Notifications.end()) {
+                return; // Closed or replaced while the timer fired
             }
+            WSS_DEBUG("Notification ID={} expired after {} ms", id, timeoutMs);
+            EraseNotification(it);
         }
-        SignalNotificationClosed(id, NotificationCloseReason::EXPIRED);
-    }).detach();
+        PublishClosed(id, NotificationCloseReason::EXPIRED);
+    });
 }
 
 json WSS::Notifd::CreateNotificationPayload(const Notification& notification) const {
@@ -33,20 +44,90 @@ json WSS::Notifd::CreateNotificationPayload(const Notification& notification) co
         payload["actions"].push_back(action);
     }
 
-    // Convert hints
-    json hints;
-    for (const auto& [key, value] : notification.Hints) {
-        auto valueStr = ReadDbusVariant(value);
-        hints[key] = valueStr;
+    // Pixel data can be megabytes, pages load it through the image URL instead.
+    auto hints = notification.Hints;
+    for (const auto* key : {"image-data", "image_data", "icon_data"}) {
+        hints.erase(key);
     }
-    payload["hints"] = hints;
+    payload["hints"] = ReadDbusMap(hints);
+    payload["image"] = notification.ImageKey.empty() ? json(nullptr) : json(GetImageUrl(notification.ImageKey));
+    payload["appIconUrl"] = notification.AppIconKey.empty() ? json(nullptr) : json(GetImageUrl(notification.AppIconKey));
 
     payload["expireTimeout"] = notification.ExpireTimeout;
+    if (notification.HistorySeq != 0) {
+        payload["historySeq"] = notification.HistorySeq;
+    }
 
     return payload;
 }
 
+std::string WSS::Notifd::GetImageUrl(const std::string& key) const {
+    return std::format("http://localhost:{}/notifd/image/{}", m_Shell->GetSettings().m_IpcPort, key);
+}
+
+void WSS::Notifd::ResolveImages(Notification& notification) {
+    // The spec's order of precedence: image-data, image-path, then the app icon.
+    for (const auto* hint : {"image-data", "image_data", "icon_data"}) {
+        if (const auto it = notification.Hints.find(hint); it != notification.Hints.end()) {
+            notification.ImageKey = m_Images.AddPixels(it->second).value_or("");
+            break;
+        }
+    }
+    if (notification.ImageKey.empty()) {
+        for (const auto* hint : {"image-path", "image_path"}) {
+            if (const auto it = notification.Hints.find(hint);
+                it != notification.Hints.end() && it->second.containsValueOfType<std::string>()) {
+                notification.ImageKey = m_Images.AddIcon(it->second.get<std::string>()).value_or("");
+                break;
+            }
+        }
+    }
+    notification.AppIconKey = m_Images.AddIcon(notification.AppIcon).value_or("");
+}
+
+void WSS::Notifd::UnpinImages(const Notification& notification) {
+    m_Images.Unpin(notification.ImageKey);
+    m_Images.Unpin(notification.AppIconKey);
+}
+
+void WSS::Notifd::QueueNotification(std::variant<Notification, uint32_t> event) {
+    {
+        std::lock_guard lock(m_ImageQueueMutex);
+        m_ImageQueue.push_back(std::move(event));
+    }
+    m_ImageQueueCondition.notify_one();
+}
+
 void WSS::Notifd::Start() {
+    m_Timers.Start();
+    m_Images.SetMaxBytes(static_cast<size_t>(m_Shell->GetSettings().m_NotificationImageCacheMb) * 1024 * 1024);
+    m_Images.SetIconTheme(&m_Shell->GetIconTheme());
+    m_History.Open(std::filesystem::path(m_Shell->GetSettings().m_DataDir) / "notifications.log",
+                   std::max(0, m_Shell->GetSettings().m_NotificationHistory));
+
+    m_ImageWorkerRunning = true;
+    m_ImageWorker = std::thread([this]() {
+        while (true) {
+            std::variant<Notification, uint32_t> event;
+            {
+                std::unique_lock lock(m_ImageQueueMutex);
+                m_ImageQueueCondition.wait(lock, [this]() { return !m_ImageQueue.empty() || !m_ImageWorkerRunning; });
+                if (!m_ImageWorkerRunning) {
+                    return;
+                }
+                event = std::move(m_ImageQueue.front());
+                m_ImageQueue.pop_front();
+            }
+            if (const auto* closedId = std::get_if<uint32_t>(&event)) {
+                SignalNotificationClosed(*closedId, NotificationCloseReason::CLOSED_BY_CLIENT);
+                continue;
+            }
+            auto& notification = std::get<Notification>(event);
+            ResolveImages(notification);
+            AddNotification(notification);
+        }
+    });
+
     m_Thread = std::thread([this]() {
         try {
             WSS_DEBUG("Starting Notifd...");
@@ -65,23 +146,18 @@ void WSS::Notifd::Start() {
                 WSS_DEBUG("Received notification: ID={}, AppName={}, Summary={}, Body={}, Actions={}, Hints={}, ExpireTimeout={}",
                           id, app_name, summary, body, actions.size(), hints.size(), expire_timeout);
 
-                {
-                    const Notification notification{.Id = id,
-                                                    .AppName = app_name,
-                                                    .AppIcon = app_icon,
-                                                    .Summary = summary,
-                                                    .Body = body,
-                                                    .Actions = actions,
-                                                    .Hints = hints,
-                                                    .ExpireTimeout = m_Shell->GetSettings().m_NotificationTimeout};
-                    AddNotification(notification);
-                }
+                QueueNotification({.Id = id,
+                                   .AppName = app_name,
+                                   .AppIcon = app_icon,
+                                   .Summary = summary,
+                                   .Body = body,
+                                   .Actions = actions,
+                                   .Hints = hints,
+                                   .ExpireTimeout = m_Shell->GetSettings().m_NotificationTimeout});
 
                 return id;
             };
-            auto closeNotification = [&](const uint32_t id) {
-                SignalNotificationClosed(id, NotificationCloseReason::CLOSED_BY_CLIENT);
-            };
+            auto closeNotification = [&](const uint32_t id) { QueueNotification(id); };
             auto getCapabilities = []() -> std::vector<std::string> {
                 return {"body", "actions", "icon-static", "icon-multi", "persistence", "sound"};
             };
@@ -106,38 +182,218 @@ void WSS::Notifd::Start() {
 }
 
 void WSS::Notifd::AddNotification(const Notification& notification) {
-    std::lock_guard lock(m_NotificationsMutex);
+    json payload = CreateNotificationPayload(notification);
 
-    if (m_Notifications.find(notification.Id) != m_Notifications.end()) {
-        WSS_WARN("Notification with ID {} already exists. Replacing it.", notification.Id);
+    // A replaced notification is replaced in the history as well. Notifications are added from one
+    // thread only, so the one being replaced can't change in between.
+    uint64_t replaces = 0;
+    {
+        std::lock_guard lock(m_NotificationsMutex);
+        if (const auto it = m_Notifications.find(notification.Id); it != m_Notifications.end()) {
+            replaces = it->second.HistorySeq;
+        }
     }
+    Notification stored = notification;
+    stored.HistorySeq = m_History.Append(payload, notification.AppName, notification.GetUrgency(), replaces);
+    if (stored.HistorySeq != 0) {
+        payload["historySeq"] = stored.HistorySeq;
+    }
+
+    bool deliver = false;
+    {
+        std::lock_guard lock(m_NotificationsMutex);
+
+        if (const auto it = m_Notifications.find(notification.Id); it != m_Notifications.end()) {
+            WSS_WARN("Notification with ID {} already exists. Replacing it.", notification.Id);
+            UnpinImages(it->second);
+        }
+
+        m_Notifications[notification.Id] = std::move(stored);
+        deliver = RouteNotification(notification);
 
-    m_Notifications[notification.Id] = notification;
+        // Held back notifications (do-not-disturb, rate limit) expire counting from when they go out.
+        if (deliver && notification.ExpireTimeout > 0) {
+            StartExpirationTimer(notification.Id, notification.ExpireTimeout);
+        } else if (const auto expiry = m_ExpiryKeys.find(notification.Id); expiry != m_ExpiryKeys.end()) {
+            m_Timers.Cancel(expiry->second);
+            m_ExpiryKeys.erase(expiry);
+        }
+    }
 
-    nlohmann::json payload = CreateNotificationPayload(notification);
-    m_Shell->GetIPC().Broadcast("notifd-notification", payload);
+    if (deliver) {
+        m_Shell->GetIPC().Broadcast("notifd-notification", payload);
+    }
+}
 
-    if (notification.ExpireTimeout > 0) {
-        StartExpirationTimer(notification.Id, notification.ExpireTimeout);
+void WSS::Notifd::StartExpirationTimers(const std::vector<uint32_t>& ids) {
+    for (const uint32_t id : ids) {
+        if (const auto it = m_Notifications.find(id); it != m_Notifications.end() && it->second.ExpireTimeout > 0) {
+            StartExpirationTimer(id, it->second.ExpireTimeout);
+        }
     }
 }
 
-void WSS::Notifd::SignalNotificationClosed(uint32_t id, NotificationCloseReason reason) {
-    std::lock_guard lock(m_NotificationsMutex);
-    auto it = m_Notifications.find(id);
+bool WSS::Notifd::RouteNotification(const Notification& notification) {
+    const auto holdBack = [](std::vector<uint32_t>& held, const uint32_t id) {
+        if (std::ranges::find(held, id) == held.end()) {
+            held.push_back(id);
+        }
+    };
 
-    if (it != m_Notifications.end()) {
-        nlohmann::json payload = {{"id", static_cast<int32_t>(it->second.Id)}, {"reason", static_cast<int32_t>(reason)}};
+    const bool critical = notification.IsCritical();
+    if (m_DoNotDisturb && !critical) {
+        holdBack(m_DoNotDisturbQueue, notification.Id);
+        return false;
+    }
 
-        m_Shell->GetIPC().Broadcast("notifd-notification-closed", payload);
-        m_Notifications.erase(it);
+    const auto& settings = m_Shell->GetSettings();
+    if (critical || settings.m_NotificationRate <= 0) {
+        return true;
+    }
 
-        m_NotificationObject->emitSignal(sdbus::SignalName("CloseNotification"))
-            .onInterface("org.freedesktop.Notifications")
-            .withArguments(id, static_cast<uint32_t>(reason));
+    const auto now = std::chrono::steady_clock::now();
+    const double burst = std::max(1, settings.m_NotificationBurst);
+    if (!m_AppFlows.contains(notification.AppName)) {
+        // A bucket that filled up again holds no state a new one wouldn't have, dropping those keeps
+        // clients that rotate their app name from growing the map.
+        std::erase_if(m_AppFlows, [&](const auto& entry) {
+            const auto& flow = entry.second;
+            const double elapsed = std::chrono::duration<double>(now - flow.Refilled).count();
+            return flow.Held.empty() && !flow.FlushScheduled && flow.Tokens + elapsed * settings.m_NotificationRate >= burst;
+        });
+    }
+    auto [it, added] = m_AppFlows.try_emplace(notification.AppName);
+    auto& flow = it->second;
+    if (added) {
+        flow.Tokens = burst;
     } else {
-        WSS_WARN("Notification with ID {} not found.", id);
+        const double elapsed = std::chrono::duration<double>(now - flow.Refilled).count();
+        flow.Tokens = std::min(burst, flow.Tokens + elapsed * settings.m_NotificationRate);
+    }
+    flow.Refilled = now;
+
+    // Once notifications are held back, later ones join them so the order is kept.
+    if (flow.Held.empty() && flow.Tokens >= 1) {
+        flow.Tokens -= 1;
+        return true;
+    }
+
+    holdBack(flow.Held, notification.Id);
+    if (!flow.FlushScheduled) {
+        flow.FlushScheduled = true;
+        const auto untilToken = std::chrono::duration<double>((1 - flow.Tokens) / settings.m_NotificationRate);
+        m_Timers.Schedule(++m_TimerKeyCounter,
+                          std::max(std::chrono::milliseconds(50), std::chrono::ceil<std::chrono::milliseconds>(untilToken)),
+                          [this, appName = notification.AppName]() { FlushHeld(appName); });
+    }
+    return false;
+}
+
+void WSS::Notifd::FlushHeld(const std::string& appName) {
+    std::vector<uint32_t> held;
+    {
+        std::lock_guard lock(m_NotificationsMutex);
+        auto& flow = m_AppFlows[appName];
+        flow.FlushScheduled = false;
+        held.swap(flow.Held);
+        if (m_DoNotDisturb) {
+            // Do-not-disturb started in the meantime, the held back notifications go out with its batch.
+            for (const uint32_t id : held) {
+                if (std::ranges::find(m_DoNotDisturbQueue, id) == m_DoNotDisturbQueue.end()) {
+                    m_DoNotDisturbQueue.push_back(id);
+                }
+            }
+            return;
+        }
+        // The group counts as one notification against the rate limit.
+        flow.Tokens = std::max(0.0, flow.Tokens - 1);
+        StartExpirationTimers(held);
+    }
+
+    json notifications = CollectPayloads(held);
+    if (notifications.empty()) {
+        return;
+    }
+    WSS_DEBUG("Sending {} held back notifications of '{}' as a group.", notifications.size(), appName);
+    m_Shell->GetIPC().Broadcast("notifd-notification-group",
+                                {{"appName", appName}, {"count", notifications.size()}, {"notifications", notifications}});
+}
+
+json WSS::Notifd::CollectPayloads(const std::vector<uint32_t>& ids) const {
+    std::vector<Notification> notifications;
+    {
+        std::lock_guard lock(m_NotificationsMutex);
+        for (const uint32_t id : ids) {
+            if (const auto it = m_Notifications.find(id); it != m_Notifications.end()) {
+                notifications.push_back(it->second);
+            }
+        }
     }
+
+    json payloads = json::array();
+    for (const auto& notification : notifications) {
+        payloads.push_back(CreateNotificationPayload(notification));
+    }
+    return payloads;
+}
+
+void WSS::Notifd::SetDoNotDisturb(const bool enabled) {
+    std::vector<uint32_t> queued;
+    {
+        std::lock_guard lock(m_NotificationsMutex);
+        if (m_DoNotDisturb == enabled) {
+            return;
+        }
+        m_DoNotDisturb = enabled;
+        if (!enabled) {
+            queued.swap(m_DoNotDisturbQueue);
+            StartExpirationTimers(queued);
+        }
+    }
+    WSS_INFO("Do-not-disturb {}.", enabled ? "enabled" : "disabled");
+    m_Shell->GetIPC().Broadcast("notifd-dnd-changed", {{"enabled", enabled}});
+
+    if (json notifications = CollectPayloads(queued); !notifications.empty()) {
+        m_Shell->GetIPC().Broadcast("notifd-notification-batch",
+                                    {{"count", notifications.size()}, {"notifications", notifications}});
+    }
+}
+
+void WSS::Notifd::SignalNotificationClosed(uint32_t id, NotificationCloseReason reason) {
+    {
+        std::lock_guard lock(m_NotificationsMutex);
+        auto it = m_Notifications.find(id);
+        if (it == m_Notifications.end()) {
+            WSS_WARN("Notification with ID {} not found.", id);
+            return;
+        }
+        EraseNotification(it);
+    }
+    PublishClosed(id, reason);
+}
+
+void WSS::Notifd::EraseNotification(std::unordered_map<uint32_t, Notification>::iterator it) {
+    const uint32_t id = it->second.Id;
+    if (const auto flow = m_AppFlows.find(it->second.AppName); flow != m_AppFlows.end()) {
+        std::erase(flow->second.Held, id);
+    }
+    std::erase(m_DoNotDisturbQueue, id);
+    UnpinImages(it->second);
+    m_Notifications.erase(it);
+
+    if (const auto expiry = m_ExpiryKeys.find(id); expiry != m_ExpiryKeys.end()) {
+        m_Timers.Cancel(expiry->second);
+        m_ExpiryKeys.erase(expiry);
+    }
+}
+
+void WSS::Notifd::PublishClosed(const uint32_t id, NotificationCloseReason reason) {
+    nlohmann::json payload = {{"id", static_cast<int32_t>(id)}, {"reason", static_cast<int32_t>(reason)}};
+    m_Shell->GetIPC().Broadcast("notifd-notification-closed", payload);
+
+    m_NotificationObject->emitSignal(sdbus::SignalName("CloseNotification"))
+        .onInterface("org.freedesktop.Notifications")
+        .withArguments(id, static_cast<uint32_t>(reason));
 }
 
 void WSS::Notifd::SignalActionInvoked(uint32_t id, const std::string& action) {
@@ -151,4 +407,25 @@ void WSS::Notifd::SignalActionInvoked(uint32_t id, const std::string& action) {
     } else {
         WSS_WARN("Notification with ID {} not found for action '{}'.", id, action);
     }
-}
\ No newline at end of file
+}
+
+json WSS::Notifd::GetStatusJson() const {
+    int threads = 0;
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with("Threads:")) {
+            threads = std::stoi(line.substr(8));
+            break;
+        }
+    }
+
+    std::lock_guard lock(m_NotificationsMutex);
+    return {{"notifications", m_Notifications.size()},
+            {"pendingExpiries", m_ExpiryKeys.size()},
+            {"imageCacheBytes", m_Images.GetSize()},
+            {"historySize", m_History.GetSize()},
+            {"doNotDisturb", m_DoNotDisturb},
+            {"doNotDisturbQueued", m_DoNotDisturbQueue.size()},
+            {"threads", threads}};
+}
@@ -3,6 +3,14 @@
 
 #include <pch.h>
 
+#include <condition_variable>
+#include <deque>
+#include <variant>
+
+#include "imagecache.h"
+#include "notifhistory.h"
+#include "util/timerwheel.h"
+
 namespace WSS {
 class Shell;
 }
@@ -22,6 +30,30 @@ struct Notification {
     std::vector<std::string> Actions;
     std::map<std::string, sdbus::Variant> Hints;
     int32_t ExpireTimeout = -1; // Default to -1 for no expiration
+    std::string ImageKey;       // The image-data or image-path hint in the image cache, if any
+    std::string AppIconKey;     // The app icon in the image cache, if found
+    uint64_t HistorySeq = 0;    // Position in the notification history, 0 if the history is disabled
+
+    /**
+     * @return The urgency hint: 0 low, 1 normal (also if the hint is missing), 2 critical.
+     */
+    [[nodiscard]] uint8_t GetUrgency() const {
+        const auto it = Hints.find("urgency");
+        return it != Hints.end() && it->second.containsValueOfType<uint8_t>() ? it->second.get<uint8_t>() : 1;
+    }
+
+    [[nodiscard]] bool IsCritical() const { return GetUrgency() == 2; }
+};
+
+/**
+ * The rate limit of one app's notifications. Notifications beyond the limit are held back and sent
+ * to pages together, as one "notifd-notification-group" message, once the app has a token again.
+ */
+struct AppNotificationFlow {
+    double Tokens = 0;
+    std::chrono::steady_clock::time_point Refilled;
+    std::vector<uint32_t> Held; // Held back notifications, in the order they arrived
+    bool FlushScheduled = false;
 };
 
 /**
@@ -37,7 +69,54 @@ class Notifd {
     std::atomic<uint32_t> m_NotificationCounter{0};
     std::thread m_Thread;
 
+    // Expiry and group flush timers share one thread. A replaced notification gets a new timer key,
+    // so a timer of the notification it replaced can't close it early.
+    std::unordered_map<uint32_t, uint64_t> m_ExpiryKeys;
+    uint64_t m_TimerKeyCounter = 0;
+    TimerWheel m_Timers;
+
+    // Images are decoded and looked up off the D-Bus thread. Notifications pass through this queue in
+    // order, also those without images, so they can't overtake each other. CloseNotification calls
+    // (the ID to close) go through it as well, so they can't overtake the notification they close.
+    // Open notifications keep their images pinned in the cache.
+    ImageCache m_Images;
+    std::deque<std::variant<Notification, uint32_t>> m_ImageQueue;
+    std::mutex m_ImageQueueMutex;
+    std::condition_variable m_ImageQueueCondition;
+    std::atomic_bool m_ImageWorkerRunning{false};
+    std::thread m_ImageWorker;
+
+    NotificationHistory m_History;
+
+    std::unordered_map<std::string, AppNotificationFlow> m_AppFlows;
+    bool m_DoNotDisturb = false;
+    std::vector<uint32_t> m_DoNotDisturbQueue; // Delivered as one batch when do-not-disturb ends
+
+    /**
+     * Decides whether a notification goes out now, and otherwise holds it back. Requires the lock.
+     * @return True if the notification should be broadcast right away.
+     */
+    bool RouteNotification(const Notification& notification);
+    void FlushHeld(const std::string& appName);
+    /**
+     * Serializes the notifications that are still open. Must be called without the lock held.
+     */
+    json CollectPayloads(const std::vector<uint32_t>& ids) const;
+
+    void QueueNotification(std::variant<Notification, uint32_t> event);
+    void ResolveImages(Notification& notification);
+    void UnpinImages(const Notification& notification);
+    std::string GetImageUrl(const std::string& key) const;
     void StartExpirationTimer(uint32_t id, int32_t timeoutMs);
+    /**
+     * Starts the expiry timers of held back notifications once they are delivered. Requires the lock.
+     */
+    void StartExpirationTimers(const std::vector<uint32_t>& ids);
+    /**
+     * Removes a notification and its timers. Requires the lock, PublishClosed() has to follow once it is released.
+     */
+    void EraseNotification(std::unordered_map<uint32_t, Notification>::iterator it);
+    void PublishClosed(uint32_t id, NotificationCloseReason reason);
     json CreateNotificationPayload(const Notification& notification) const;
 
    public:
@@ -47,6 +126,12 @@ class Notifd {
     }
 
     ~Notifd() {
+        m_ImageWorkerRunning = false;
+        m_ImageQueueCondition.notify_all();
+        if (m_ImageWorker.joinable()) {
+            m_ImageWorker.join();
+        }
+        m_Timers.Stop();
         if (m_Connection) {
             m_Connection->leaveEventLoop();
         }
@@ -60,6 +145,13 @@ class Notifd {
     Notifd(Notifd&&) = delete;
     Notifd& operator=(Notifd&&) = delete;
 
+    /**
+     * @return The cache of the notification images, served to pages under /notifd/image/<key> on the IPC port.
+     */
+    [[nodiscard]] ImageCache& GetImageCache() { return m_Images; }
+
+    [[nodiscard]] NotificationHistory& GetHistory() { return m_History; }
+
     [[nodiscard]] const std::unordered_map<uint32_t, Notification>& GetNotifications() const {
         std::lock_guard lock(m_NotificationsMutex);
         return m_Notifications;
@@ -68,8 +160,10 @@ class Notifd {
     /**
      * Adds a notification to the Notifd daemon.
      * If a notification with the same ID already exists, it will be replaced.
-     * This method is thread-safe and will lock the notifications mutex while adding the notification.
-     * It also starts an expiration timer if the notification has a positive timeout.
+     * This method is thread-safe, the notification is serialized and broadcast outside of the lock.
+     * Notifications are rate limited per app, and held back during do-not-disturb (see SetDoNotDisturb).
+     * It also starts an expiration timer if the notification has a positive timeout, for notifications held
+     * back by do-not-disturb once it ends.
      * @param notification The notification to add.
      */
     void AddNotification(const Notification& notification);
@@ -87,6 +181,23 @@ class Notifd {
      */
     void SignalActionInvoked(uint32_t id, const std::string& action);
 
+    /**
+     * Holds back all but critical notifications while enabled. When disabled, the held back
+     * notifications are sent to pages as one "notifd-notification-batch" message, and only start
+     * expiring from then on. Pages are told about the change with "notifd-dnd-changed".
+     */
+    void SetDoNotDisturb(bool enabled);
+
+    [[nodiscard]] bool IsDoNotDisturb() const {
+        std::lock_guard lock(m_NotificationsMutex);
+        return m_DoNotDisturb;
+    }
+
+    /**
+     * @return The number of open notifications and pending expiry timers, and the thread count of the shell.
+     */
+    [[nodiscard]] json GetStatusJson() const;
+
     void Start();
 };
 } // namespace WSS
@@ -0,0 +1,424 @@
+#include "notifhistory.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstring>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+static constexpr char FileMagic[8] = {'W', 'S', 'S', 'H', 'I', 'S', 'T', '1'};
+static constexpr uint32_t RecordMagic = 0x4e485357; // "WSHN"
+
+static constexpr uint8_t RecordChecksummed = 1; // Records written before checksums were added don't have the flag
+
+/**
+ * Precedes every notification in the log, followed by the app name and the notification as JSON.
+ */
+struct RecordHeader {
+    uint32_t Magic;
+    uint32_t BodyLength;
+    uint64_t Seq;
+    int64_t Timestamp;
+    uint64_t Replaces; // 0 if the notification didn't replace one
+    uint8_t Urgency;
+    uint8_t Flags;
+    uint16_t AppLength;
+    uint32_t Checksum; // CRC-32 of the app name and the body, if RecordChecksummed is set
+};
+static_assert(sizeof(RecordHeader) == 40, "The record header is part of the file format");
+
+static constexpr auto Crc32Table = []() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+static uint32_t Crc32(const uint8_t* data, const size_t size) {
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < size; i++) {
+        crc = Crc32Table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+static bool WriteAll(const int fd, const void* data, size_t size, off_t offset) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        bytes += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+WSS::NotificationHistory::~NotificationHistory() {
+    Unmap();
+    if (m_Fd >= 0)
+        close(m_Fd);
+}
+
+uint32_t WSS::NotificationHistory::InternApp(const std::string& appName) {
+    if (const auto it = m_AppIds.find(appName); it != m_AppIds.end()) {
+        return it->second;
+    }
+    const auto id = static_cast<uint32_t>(m_AppNames.size());
+    m_AppNames.push_back(appName);
+    m_AppIds[appName] = id;
+    return id;
+}
+
+void WSS::NotificationHistory::PruneApps() {
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> ids;
+    for (auto& entry : m_Entries) {
+        auto [it, added] = ids.try_emplace(m_AppNames[entry.App], static_cast<uint32_t>(names.size()));
+        if (added) {
+            names.push_back(it->first);
+        }
+        entry.App = it->second;
+    }
+    m_AppNames = std::move(names);
+    m_AppIds = std::move(ids);
+}
+
+bool WSS::NotificationHistory::Map() {
+    Unmap();
+    if (m_FileSize == 0) {
+        return true;
+    }
+    void* map = mmap(nullptr, m_FileSize, PROT_READ, MAP_SHARED, m_Fd, 0);
+    if (map == MAP_FAILED) {
+        WSS_ERROR("Failed to map the notification history: {}", strerror(errno));
+        return false;
+    }
+    m_Map = static_cast<const uint8_t*>(map);
+    m_MapSize = m_FileSize;
+    return true;
+}
+
+void WSS::NotificationHistory::Unmap() {
+    if (m_Map) {
+        munmap(const_cast<uint8_t*>(m_Map), m_MapSize);
+        m_Map = nullptr;
+        m_MapSize = 0;
+    }
+}
+
+void WSS::NotificationHistory::Open(const fs::path& path, const size_t maxEntries) {
+    std::lock_guard lock(m_Mutex);
+    m_Path = path;
+    m_MaxEntries = maxEntries;
+    if (m_MaxEntries == 0) {
+        return;
+    }
+
+    std::error_code error;
+    fs::create_directories(m_Path.parent_path(), error);
+    if (!Load()) {
+        // Keep the unreadable log around for inspection, and start over.
+        WSS_WARN("Notification history at {} is unreadable, starting a new one.", m_Path.string());
+        Unmap();
+        if (m_Fd >= 0)
+            close(m_Fd);
+        m_Fd = -1;
+        fs::rename(m_Path, m_Path.string() + ".corrupt", error);
+        m_Entries.clear();
+        m_AppNames.clear();
+        m_AppIds.clear();
+        m_Records = 0;
+        if (!Load()) {
+            WSS_ERROR("Failed to create the notification history at {}.", m_Path.string());
+            m_MaxEntries = 0;
+            return;
+        }
+    }
+    WSS_INFO("Loaded {} notifications from the history.", m_Entries.size());
+}
+
+bool WSS::NotificationHistory::Load() {
+    m_Fd = open(m_Path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (m_Fd < 0) {
+        return false;
+    }
+    struct stat info{};
+    if (fstat(m_Fd, &info) < 0) {
+        return false;
+    }
+    m_FileSize = info.st_size;
+    if (m_FileSize == 0) {
+        if (!WriteAll(m_Fd, FileMagic, sizeof(FileMagic), 0)) {
+            return false;
+        }
+        m_FileSize = sizeof(FileMagic);
+    }
+    if (!Map() || m_MapSize < sizeof(FileMagic) || std::memcmp(m_Map, FileMagic, sizeof(FileMagic)) != 0) {
+        return false;
+    }
+
+    // Replaced notifications are dropped in one pass once all records are read.
+    std::unordered_set<uint64_t> replaced;
+    size_t corrupt = 0;
+    uint64_t offset = sizeof(FileMagic);
+    while (offset < m_FileSize) {
+        RecordHeader header{};
+        if (m_FileSize - offset < sizeof(header)) {
+            break;
+        }
+        std::memcpy(&header, m_Map + offset, sizeof(header));
+        const uint64_t length = sizeof(header) + header.AppLength + header.BodyLength;
+        if (header.Magic != RecordMagic || m_FileSize - offset < length) {
+            break;
+        }
+        m_Records++;
+        if ((header.Flags & RecordChecksummed) &&
+            Crc32(m_Map + offset + sizeof(header), length - sizeof(header)) != header.Checksum) {
+            corrupt++;
+            offset += length;
+            continue;
+        }
+
+        if (header.Replaces != 0) {
+            replaced.insert(header.Replaces);
+        }
+        const std::string appName(reinterpret_cast<const char*>(m_Map + offset + sizeof(header)), header.AppLength);
+        m_Entries.push_back({.Seq = header.Seq,
+                             .Timestamp = header.Timestamp,
+                             .Urgency = header.Urgency,
+                             .App = InternApp(appName),
+                             .Offset = offset,
+                             .Length = static_cast<uint32_t>(length)});
+        m_NextSeq = std::max(m_NextSeq, header.Seq + 1);
+        offset += length;
+    }
+    if (!replaced.empty()) {
+        std::erase_if(m_Entries, [&](const HistoryEntry& entry) { return replaced.contains(entry.Seq); });
+    }
+    if (corrupt > 0) {
+        WSS_WARN("Skipped {} corrupted records in the notification history.", corrupt);
+    }
+
+    if (offset < m_FileSize) {
+        // Torn write of the last record, e.g. the shell was killed while appending.
+        WSS_WARN("Cutting off {} bytes at the end of the notification history.", m_FileSize - offset);
+        if (ftruncate(m_Fd, static_cast<off_t>(offset)) < 0) {
+            return false;
+        }
+        m_FileSize = offset;
+        Map();
+    }
+
+    while (m_Entries.size() > m_MaxEntries) {
+        m_Entries.pop_front();
+    }
+    PruneApps();
+    if (m_Records > m_MaxEntries * 2) {
+        Compact();
+    }
+    return true;
+}
+
+void WSS::NotificationHistory::Compact() {
+    const std::string tempPath = m_Path.string() + ".tmp";
+    const int fd = open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        WSS_ERROR("Failed to compact the notification history: {}", strerror(errno));
+        return;
+    }
+    if (m_MapSize < m_FileSize) {
+        Map();
+    }
+
+    bool written = WriteAll(fd, FileMagic, sizeof(FileMagic), 0);
+    uint64_t offset = sizeof(FileMagic);
+    std::deque<HistoryEntry> entries = m_Entries;
+    for (auto& entry : entries) {
+        if (!written) {
+            break;
+        }
+        written = WriteAll(fd, m_Map + entry.Offset, entry.Length, static_cast<off_t>(offset));
+        entry.Offset = offset;
+        offset += entry.Length;
+    }
+    if (!written || fsync(fd) < 0 || rename(tempPath.c_str(), m_Path.c_str()) < 0) {
+        WSS_ERROR("Failed to compact the notification history: {}", strerror(errno));
+        close(fd);
+        unlink(tempPath.c_str());
+        return;
+    }
+
+    WSS_DEBUG("Compacted the notification history from {} to {} records.", m_Records, entries.size());
+    Unmap();
+    close(m_Fd);
+    m_Fd = fd;
+    m_FileSize = offset;
+    m_Records = entries.size();
+    m_Entries = std::move(entries);
+    PruneApps();
+    Map();
+}
+
+uint64_t WSS::NotificationHistory::Append(const json& payload, const std::string& appName, const uint8_t urgency,
+                                          const uint64_t replaces) {
+    const std::string body = payload.dump();
+    const std::string app = appName.substr(0, UINT16_MAX);
+    const auto timestamp =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::lock_guard lock(m_Mutex);
+    if (m_MaxEntries == 0 || m_Fd < 0) {
+        return 0;
+    }
+
+    RecordHeader header{.Magic = RecordMagic,
+                        .BodyLength = static_cast<uint32_t>(body.size()),
+                        .Seq = m_NextSeq,
+                        .Timestamp = timestamp,
+                        .Replaces = replaces,
+                        .Urgency = urgency,
+                        .Flags = RecordChecksummed,
+                        .AppLength = static_cast<uint16_t>(app.size()),
+                        .Checksum = 0};
+    std::string record(sizeof(header), '\0');
+    record += app;
+    record += body;
+    header.Checksum = Crc32(reinterpret_cast<const uint8_t*>(record.data()) + sizeof(header), record.size() - sizeof(header));
+    std::memcpy(record.data(), &header, sizeof(header));
+    if (!WriteAll(m_Fd, record.data(), record.size(), static_cast<off_t>(m_FileSize))) {
+        WSS_ERROR("Failed to append to the notification history: {}", strerror(errno));
+        return 0;
+    }
+
+    if (replaces != 0) {
+        // Entries are ordered by sequence number.
+        if (const auto it = std::ranges::lower_bound(m_Entries, replaces, {}, &HistoryEntry::Seq);
+            it != m_Entries.end() && it->Seq == replaces) {
+            m_Entries.erase(it);
+        }
+    }
+    m_Entries.push_back({.Seq = m_NextSeq,
+                         .Timestamp = timestamp,
+                         .Urgency = urgency,
+                         .App = InternApp(app),
+                         .Offset = m_FileSize,
+                         .Length = static_cast<uint32_t>(record.size())});
+    m_FileSize += record.size();
+    m_Records++;
+    while (m_Entries.size() > m_MaxEntries) {
+        m_Entries.pop_front();
+    }
+    if (m_Records > m_MaxEntries * 2) {
+        Compact();
+    } else if (m_AppNames.size() > m_Entries.size() * 2) {
+        PruneApps(); // Many apps only showed up in notifications that were dropped since
+    }
+    return m_NextSeq++;
+}
+
+json WSS::NotificationHistory::ReadEntry(const HistoryEntry& entry) {
+    // Appends don't grow the mapping, it is extended when a read needs it.
+    if (entry.Offset + entry.Length > m_MapSize && !Map()) {
+        return nullptr;
+    }
+    RecordHeader header{};
+    std::memcpy(&header, m_Map + entry.Offset, sizeof(header));
+    const auto* body = reinterpret_cast<const char*>(m_Map + entry.Offset + sizeof(header) + header.AppLength);
+    return json::parse(body, body + header.BodyLength, nullptr, false);
+}
+
+json WSS::NotificationHistory::Query(const HistoryQuery& query) {
+    std::lock_guard lock(m_Mutex);
+
+    std::optional<uint32_t> app;
+    if (!query.AppName.empty()) {
+        const auto it = m_AppIds.find(query.AppName);
+        if (it == m_AppIds.end()) {
+            return {{"items", json::array()}, {"nextCursor", nullptr}, {"apps", json::object()}};
+        }
+        app = it->second;
+    }
+
+    json items = json::array();
+    json nextCursor = nullptr;
+    for (auto it = m_Entries.rbegin(); it != m_Entries.rend(); ++it) {
+        if (it->Timestamp < query.Since) {
+            break; // Entries are in chronological order
+        }
+        if (it->Seq >= query.Before || (app && it->App != *app) || it->Urgency < query.MinUrgency) {
+            continue;
+        }
+        if (items.size() == query.Limit) {
+            nextCursor = items.back()["seq"];
+            break;
+        }
+        items.push_back({{"seq", it->Seq},
+                         {"timestamp", it->Timestamp},
+                         {"urgency", it->Urgency},
+                         {"appName", m_AppNames[it->App]},
+                         {"notification", ReadEntry(*it)}});
+    }
+
+    json apps = json::object();
+    std::vector<size_t> counts(m_AppNames.size(), 0);
+    for (const auto& entry : m_Entries) {
+        counts[entry.App]++;
+    }
+    for (size_t i = 0; i < counts.size(); i++) {
+        if (counts[i] > 0) {
+            apps[m_AppNames[i]] = counts[i];
+        }
+    }
+
+    json result = {{"nextCursor", nextCursor}, {"apps", apps}};
+    if (!query.Grouped) {
+        result["items"] = std::move(items);
+        return result;
+    }
+
+    // Groups are ordered by their most recent notification.
+    json groups = json::array();
+    std::unordered_map<std::string, size_t> groupIndex;
+    for (auto& item : items) {
+        const std::string appName = item["appName"];
+        auto [it, added] = groupIndex.try_emplace(appName, groups.size());
+        if (added) {
+            groups.push_back({{"appName", appName}, {"items", json::array()}});
+        }
+        groups[it->second]["items"].push_back(std::move(item));
+    }
+    result["groups"] = std::move(groups);
+    return result;
+}
+
+void WSS::NotificationHistory::Clear() {
+    std::lock_guard lock(m_Mutex);
+    if (m_Fd < 0) {
+        return;
+    }
+    Unmap();
+    if (ftruncate(m_Fd, sizeof(FileMagic)) < 0) {
+        WSS_ERROR("Failed to clear the notification history: {}", strerror(errno));
+    }
+    m_FileSize = sizeof(FileMagic);
+    m_Records = 0;
+    m_Entries.clear();
+    m_AppNames.clear();
+    m_AppIds.clear();
+    Map();
+}
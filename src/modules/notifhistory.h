@@ -0,0 +1,111 @@
+#ifndef NOTIFHISTORY_H
+#define NOTIFHISTORY_H
+
+#include <pch.h>
+
+#include <deque>
+#include <filesystem>
+#include <mutex>
+
+namespace WSS {
+/**
+ * What the history keeps in memory about a notification, enough to filter and page through the
+ * history without touching the notifications themselves.
+ */
+struct HistoryEntry {
+    uint64_t Seq;      // Position in the history, increases across restarts
+    int64_t Timestamp; // Milliseconds since the epoch
+    uint8_t Urgency;
+    uint32_t App;    // Index into the app name table
+    uint64_t Offset; // Of the record in the log
+    uint32_t Length; // Of the record in the log, header included
+};
+
+/**
+ * Filters and pagination of a history query.
+ */
+struct HistoryQuery {
+    uint64_t Before = UINT64_MAX; // Cursor: only entries older than this sequence number
+    size_t Limit = 20;
+    std::string AppName;  // Empty for all apps
+    int MinUrgency = 0;   // 0 low, 1 normal, 2 critical
+    int64_t Since = 0;    // Milliseconds since the epoch
+    bool Grouped = false; // Group the page by app
+};
+
+/**
+ * Keeps the notifications shown in the past in an append-only log, so a notification center can
+ * show them after they closed, and after a restart.
+ * The log is memory-mapped for reading, only the index (a few dozen bytes per notification) is kept
+ * in memory. The log holds at most maxEntries notifications: once it holds twice as many records
+ * (replaced and dropped ones included), it is compacted into a new file.
+ * All methods are thread-safe.
+ */
+class NotificationHistory {
+    std::filesystem::path m_Path;
+    size_t m_MaxEntries = 0;
+    int m_Fd = -1;
+    uint64_t m_FileSize = 0;
+    size_t m_Records = 0; // In the log, including ones no longer in the index
+
+    const uint8_t* m_Map = nullptr;
+    size_t m_MapSize = 0;
+
+    std::deque<HistoryEntry> m_Entries; // Oldest first
+    std::vector<std::string> m_AppNames; // Pruned to the apps still in the index, see PruneApps()
+    std::unordered_map<std::string, uint32_t> m_AppIds;
+    uint64_t m_NextSeq = 1;
+    mutable std::mutex m_Mutex;
+
+    uint32_t InternApp(const std::string& appName);
+    /**
+     * Rebuilds the app name table from the entries still in the index, dropping apps whose
+     * notifications were all dropped. Requires the lock.
+     */
+    void PruneApps();
+    bool Load();
+    bool Map();
+    void Unmap();
+    void Compact();
+    json ReadEntry(const HistoryEntry& entry);
+
+  public:
+    NotificationHistory() = default;
+    ~NotificationHistory();
+
+    NotificationHistory(const NotificationHistory&) = delete;
+    NotificationHistory(NotificationHistory&&) = delete;
+    NotificationHistory& operator=(NotificationHistory&&) = delete;
+
+    /**
+     * Opens (or creates) the log and loads its index. A record torn by a crash is cut off, one whose
+     * checksum doesn't match is skipped.
+     * @param path The log file.
+     * @param maxEntries How many notifications to keep, 0 disables the history.
+     */
+    void Open(const std::filesystem::path& path, size_t maxEntries);
+
+    /**
+     * Appends a notification to the history.
+     * @param payload The notification as sent to pages.
+     * @param replaces The sequence number of the notification this one replaces, it is dropped from the history.
+     * @return The sequence number of the notification, 0 if the history is disabled.
+     */
+    uint64_t Append(const json& payload, const std::string& appName, uint8_t urgency, uint64_t replaces = 0);
+
+    /**
+     * @return {"items": [...], "nextCursor": <seq or null>}, with "groups": [{"appName", "items"}] instead
+     *         of "items" for grouped queries, and "apps": {<name>: <count>} over the whole history.
+     */
+    json Query(const HistoryQuery& query);
+
+    void Clear();
+
+    [[nodiscard]] size_t GetSize() const {
+        std::lock_guard lock(m_Mutex);
+        return m_Entries.size();
+    }
+};
+} // namespace WSS
+
+#endif // NOTIFHISTORY_H
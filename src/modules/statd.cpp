@@ -0,0 +1,271 @@
+#include "statd.h"
+
+#include <shell.h>
+#include <unistd.h>
+#include <util/mainthread.h>
+
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+
+std::optional<uint64_t> WSS::Statd::ReadRss(const int64_t pid) {
+    std::ifstream statm("/proc/" + std::to_string(pid) + "/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    if (!(statm >> size >> resident)) {
+        return std::nullopt;
+    }
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+std::optional<uint64_t> WSS::Statd::ReadCpuTicks(const int64_t pid) {
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!std::getline(stat, line)) {
+        return std::nullopt;
+    }
+
+    // The process name is in parentheses and may contain spaces, so the fields are counted from the last ')'.
+    // utime and stime are fields 14 and 15, i.e. the 12th and 13th after the name.
+    const size_t nameEnd = line.rfind(')');
+    if (nameEnd == std::string::npos) {
+        return std::nullopt;
+    }
+    std::istringstream fields(line.substr(nameEnd + 1));
+    std::string field;
+    for (int i = 0; i < 11; i++) {
+        fields >> field;
+    }
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    if (!(fields >> utime >> stime)) {
+        return std::nullopt;
+    }
+    return utime + stime;
+}
+
+void WSS::Statd::Sample() {
+    const auto now = std::chrono::steady_clock::now();
+    const auto& settings = m_Shell->GetSettings();
+    static const double ticksPerSecond = static_cast<double>(sysconf(_SC_CLK_TCK));
+
+    std::vector<RendererStats> stats;
+    std::unordered_map<int64_t, CpuSample> cpuSamples;
+    std::unordered_map<int64_t, double> cpuPercent;
+    std::vector<std::pair<std::shared_ptr<Widget>, uint8_t>> recycle;
+    std::unordered_set<std::string> instances;
+
+    for (const auto& [name, widget] : m_Shell->GetWidgets()) {
+        const int maxRssMb = widget->GetInfo().MaxRssMb > 0 ? widget->GetInfo().MaxRssMb : settings.m_RendererMaxRssMb;
+
+        for (const auto& [monitorId, view] : widget->GetWebViews()) {
+            const std::string instance = name + "/" + std::to_string(monitorId);
+            instances.insert(instance);
+            const int64_t pid = view->page()->renderProcessPid();
+            if (pid <= 0) {
+                continue; // Not started yet, or just crashed
+            }
+
+            RendererStats entry{.Widget = name, .MonitorId = monitorId, .Pid = pid};
+            entry.RssBytes = ReadRss(pid).value_or(0);
+
+            // Several instances may share a process, it's only read once per sample.
+            if (const auto it = cpuPercent.find(pid); it != cpuPercent.end()) {
+                entry.CpuPercent = it->second;
+            } else {
+                if (const auto ticks = ReadCpuTicks(pid)) {
+                    cpuSamples[pid] = {.Ticks = *ticks, .Time = now};
+                    const auto previous = m_CpuSamples.find(pid);
+                    if (previous != m_CpuSamples.end() && *ticks >= previous->second.Ticks) {
+                        const double seconds = std::chrono::duration<double>(now - previous->second.Time).count();
+                        entry.CpuPercent = (*ticks - previous->second.Ticks) / ticksPerSecond / seconds * 100.0;
+                    }
+                }
+                cpuPercent[pid] = entry.CpuPercent;
+            }
+
+            auto& state = m_Instances[instance];
+            if (settings.m_RendererMaxCpuPercent > 0 && entry.CpuPercent > settings.m_RendererMaxCpuPercent) {
+                state.CpuStrikes++;
+            } else {
+                state.CpuStrikes = 0;
+            }
+
+            const bool overRss = maxRssMb > 0 && entry.RssBytes > static_cast<uint64_t>(maxRssMb) * 1024 * 1024;
+            const bool overCpu = settings.m_RendererCpuSamples > 0 && state.CpuStrikes >= settings.m_RendererCpuSamples;
+            if ((overRss || overCpu) && now - state.RecycledAt >= RecycleCooldown) {
+                WSS_WARN("Recycling widget '{}' on monitor ID: {} (renderer {}: {} MB, {:.1f}% CPU).", name, monitorId, pid,
+                         entry.RssBytes / (1024 * 1024), entry.CpuPercent);
+                state.CpuStrikes = 0;
+                state.Recycles++;
+                state.RecycledAt = now;
+                recycle.emplace_back(widget, monitorId);
+            }
+            entry.Recycles = state.Recycles;
+            stats.push_back(std::move(entry));
+        }
+    }
+
+    // Reloading only after the loop, the widget map must not change while it's iterated.
+    for (const auto& [widget, monitorId] : recycle) {
+        widget->Reload(monitorId);
+    }
+
+    // Spawned widgets come and go under unique names, their state goes with them.
+    std::erase_if(m_Instances, [&instances](const auto& entry) { return !instances.contains(entry.first); });
+    m_CpuSamples = std::move(cpuSamples);
+    std::lock_guard lock(m_StatsMutex);
+    m_Stats = std::move(stats);
+}
+
+void WSS::Statd::Start() {
+    const int interval = m_Shell->GetSettings().m_StatsIntervalMs;
+    if (interval <= 0) {
+        WSS_INFO("Renderer statistics are disabled.");
+        return;
+    }
+
+    m_Timer = new QTimer(m_Shell->GetApplication());
+    m_Timer->setInterval(interval);
+    QObject::connect(m_Timer, &QTimer::timeout, [this]() { Sample(); });
+    m_Timer->start();
+    Sample();
+    WSS_DEBUG("Sampling renderer statistics every {} ms.", interval);
+}
+
+json WSS::Statd::GetStatsJson() {
+    json widgets = json::array();
+    uint64_t totalRss = 0;
+    std::unordered_set<int64_t> pids;
+
+    for (const auto& entry : GetStats()) {
+        widgets.push_back({
+            {"widget", entry.Widget},
+            {"monitorId", entry.MonitorId},
+            {"pid", entry.Pid},
+            {"rss", entry.RssBytes},
+            {"cpu", entry.CpuPercent},
+            {"recycles", entry.Recycles},
+        });
+        if (pids.insert(entry.Pid).second) {
+            totalRss += entry.RssBytes;
+        }
+    }
+    return {{"widgets", widgets}, {"renderers", pids.size()}, {"totalRss", totalRss}};
+}
+
+/**
+ * Reads the proportional set size of a process from its smaps_rollup.
+ */
+static std::optional<uint64_t> ReadPss(const int64_t pid) {
+    std::ifstream smaps("/proc/" + std::to_string(pid) + "/smaps_rollup");
+    std::string line;
+    while (std::getline(smaps, line)) {
+        if (line.starts_with("Pss:")) {
+            return std::stoull(line.substr(4)) * 1024;
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * Classifies a process by the --type switch Chromium starts its child processes with.
+ */
+static std::string GetProcessType(const int64_t pid) {
+    std::ifstream cmdline("/proc/" + std::to_string(pid) + "/cmdline");
+    std::string arg;
+    while (std::getline(cmdline, arg, '\0')) {
+        if (arg.starts_with("--type=")) {
+            const std::string type = arg.substr(7);
+            if (type == "gpu-process") {
+                return "gpu";
+            }
+            return type; // "renderer", "utility", "zygote", ...
+        }
+    }
+    return "browser";
+}
+
+/**
+ * Finds all descendants of a process. Renderers are forked by the zygote, not by the shell itself,
+ * so the direct children aren't enough.
+ */
+static std::vector<int64_t> GetDescendants(const int64_t root) {
+    std::unordered_map<int64_t, std::vector<int64_t>> children;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc")) {
+        const std::string name = entry.path().filename().string();
+        if (name.empty() || !std::ranges::all_of(name, ::isdigit)) {
+            continue;
+        }
+        std::ifstream stat(entry.path() / "stat");
+        std::string line;
+        if (!std::getline(stat, line)) {
+            continue;
+        }
+        const size_t nameEnd = line.rfind(')');
+        if (nameEnd == std::string::npos) {
+            continue;
+        }
+        std::istringstream fields(line.substr(nameEnd + 1));
+        std::string state;
+        int64_t ppid = 0;
+        if (fields >> state >> ppid) {
+            children[ppid].push_back(std::stoll(name));
+        }
+    }
+
+    std::vector<int64_t> descendants;
+    std::vector<int64_t> pending{root};
+    while (!pending.empty()) {
+        const int64_t pid = pending.back();
+        pending.pop_back();
+        for (const int64_t child : children[pid]) {
+            descendants.push_back(child);
+            pending.push_back(child);
+        }
+    }
+    return descendants;
+}
+
+json WSS::Statd::GetMemoryReport() {
+    // Whether pages are loading can only be asked on the main thread.
+    auto loading = std::make_shared<std::promise<int>>();
+    DispatchToMainThread([this, loading]() {
+        const auto& widgets = m_Shell->GetWidgets();
+        // Widgets are only created once the frontend is prewarmed, until then nothing has loaded yet.
+        int count = widgets.empty() ? 1 : 0;
+        for (const auto& [name, widget] : widgets) {
+            for (const auto& [monitorId, view] : widget->GetWebViews()) {
+                count += view->page()->isLoading() ? 1 : 0;
+            }
+        }
+        loading->set_value(count);
+    });
+    auto future = loading->get_future();
+    if (future.wait_for(std::chrono::seconds(2)) != std::future_status::ready) {
+        throw std::runtime_error("The main thread did not respond.");
+    }
+
+    const int64_t self = getpid();
+    std::vector<int64_t> pids{self};
+    std::ranges::copy(GetDescendants(self), std::back_inserter(pids));
+
+    json processes = json::array();
+    std::map<std::string, uint64_t> totals;
+    uint64_t total = 0;
+    for (const int64_t pid : pids) {
+        const auto pss = ReadPss(pid);
+        if (!pss) {
+            continue; // Exited in the meantime
+        }
+        const std::string type = pid == self ? "browser" : GetProcessType(pid);
+        processes.push_back({{"pid", pid}, {"type", type}, {"pss", *pss}});
+        totals[type] += *pss;
+        total += *pss;
+    }
+
+    return {{"loading", future.get()}, {"processes", processes}, {"types", totals}, {"total", total}};
+}
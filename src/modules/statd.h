@@ -0,0 +1,103 @@
+#ifndef STATD_H
+#define STATD_H
+
+#include <pch.h>
+
+#include <QTimer>
+
+namespace WSS {
+class Shell;
+}
+
+namespace WSS {
+
+/**
+ * Represents the resource usage of the render process behind one widget instance.
+ * Chromium may put several pages into one render process, in which case all of them report the
+ * same process (and the same numbers).
+ */
+struct RendererStats {
+    std::string Widget;
+    uint8_t MonitorId = 0;
+    int64_t Pid = 0;
+    uint64_t RssBytes = 0;
+    double CpuPercent = 0;
+    uint32_t Recycles = 0; // How often the instance was reloaded for exceeding a limit
+};
+
+/**
+ * Samples the render processes of all widget instances from /proc, and recycles the instances
+ * whose renderer exceeds the configured limits by reloading only that instance.
+ * Sampling runs on the main thread (that's where the views live), the latest snapshot can be read
+ * from any thread.
+ */
+class Statd {
+    struct CpuSample {
+        uint64_t Ticks = 0;
+        std::chrono::steady_clock::time_point Time;
+    };
+
+    struct InstanceState {
+        int CpuStrikes = 0; // Consecutive samples above the CPU limit
+        uint32_t Recycles = 0;
+        std::chrono::steady_clock::time_point RecycledAt;
+    };
+
+    // An instance isn't recycled again within this time, so a page that is simply too big for its
+    // limit doesn't end up in a reload loop.
+    static constexpr auto RecycleCooldown = std::chrono::minutes(2);
+
+    Shell* m_Shell = nullptr;
+    QTimer* m_Timer = nullptr;
+
+    std::unordered_map<int64_t, CpuSample> m_CpuSamples;
+    std::unordered_map<std::string, InstanceState> m_Instances; // Keyed by "<widget>/<monitor ID>"
+
+    std::mutex m_StatsMutex;
+    std::vector<RendererStats> m_Stats;
+
+    static std::optional<uint64_t> ReadRss(int64_t pid);
+    static std::optional<uint64_t> ReadCpuTicks(int64_t pid);
+
+    void Sample();
+
+   public:
+    explicit Statd(Shell* shell) : m_Shell(shell) {
+        WSS_ASSERT(m_Shell != nullptr, "Shell instance must not be null.");
+        WSS_DEBUG("Statd initialized with Shell instance.");
+    }
+
+    Statd(const Statd&) = delete;
+    Statd(Statd&&) = delete;
+    Statd& operator=(Statd&&) = delete;
+
+    /**
+     * Starts sampling in the interval from the settings. Must be called on the main thread.
+     */
+    void Start();
+
+    /**
+     * Gets the latest snapshot. Can be called from any thread.
+     */
+    [[nodiscard]] std::vector<RendererStats> GetStats() {
+        std::lock_guard lock(m_StatsMutex);
+        return m_Stats;
+    }
+
+    /**
+     * Gets the latest snapshot in the format sent over IPC and the dispatch socket.
+     */
+    [[nodiscard]] json GetStatsJson();
+
+    /**
+     * Measures the proportional set size (PSS) of the shell and all web engine processes it spawned,
+     * grouped into browser (the shell itself), GPU, renderer and utility processes. Unlike RSS, PSS
+     * splits shared pages between the processes sharing them, so the values add up to what the whole
+     * shell actually costs. Also reports how many pages are still loading, so callers can wait for
+     * the pages to settle first. Can be called from any thread but the main thread.
+     */
+    [[nodiscard]] json GetMemoryReport();
+};
+} // namespace WSS
+
+#endif // STATD_H
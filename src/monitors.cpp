@@ -0,0 +1,161 @@
+#include "monitors.h"
+
+#include "shell.h"
+
+static constexpr auto MonitorIdProperty = "wssMonitorId";
+
+bool WSS::MonitorSelector::Matches(const QScreen* screen, const uint8_t monitorId) const {
+    if (Id >= 0) {
+        return Id == monitorId;
+    }
+    const QString name = QString::fromStdString(Name);
+    return screen->name() == name || screen->model() == name;
+}
+
+std::vector<WSS::MonitorSelector> WSS::MonitorSelector::FromJson(const json& monitors) {
+    std::vector<MonitorSelector> selectors;
+    if (!monitors.is_array()) {
+        return selectors;
+    }
+    for (const auto& monitor : monitors) {
+        if (monitor.is_number_integer() && monitor.get<int>() >= 0 && monitor.get<int>() < 256) {
+            selectors.push_back({.Id = monitor.get<int>()});
+        } else if (monitor.is_string()) {
+            selectors.push_back({.Name = monitor.get<std::string>()});
+        }
+    }
+    return selectors;
+}
+
+std::vector<WSS::MonitorSelector> WSS::MonitorSelector::FromToml(const toml::array& monitors, const std::string& owner) {
+    std::vector<MonitorSelector> selectors;
+    for (const auto& a : monitors) {
+        if (a.is_integer()) {
+            const int64_t monitorId = a.value_or<int64_t>(0);
+            if (monitorId < 0 || monitorId > 255) {
+                WSS_ERROR("Monitor ID '{}' is out of range in configuration for '{}'.", monitorId, owner);
+                continue;
+            }
+            selectors.push_back({.Id = static_cast<int>(monitorId)});
+        } else if (a.is_string()) {
+            // Matches the connector name (e.g. "DP-1") or the model of the monitor.
+            selectors.push_back({.Name = a.value_or<std::string>("")});
+        } else {
+            WSS_ERROR("Monitor must be an ID or a connector name in configuration for '{}'.", owner);
+        }
+    }
+    return selectors;
+}
+
+uint8_t WSS::MonitorRegistry::AssignId(QScreen* screen) {
+    std::vector<bool> used(256, false);
+    for (const QScreen* other : QGuiApplication::screens()) {
+        if (other == screen) {
+            continue;
+        }
+        if (auto id = GetMonitorId(other)) {
+            used[*id] = true;
+        }
+    }
+
+    // Give a replugged monitor its previous ID back if nobody took it in the meantime.
+    uint8_t id = 0;
+    if (const auto it = m_KnownIds.find(screen->name().toStdString()); it != m_KnownIds.end() && !used[it->second]) {
+        id = it->second;
+    } else {
+        while (id < 255 && used[id]) {
+            id++;
+        }
+    }
+
+    screen->setProperty(MonitorIdProperty, static_cast<int>(id));
+    m_KnownIds[screen->name().toStdString()] = id;
+    WSS_INFO("Monitor '{}' ({}) assigned ID {}.", screen->name().toStdString(), screen->model().toStdString(), id);
+    return id;
+}
+
+void WSS::MonitorRegistry::Watch(QScreen* screen) {
+    QObject::connect(screen, &QScreen::geometryChanged, screen, [this, screen](const QRect&) { OnGeometryChanged(screen); });
+}
+
+void WSS::MonitorRegistry::Start() {
+    for (QScreen* screen : QGuiApplication::screens()) {
+        AssignId(screen);
+        Watch(screen);
+    }
+
+    QObject::connect(qApp, &QGuiApplication::screenAdded, qApp, [this](QScreen* screen) { OnScreenAdded(screen); });
+    QObject::connect(qApp, &QGuiApplication::screenRemoved, qApp, [this](QScreen* screen) { OnScreenRemoved(screen); });
+}
+
+void WSS::MonitorRegistry::OnScreenAdded(QScreen* screen) {
+    const uint8_t id = AssignId(screen);
+    Watch(screen);
+    WSS_INFO("Monitor '{}' connected as monitor ID {}.", screen->name().toStdString(), id);
+
+    for (const auto& [name, widget] : m_Shell->GetWidgets()) {
+        widget->SyncMonitors(*m_Shell);
+    }
+    m_Shell->GetZones().Rebuild();
+}
+
+void WSS::MonitorRegistry::OnScreenRemoved(QScreen* screen) {
+    const auto id = GetMonitorId(screen);
+    WSS_INFO("Monitor '{}' (ID {}) disconnected.", screen->name().toStdString(), id ? std::to_string(*id) : "none");
+    screen->setProperty(MonitorIdProperty, QVariant());
+
+    // The screen is already gone from QGuiApplication::screens(), so syncing drops its instances.
+    for (const auto& [name, widget] : m_Shell->GetWidgets()) {
+        widget->SyncMonitors(*m_Shell);
+    }
+    m_Shell->GetZones().Rebuild();
+}
+
+void WSS::MonitorRegistry::OnGeometryChanged(QScreen* screen) {
+    const auto id = GetMonitorId(screen);
+    if (!id) {
+        return;
+    }
+
+    WSS_DEBUG("Geometry of monitor ID {} changed to {}x{}.", *id, screen->geometry().width(), screen->geometry().height());
+    for (const auto& [name, widget] : m_Shell->GetWidgets()) {
+        widget->UpdateGeometry(*id);
+    }
+    m_Shell->GetZones().Rebuild();
+}
+
+std::vector<uint8_t> WSS::MonitorRegistry::Resolve(const std::vector<MonitorSelector>& selectors) const {
+    std::vector<uint8_t> monitorIds;
+    for (const auto& selector : selectors) {
+        for (const QScreen* screen : QGuiApplication::screens()) {
+            const auto id = GetMonitorId(screen);
+            if (!id || !selector.Matches(screen, *id)) {
+                continue;
+            }
+            if (std::ranges::find(monitorIds, *id) == monitorIds.end()) {
+                monitorIds.push_back(*id);
+            }
+        }
+    }
+    return monitorIds;
+}
+
+QScreen* WSS::MonitorRegistry::GetScreen(const int monitorId) {
+    for (QScreen* screen : QGuiApplication::screens()) {
+        if (const auto id = GetMonitorId(screen); id && *id == monitorId) {
+            return screen;
+        }
+    }
+    return nullptr;
+}
+
+std::optional<uint8_t> WSS::MonitorRegistry::GetMonitorId(const QScreen* screen) {
+    if (!screen) {
+        return std::nullopt;
+    }
+    const QVariant id = screen->property(MonitorIdProperty);
+    if (!id.isValid()) {
+        return std::nullopt;
+    }
+    return static_cast<uint8_t>(id.toUInt());
+}
@@ -0,0 +1,102 @@
+#ifndef MONITORS_H
+#define MONITORS_H
+
+#include <pch.h>
+
+#include <QGuiApplication>
+#include <QScreen>
+
+namespace WSS {
+class Shell;
+}
+namespace WSS {
+
+/**
+ * Selects a monitor from the widget configuration.
+ * A selector either refers to a monitor ID directly (`monitors = [0, 1]`) or matches a monitor
+ * by its connector name or model (`monitors = ["DP-1", "DELL U2720Q"]`).
+ */
+struct MonitorSelector {
+    int Id = -1;
+    std::string Name;
+
+    [[nodiscard]] bool Matches(const QScreen* screen, uint8_t monitorId) const;
+
+    /**
+     * Parses a list of monitor selectors (IDs or names) from an IPC payload.
+     * Entries that are neither an ID nor a name are skipped.
+     */
+    static std::vector<MonitorSelector> FromJson(const json& monitors);
+
+    /**
+     * Parses a list of monitor selectors (IDs or names) from the configuration.
+     * Invalid entries are reported and skipped.
+     * @param monitors The `monitors` array of a configuration entry.
+     * @param owner The name of the configuration entry, for error messages.
+     */
+    static std::vector<MonitorSelector> FromToml(const toml::array& monitors, const std::string& owner);
+
+    bool operator==(const MonitorSelector&) const = default;
+};
+
+/**
+ * Keeps track of connected monitors and assigns them stable monitor IDs.
+ * At startup the monitor ID equals the index of the screen in QGuiApplication::screens(), but
+ * unlike the index it doesn't shift when another monitor is unplugged. A replugged monitor gets
+ * its previous ID back (matched by connector name) as long as it's still free.
+ *
+ * Hotplug and geometry changes are forwarded to the widgets, so only the affected widget
+ * instances are created, destroyed or resized.
+ * All methods must be called on the main thread.
+ */
+class MonitorRegistry {
+    Shell* m_Shell = nullptr;
+    std::unordered_map<std::string, uint8_t> m_KnownIds;
+
+    uint8_t AssignId(QScreen* screen);
+    void Watch(QScreen* screen);
+
+    void OnScreenAdded(QScreen* screen);
+    void OnScreenRemoved(QScreen* screen);
+    void OnGeometryChanged(QScreen* screen);
+
+  public:
+    explicit MonitorRegistry(Shell* shell) : m_Shell(shell) {
+        WSS_ASSERT(m_Shell != nullptr, "Shell instance must not be null.");
+        WSS_DEBUG("MonitorRegistry initialized with Shell instance.");
+    }
+
+    MonitorRegistry(const MonitorRegistry&) = delete;
+    MonitorRegistry(MonitorRegistry&&) = delete;
+    MonitorRegistry& operator=(MonitorRegistry&&) = delete;
+
+    /**
+     * Assigns IDs to the currently connected monitors and starts listening for hotplug events.
+     * Must be called after the QApplication is created and before any widget is created.
+     */
+    void Start();
+
+    /**
+     * Resolves monitor selectors to the IDs of the currently connected monitors they match.
+     * @param selectors The selectors to resolve.
+     * @return The matching monitor IDs, without duplicates and in selector order.
+     */
+    [[nodiscard]] std::vector<uint8_t> Resolve(const std::vector<MonitorSelector>& selectors) const;
+
+    /**
+     * Gets the screen with the specified monitor ID.
+     * @param monitorId The ID of the monitor.
+     * @return The screen, or nullptr if no connected monitor has this ID.
+     */
+    static QScreen* GetScreen(int monitorId);
+
+    /**
+     * Gets the monitor ID assigned to the specified screen.
+     * @param screen The screen to get the ID for.
+     * @return The monitor ID, or std::nullopt if the screen has no ID assigned (yet).
+     */
+    static std::optional<uint8_t> GetMonitorId(const QScreen* screen);
+};
+} // namespace WSS
+
+#endif // MONITORS_H
@@ -1,6 +1,16 @@
 #include "shell.h"
 
+#include <QFileSystemWatcher>
+#include <QIcon>
+#include <QUrlQuery>
+#include <QWebEngineNewWindowRequest>
 #include <csignal>
+#include <format>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <unordered_set>
 
 #include "modules/notifd.h"
 #include "util/dimparser.h"
@@ -24,9 +34,917 @@ void WSS::Shell::LoadConfig(const std::string& configPath) {
     m_Settings.m_IpcPort = settingsConfig->get("ipc_port") ? settingsConfig->get("ipc_port")->value_or<int>(8080) : 0;
     m_Settings.m_NotificationTimeout =
         settingsConfig->get("notification_timeout") ? settingsConfig->get("notification_timeout")->value_or<int>(5000) : 0;
+    m_Settings.m_NotificationImageCacheMb = (*settingsConfig)["notification_image_cache_mb"].value_or<int>(32);
+    m_Settings.m_NotificationRate = (*settingsConfig)["notification_rate"].value_or<double>(1.0);
+    m_Settings.m_NotificationBurst = (*settingsConfig)["notification_burst"].value_or<int>(5);
+    m_Settings.m_NotificationHistory = (*settingsConfig)["notification_history"].value_or<int>(500);
+    m_Settings.m_IconTheme = (*settingsConfig)["icon_theme"].value_or<std::string>("");
+    m_Settings.m_GpuRasterization = (*settingsConfig)["gpu_rasterization"].value_or<bool>(true);
+    m_Settings.m_UnlockFrameRate = (*settingsConfig)["unlock_frame_rate"].value_or<bool>(false);
+    m_Settings.m_UnsafeWebGpu = (*settingsConfig)["unsafe_webgpu"].value_or<bool>(false);
+    m_Settings.m_DisableSandbox = (*settingsConfig)["disable_sandbox"].value_or<bool>(false);
+    m_Settings.m_CacheSizeMb = (*settingsConfig)["cache_size_mb"].value_or<int>(256);
+    m_Settings.m_Prewarm = (*settingsConfig)["prewarm"].value_or<bool>(true);
+    m_Settings.m_StatsIntervalMs = (*settingsConfig)["stats_interval_ms"].value_or<int>(5000);
+    m_Settings.m_RendererMaxRssMb = (*settingsConfig)["renderer_max_rss_mb"].value_or<int>(0);
+    m_Settings.m_RendererMaxCpuPercent = (*settingsConfig)["renderer_max_cpu_percent"].value_or<int>(0);
+    m_Settings.m_RendererCpuSamples = (*settingsConfig)["renderer_cpu_samples"].value_or<int>(6);
+    m_Settings.m_CacheDir = (*settingsConfig)["cache_dir"].value_or<std::string>("");
+    if (m_Settings.m_CacheDir.empty()) {
+        if (const char* cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome) {
+            m_Settings.m_CacheDir = std::string(cacheHome) + "/wss";
+        } else if (const char* home = std::getenv("HOME")) {
+            m_Settings.m_CacheDir = std::string(home) + "/.cache/wss";
+        }
+    }
+    m_Settings.m_DataDir = (*settingsConfig)["data_dir"].value_or<std::string>("");
+    if (m_Settings.m_DataDir.empty()) {
+        if (const char* dataHome = std::getenv("XDG_DATA_HOME"); dataHome && *dataHome) {
+            m_Settings.m_DataDir = std::string(dataHome) + "/wss";
+        } else if (const char* home = std::getenv("HOME")) {
+            m_Settings.m_DataDir = std::string(home) + "/.local/share/wss";
+        }
+    }
     WSS_INFO("Loaded configuration.");
 }
 
+void WSS::Shell::CreateProfile() {
+    m_Profile = new QWebEngineProfile("wss", m_Application);
+    if (m_Settings.m_CacheDir.empty()) {
+        WSS_WARN("No cache directory could be determined, the web engine cache won't persist.");
+    } else {
+        const QString cacheDir = QString::fromStdString(m_Settings.m_CacheDir);
+        m_Profile->setCachePath(cacheDir + "/cache");
+        m_Profile->setPersistentStoragePath(cacheDir + "/storage");
+    }
+    // The disk cache also holds V8's code cache, so scripts are only compiled once across restarts.
+    m_Profile->setHttpCacheType(QWebEngineProfile::DiskHttpCache);
+    // QWebEngineProfile takes the size as an int, anything from 2 GB on is clamped to its maximum.
+    const qint64 cacheBytes = static_cast<qint64>(std::max(m_Settings.m_CacheSizeMb, 0)) * 1024 * 1024;
+    m_Profile->setHttpCacheMaximumSize(static_cast<int>(std::min<qint64>(cacheBytes, std::numeric_limits<int>::max())));
+
+    WSS_INFO("Web engine cache at {} (max {} MB).", m_Profile->cachePath().toStdString(), m_Settings.m_CacheSizeMb);
+}
+
+void WSS::Shell::Prewarm(std::function<void()> done) {
+    const auto start = std::chrono::steady_clock::now();
+
+    QUrl url = GetFrontendUrl("");
+    url.setQuery("prewarm=1");
+
+    auto* page = new QWebEnginePage(m_Profile);
+    auto finished = std::make_shared<bool>(false);
+    auto finish = [page, start, finished, done = std::move(done)](const bool loaded) {
+        if (std::exchange(*finished, true)) {
+            return;
+        }
+        const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (loaded) {
+            WSS_INFO("Prewarmed the frontend in {:.0f} ms.", elapsed);
+        } else {
+            WSS_WARN("Prewarming the frontend did not finish after {:.0f} ms, continuing anyway.", elapsed);
+        }
+        page->deleteLater();
+        done();
+    };
+    QObject::connect(page, &QWebEnginePage::loadFinished, page, finish);
+    QTimer::singleShot(5000, page, [finish]() { finish(false); });
+    page->load(url);
+}
+
+/**
+ * Parses a list of region tables ({ name, x, y, width, height }) as used by click and opaque regions.
+ */
+static std::vector<WSS::WidgetClickRegionSpec> ParseRegionSpecs(const toml::array& regions, const std::string& owner) {
+    std::vector<WSS::WidgetClickRegionSpec> specs;
+    for (const auto& region : regions) {
+        if (!region.is_table()) {
+            WSS_ERROR("Region must be a table in configuration for '{}'.", owner);
+            continue;
+        }
+        const auto regionTable = region.as_table();
+        specs.push_back({.Name = (*regionTable)["name"].value_or<std::string>(""),
+                         .X = (*regionTable)["x"].value_or<std::string>("0"),
+                         .Y = (*regionTable)["y"].value_or<std::string>("0"),
+                         .Width = (*regionTable)["width"].value_or<std::string>("0"),
+                         .Height = (*regionTable)["height"].value_or<std::string>("0")});
+    }
+    return specs;
+}
+
+/**
+ * Applies the render policy values present in a widget, template or render profile table on top of policy.
+ * @return False if one of the values is invalid.
+ */
+static bool ParseRenderPolicy(const toml::table& table, WSS::WidgetRenderPolicy& policy, const std::string& owner) {
+    policy.MaxFps = table["max_fps"].value_or<int>(policy.MaxFps);
+    policy.FollowRefreshRate = table["follow_refresh_rate"].value_or<bool>(policy.FollowRefreshRate);
+    policy.FreezeWhenHidden = table["freeze_when_hidden"].value_or<bool>(policy.FreezeWhenHidden);
+
+    if (policy.MaxFps < 0 || policy.MaxFps > 1000) {
+        WSS_ERROR("Invalid max_fps '{}' for '{}'. Expected 0 (uncapped) to 1000.", policy.MaxFps, owner);
+        return false;
+    }
+    return true;
+}
+
+void WSS::Shell::LoadRenderProfiles(const toml::table& profiles) {
+    std::unordered_map<std::string, WidgetRenderPolicy> parsed;
+    for (const auto& [profileName, node] : profiles) {
+        auto name = std::string(profileName.str());
+        const auto info = node.as_table();
+        if (!info) {
+            WSS_ERROR("Invalid render profile configuration for '{}'. Expected a table.", name);
+            continue;
+        }
+
+        WidgetRenderPolicy policy;
+        if (ParseRenderPolicy(*info, policy, name)) {
+            parsed.emplace(name, policy);
+        }
+    }
+    m_RenderProfiles = std::move(parsed);
+    WSS_DEBUG("Loaded {} render profiles.", m_RenderProfiles.size());
+}
+
+std::string WSS::Shell::BuildChromiumFlags() const {
+    std::vector<std::string> flags = {
+        "--use-gl=egl",
+        "--enable-zero-copy",
+        "--ozone-platform=wayland",
+        "--ozone-platform-hint=auto",
+        "--ignore-gpu-blocklist",
+        "--disable-software-rasterizer",
+        "--disable-sync-preferences",
+        "--disable-features=UseSkiaRenderer,UseChromeOSDirectVideoDecoder",
+        "--enable-native-gpu-memory-buffers",
+        "--enable-gpu-memory-buffer-video-frames",
+        "--enable-features=VaapiVideoEncoder,VaapiVideoDecoder,CanvasOopRasterization",
+    };
+    // Vulkan is left out, it conflicts with --use-gl=egl which the Wayland integration relies on.
+    if (m_Settings.m_UnsafeWebGpu) {
+        flags.emplace_back("--enable-unsafe-webgpu");
+    }
+    if (m_Settings.m_DisableSandbox) {
+        flags.emplace_back("--no-sandbox");
+    }
+    if (m_Settings.m_GpuRasterization) {
+        flags.emplace_back("--enable-gpu-rasterization");
+    } else {
+        flags.emplace_back("--disable-gpu-rasterization");
+    }
+    // Lifts the 60 Hz cap of the compositor frame scheduling for all pages. Only requestAnimationFrame
+    // is capped again per page by the render policy, CSS and compositor animations then run uncapped.
+    if (m_Settings.m_UnlockFrameRate) {
+        flags.emplace_back("--disable-frame-rate-limit");
+        flags.emplace_back("--disable-gpu-vsync");
+        flags.emplace_back("--disable-software-vsync");
+    }
+
+    std::string result;
+    for (const auto& flag : flags) {
+        if (!result.empty()) {
+            result += ' ';
+        }
+        result += flag;
+    }
+    return result;
+}
+
+std::optional<WSS::WidgetInfo> WSS::Shell::ParseWidgetConfig(const std::string& name, const toml::table& info) const {
+    std::string route = info.get("route") ? info.get("route")->value_or<std::string>("") : "";
+    std::string width = info.get("width") ? info.get("width")->value_or<std::string>("") : "";
+    std::string height = info.get("height") ? info.get("height")->value_or<std::string>("") : "";
+    std::string layer = info.get("layer") ? info.get("layer")->value_or<std::string>("") : "";
+    const toml::array* anchor = info.get("anchor") ? info.get("anchor")->as_array() : nullptr;
+    const toml::array* monitors = info.get("monitors") ? info.get("monitors")->as_array() : nullptr;
+    int exclusivityZone = info.get("exclusivity_zone") ? info.get("exclusivity_zone")->value_or<int>(0) : 0;
+    bool exclusivity = info.get("exclusivity") ? info.get("exclusivity")->value_or<bool>(false) : false;
+    bool hidden = info.get("hidden") ? info.get("hidden")->value_or<bool>(false) : false;
+    std::string showMode = info.get("show_mode") ? info.get("show_mode")->value_or<std::string>("remap") : "remap";
+    bool mirror = info.get("mirror") ? info.get("mirror")->value_or<bool>(false) : false;
+    bool popups = info.get("popups") ? info.get("popups")->value_or<bool>(false) : false;
+    std::string kind = info.get("kind") ? info.get("kind")->value_or<std::string>("web") : "web";
+    std::string source = info.get("source") ? info.get("source")->value_or<std::string>("") : "";
+
+    std::string marginTop = info.get("margin_top") ? info.get("margin_top")->value_or<std::string>("0") : "0";
+    std::string marginBottom = info.get("margin_bottom") ? info.get("margin_bottom")->value_or<std::string>("0") : "0";
+    std::string marginLeft = info.get("margin_left") ? info.get("margin_left")->value_or<std::string>("0") : "0";
+    std::string marginRight = info.get("margin_right") ? info.get("margin_right")->value_or<std::string>("0") : "0";
+
+    int _QtPadding =
+        info.get("__QT_auto_click_region_padding") ? info.get("__QT_auto_click_region_padding")->value_or<int>(0) : 0;
+
+    if (!monitors) {
+        WSS_ERROR("Monitors configuration is required for widget '{}'.", name);
+        return std::nullopt;
+    }
+    std::vector<MonitorSelector> monitorSelectors = MonitorSelector::FromToml(*monitors, name);
+
+    const toml::array* clickRegions = info.get("click_regions") ? info.get("click_regions")->as_array() : nullptr;
+    if (!clickRegions) {
+        WSS_ERROR("Click regions configuration is required for widget '{}'.", name);
+        return std::nullopt;
+    }
+    std::vector<WidgetClickRegionSpec> clickRegionSpecs = ParseRegionSpecs(*clickRegions, name);
+
+    // Opaque regions are optional, they're only a hint for the compositor.
+    std::vector<WidgetClickRegionSpec> opaqueRegionSpecs;
+    if (const toml::array* opaqueRegions = info.get("opaque_regions") ? info.get("opaque_regions")->as_array() : nullptr) {
+        opaqueRegionSpecs = ParseRegionSpecs(*opaqueRegions, name);
+    }
+
+    uint8_t anchorBitmask = 0;
+    if (!anchor) {
+        WSS_ERROR("Anchor configuration is required for widget '{}'.", name);
+        return std::nullopt;
+    }
+    for (const auto& a : *anchor) {
+        if (a.is_string()) {
+            auto anchorStr = a.value_or<std::string>("");
+            if (anchorStr == "top") {
+                anchorBitmask |= static_cast<uint8_t>(WidgetAnchor::TOP);
+            } else if (anchorStr == "bottom") {
+                anchorBitmask |= static_cast<uint8_t>(WidgetAnchor::BOTTOM);
+            } else if (anchorStr == "left") {
+                anchorBitmask |= static_cast<uint8_t>(WidgetAnchor::LEFT);
+            } else if (anchorStr == "right") {
+                anchorBitmask |= static_cast<uint8_t>(WidgetAnchor::RIGHT);
+            } else {
+                WSS_ERROR("Invalid anchor '{}' in configuration for '{}'.", anchorStr, name);
+            }
+        } else {
+            WSS_ERROR("Anchor must be a string in configuration for '{}'.", name);
+        }
+    }
+
+    if (anchorBitmask == 0) {
+        WSS_ERROR("At least one anchor must be specified for widget '{}'.", name);
+        return std::nullopt;
+    }
+
+    if (layer.empty()) {
+        WSS_ERROR("Layer is required for widget '{}'.", name);
+        return std::nullopt;
+    }
+
+    if (monitorSelectors.empty()) {
+        WSS_ERROR("At least one monitor is required for widget '{}'.", name);
+        return std::nullopt;
+    }
+
+    WidgetLayer widgetLayer;
+    if (layer == "top") {
+        widgetLayer = WidgetLayer::TOP;
+    } else if (layer == "bottom") {
+        widgetLayer = WidgetLayer::BOTTOM;
+    } else if (layer == "overlay") {
+        widgetLayer = WidgetLayer::OVERLAY;
+    } else if (layer == "background") {
+        widgetLayer = WidgetLayer::BACKGROUND;
+    } else {
+        WSS_ERROR("Invalid layer '{}' for widget '{}'.", layer, name);
+        return std::nullopt;
+    }
+
+    WidgetKind widgetKind;
+    if (kind == "web") {
+        widgetKind = WidgetKind::WEB;
+    } else if (kind == "image") {
+        widgetKind = WidgetKind::IMAGE;
+    } else if (kind == "video") {
+        widgetKind = WidgetKind::VIDEO;
+    } else if (kind == "qml") {
+        widgetKind = WidgetKind::QML;
+    } else if (kind == "spacer") {
+        widgetKind = WidgetKind::SPACER;
+    } else {
+        WSS_ERROR("Invalid kind '{}' for widget '{}'. Expected 'web', 'image', 'video', 'qml' or 'spacer'.", kind, name);
+        return std::nullopt;
+    }
+    if ((widgetKind == WidgetKind::IMAGE || widgetKind == WidgetKind::VIDEO || widgetKind == WidgetKind::QML) &&
+        source.empty()) {
+        WSS_ERROR("Widget '{}' of kind '{}' requires a source.", name, kind);
+        return std::nullopt;
+    }
+
+    WidgetShowMode widgetShowMode;
+    if (showMode == "remap") {
+        widgetShowMode = WidgetShowMode::REMAP;
+    } else if (showMode == "keep-mapped") {
+        widgetShowMode = WidgetShowMode::KEEP_MAPPED;
+    } else {
+        WSS_ERROR("Invalid show mode '{}' for widget '{}'. Expected 'remap' or 'keep-mapped'.", showMode, name);
+        return std::nullopt;
+    }
+
+    WidgetRenderPolicy render;
+    if (const auto profile = info["render_profile"].value<std::string>()) {
+        if (const auto it = m_RenderProfiles.find(*profile); it != m_RenderProfiles.end()) {
+            render = it->second;
+        } else {
+            WSS_ERROR("Render profile '{}' of widget '{}' does not exist, using the defaults.", *profile, name);
+        }
+    }
+    if (!ParseRenderPolicy(info, render, name)) {
+        return std::nullopt;
+    }
+
+    return WidgetInfo{.Name = name,
+                      .Route = route,
+                      .Kind = widgetKind,
+                      .Source = source,
+                      .MonitorSelectors = std::move(monitorSelectors),
+                      .Dimensions = {.Width = width,
+                                     .Height = height,
+                                     .MarginTop = marginTop,
+                                     .MarginBottom = marginBottom,
+                                     .MarginLeft = marginLeft,
+                                     .MarginRight = marginRight},
+                      .ClickRegions = std::move(clickRegionSpecs),
+                      .OpaqueRegions = std::move(opaqueRegionSpecs),
+                      .Layer = widgetLayer,
+                      .AnchorBitmask = anchorBitmask,
+                      .ExclusivityZone = exclusivityZone,
+                      .Exclusivity = exclusivity,
+                      .DefaultHidden = hidden,
+                      .ShowMode = widgetShowMode,
+                      .Mirror = mirror,
+                      .Popups = popups,
+                      .Render = render,
+                      .MaxRssMb = info["max_rss_mb"].value_or<int>(0),
+                      ._QT_padding = _QtPadding};
+}
+
+std::vector<WSS::WidgetInfo> WSS::Shell::ParseWidgetsConfig(const toml::table& widgets) const {
+    std::vector<WidgetInfo> widgetInfos;
+    for (const auto& [widgetName, node] : widgets) {
+        auto name = std::string(widgetName.str());
+
+        WSS_DEBUG("Processing widget: {}", name);
+        const auto info = node.as_table();
+        if (!info) {
+            WSS_ERROR("Invalid widget configuration for '{}'. Expected a table.", name);
+            continue;
+        }
+
+        if (auto widgetInfo = ParseWidgetConfig(name, *info)) {
+            widgetInfos.push_back(std::move(*widgetInfo));
+        }
+    }
+    return widgetInfos;
+}
+
+void WSS::Shell::CreateWidget(WidgetInfo widgetInfo) {
+    WSS_DEBUG("Creating widget with info: Name='{}', Route='{}', Layer='{}', "
+              "AnchorBitmask='{}', Exclusivity='{}', DefaultHidden='{}'",
+              widgetInfo.Name, widgetInfo.Route, static_cast<int>(widgetInfo.Layer),
+              static_cast<int>(widgetInfo.AnchorBitmask), widgetInfo.Exclusivity, widgetInfo.DefaultHidden);
+
+    auto widget = std::make_shared<Widget>(std::move(widgetInfo));
+    widget->SetVisibilityListener([this, name = widget->GetInfo().Name](const uint8_t monitorId, const bool visible) {
+        m_IPC.Broadcast("widget-visibility", {{"widget", name}, {"monitorId", monitorId}, {"visible", visible}});
+    });
+    widget->Create(*this);
+
+    for (const auto& monitor : widget->GetInfo().Monitors) {
+        WSS_DEBUG("-- Monitor ID: {}, Width: {}, Height: {}, Margins: (Top: {}, Bottom: {}, Left: "
+                  "{}, Right: {})",
+                  monitor.MonitorId, monitor.Width, monitor.Height, monitor.MarginTop, monitor.MarginBottom,
+                  monitor.MarginLeft, monitor.MarginRight);
+        for (const auto& [regionName, regionInfo] : monitor.ClickRegionMap) {
+            WSS_DEBUG("   -- Click Region: {}, X: {}, Y: {}, Width: {}, Height: {}", regionName, regionInfo.X, regionInfo.Y,
+                      regionInfo.Width, regionInfo.Height);
+        }
+    }
+
+    // The new widget takes the place of the one it replaces in one step, so other threads looking it
+    // up in the meantime find either of them. The old one is destroyed outside of the lock.
+    const std::string name = widget->GetInfo().Name;
+    std::shared_ptr<Widget> replaced;
+    {
+        std::lock_guard lock(m_WidgetsMutex);
+        replaced = std::exchange(m_Widgets[name], std::move(widget));
+    }
+
+    // A replaced widget takes its popups with it, they were positioned relative to the old windows.
+    if (replaced) {
+        ErasePopups(name);
+    }
+}
+
+void WSS::Shell::EraseWidget(const std::string& name) {
+    std::shared_ptr<Widget> erased;
+    {
+        std::lock_guard lock(m_WidgetsMutex);
+        const auto it = m_Widgets.find(name);
+        if (it == m_Widgets.end()) {
+            return;
+        }
+        erased = std::move(it->second);
+        m_Widgets.erase(it);
+    }
+    ErasePopups(name);
+}
+
+void WSS::Shell::ErasePopups(const std::string& parentName) {
+    std::vector<std::string> children;
+    {
+        std::lock_guard lock(m_WidgetsMutex);
+        for (const auto& [childName, widget] : m_Widgets) {
+            if (widget->GetInfo().Parent == parentName) {
+                children.push_back(childName);
+            }
+        }
+    }
+
+    // Popups can open popups of their own.
+    for (const auto& child : children) {
+        WSS_DEBUG("Closing popup '{}' together with '{}'.", child, parentName);
+        EraseWidget(child);
+    }
+}
+
+void WSS::Shell::LoadTemplates(const toml::table& templates) {
+    std::unordered_map<std::string, WidgetTemplate> parsed;
+    for (const auto& [templateName, node] : templates) {
+        auto name = std::string(templateName.str());
+        const auto info = node.as_table();
+        if (!info) {
+            WSS_ERROR("Invalid template configuration for '{}'. Expected a table.", name);
+            continue;
+        }
+
+        auto widgetInfo = ParseWidgetConfig(name, *info);
+        if (!widgetInfo) {
+            continue;
+        }
+        const int poolSize = (*info)["pool_size"].value_or<int>(0);
+        parsed.emplace(name, WidgetTemplate{.Info = std::move(*widgetInfo), .PoolSize = poolSize});
+    }
+
+    // Templates sharing a route share their pooled pages, routes that are gone release theirs.
+    std::unordered_map<std::string, int> poolSizes;
+    {
+        std::lock_guard lock(m_TemplatesMutex);
+        for (const auto& [name, widgetTemplate] : m_Templates) {
+            poolSizes[widgetTemplate.Info.Route] = 0;
+        }
+        m_Templates = std::move(parsed);
+        for (const auto& [name, widgetTemplate] : m_Templates) {
+            poolSizes[widgetTemplate.Info.Route] += widgetTemplate.PoolSize;
+        }
+    }
+    for (const auto& [route, size] : poolSizes) {
+        m_ViewPool.Reserve(route, size);
+    }
+
+    WSS_INFO("Loaded {} widget templates.", m_Templates.size());
+}
+
+std::string WSS::Shell::SpawnWidget(const std::string& templateName, std::string name,
+                                    const std::vector<MonitorSelector>& monitors, SpawnCallback spawned) {
+    WidgetInfo widgetInfo;
+    {
+        std::lock_guard lock(m_TemplatesMutex);
+        const auto it = m_Templates.find(templateName);
+        if (it == m_Templates.end()) {
+            throw std::invalid_argument("Template '" + templateName + "' does not exist.");
+        }
+        widgetInfo = it->second.Info;
+    }
+
+    if (name.empty()) {
+        name = templateName + "-" + std::to_string(m_SpawnCounter.fetch_add(1, std::memory_order_relaxed));
+    }
+    if (GetWidget(name)) {
+        throw std::invalid_argument("Widget '" + name + "' already exists.");
+    }
+
+    widgetInfo.Name = name;
+    widgetInfo.Template = templateName;
+    if (!monitors.empty()) {
+        widgetInfo.MonitorSelectors = monitors;
+    }
+
+    DispatchToMainThread([this, widgetInfo, spawned = std::move(spawned)]() {
+        if (GetWidget(widgetInfo.Name)) {
+            WSS_WARN("Widget '{}' was created by someone else in the meantime, not spawning it.", widgetInfo.Name);
+            if (spawned) {
+                spawned(widgetInfo.Name, "Widget '" + widgetInfo.Name + "' already exists.");
+            }
+            return;
+        }
+        WSS_DEBUG("Spawning widget '{}' from template '{}'.", widgetInfo.Name, widgetInfo.Template);
+        CreateWidget(widgetInfo);
+        if (spawned) {
+            spawned(widgetInfo.Name, "");
+        }
+    });
+    return name;
+}
+
+void WSS::Shell::DestroyWidget(const std::string& name) {
+    const auto widget = GetWidget(name);
+    if (!widget) {
+        throw std::invalid_argument("Widget '" + name + "' does not exist.");
+    }
+    if (!widget->IsSpawned()) {
+        throw std::invalid_argument("Widget '" + name + "' is configured in [widgets] and can't be destroyed at runtime.");
+    }
+
+    DispatchToMainThread([this, name]() {
+        WSS_DEBUG("Destroying spawned widget '{}'.", name);
+        EraseWidget(name);
+    });
+}
+
+std::string WSS::Shell::OpenPopup(const std::string& parentName, const uint8_t monitorId, const std::string& popupName,
+                                  const std::string& route, const QRect& rect, const bool keyboard) {
+    if (popupName.empty()) {
+        throw std::invalid_argument("Popup name must not be empty.");
+    }
+    if (rect.width() <= 0 || rect.height() <= 0) {
+        throw std::invalid_argument("Popup '" + popupName + "' must have a positive size.");
+    }
+    const auto parent = GetWidget(parentName);
+    if (!parent) {
+        throw std::invalid_argument("Widget '" + parentName + "' does not exist.");
+    }
+
+    const std::string name = parentName + ":" + popupName;
+    DispatchToMainThread([this, parentName, monitorId, name, route, rect, keyboard]() {
+        const auto parent = GetWidget(parentName);
+        if (!parent || !parent->GetWindow(monitorId)) {
+            WSS_WARN("Widget '{}' has no window on monitor ID {}, not opening popup '{}'.", parentName, monitorId, name);
+            return;
+        }
+
+        // Layer surfaces can't be positioned relative to each other, so the popup is anchored to the
+        // top left corner and the parent's position is baked into its margins.
+        const QRect parentRect = parent->GetInstanceGeometry(monitorId);
+        const QScreen* screen = MonitorRegistry::GetScreen(monitorId);
+        const QSize screenSize = screen ? screen->geometry().size() : parentRect.size();
+        const int width = std::min(rect.width(), screenSize.width());
+        const int height = std::min(rect.height(), screenSize.height());
+        const int x = std::clamp(parentRect.x() + rect.x(), 0, screenSize.width() - width);
+        const int y = std::clamp(parentRect.y() + rect.y(), 0, screenSize.height() - height);
+
+        const auto& parentInfo = parent->GetInfo();
+        WidgetInfo widgetInfo{
+            .Name = name,
+            .Route = route,
+            .Parent = parentName,
+            .MonitorSelectors = {{.Id = monitorId}},
+            .Dimensions = {.Width = std::to_string(width),
+                           .Height = std::to_string(height),
+                           .MarginTop = std::to_string(y),
+                           .MarginLeft = std::to_string(x)},
+            .ClickRegions = {{.Name = "popup", .Width = std::to_string(width), .Height = std::to_string(height)}},
+            .Layer = parentInfo.Layer,
+            .AnchorBitmask = static_cast<uint8_t>(static_cast<uint8_t>(WidgetAnchor::TOP) |
+                                                  static_cast<uint8_t>(WidgetAnchor::LEFT)),
+            .ExclusivityZone = 0,
+            .Exclusivity = false,
+            .DefaultHidden = false,
+            .Popups = parentInfo.Popups,
+            .Render = parentInfo.Render,
+            .MaxRssMb = parentInfo.MaxRssMb,
+            ._QT_padding = parentInfo._QT_padding,
+        };
+
+        WSS_DEBUG("Opening popup '{}' at {}x{}+{}+{} on monitor ID {}.", name, width, height, x, y, monitorId);
+        auto created = std::make_shared<bool>(false);
+        auto create = [this, created, widgetInfo = std::move(widgetInfo), monitorId, keyboard](QWebEnginePage* page) {
+            if (std::exchange(*created, true)) {
+                return;
+            }
+            if (page) {
+                m_PopupPages[widgetInfo.Name] = page;
+            }
+            CreateWidget(widgetInfo);
+            // Only left over if the widget wasn't created.
+            if (QWebEnginePage* unused = TakePopupPage(widgetInfo.Name)) {
+                unused->deleteLater();
+            }
+            if (keyboard) {
+                if (const auto popup = GetWidget(widgetInfo.Name)) {
+                    popup->SetKeyboardInteractivity(monitorId, true);
+                }
+            }
+        };
+
+        // A page opened by another page with window.open() stays in the opener's renderer process, so
+        // the parent page opens the popup's page and the popup adopts it.
+        // Parents that don't declare popups can't open windows, their popups get a page of their own.
+        const WebView* parentView = parent->GetWebView(monitorId);
+        if (!parentView || !parentInfo.Popups) {
+            create(nullptr);
+            return;
+        }
+        QWebEnginePage* parentPage = parentView->page();
+        QUrl url = GetFrontendUrl(route);
+        QUrlQuery query;
+        query.addQueryItem("widgetName", QString::fromStdString(name));
+        query.addQueryItem("monitorId", QString::number(monitorId));
+        url.setQuery(query);
+
+        auto connection = std::make_shared<QMetaObject::Connection>();
+        *connection = QObject::connect(
+            parentPage, &QWebEnginePage::newWindowRequested, parentPage,
+            [this, connection, create, name](QWebEngineNewWindowRequest& request) {
+                if (QUrlQuery(request.requestedUrl()).queryItemValue("widgetName").toStdString() != name) {
+                    return;
+                }
+                QObject::disconnect(*connection);
+                auto* page = new QWebEnginePage(m_Profile);
+                request.openIn(page);
+                create(page);
+            });
+        parentPage->runJavaScript(QString::fromStdString(
+            std::format("window.open({}, {});", json(url.toString().toStdString()).dump(), json(name).dump())));
+
+        QTimer::singleShot(1000, parentPage, [connection, create, created, name]() {
+            QObject::disconnect(*connection);
+            if (!*created) {
+                WSS_WARN("The parent page did not open popup '{}', giving it a page of its own.", name);
+                create(nullptr);
+            }
+        });
+    });
+    return name;
+}
+
+void WSS::Shell::ClosePopup(const std::string& parentName, const std::string& popupName) {
+    const std::string name = parentName + ":" + popupName;
+    const auto popup = GetWidget(name);
+    if (!popup || !popup->IsPopup()) {
+        throw std::invalid_argument("Popup '" + popupName + "' of widget '" + parentName + "' is not open.");
+    }
+
+    DispatchToMainThread([this, name]() {
+        WSS_DEBUG("Closing popup '{}'.", name);
+        EraseWidget(name);
+    });
+}
+
+WSS::VisibilityRequest WSS::VisibilityRequest::Parse(const std::string& text) {
+    const size_t opEnd = text.find(':');
+    if (opEnd == std::string::npos) {
+        throw std::invalid_argument("Expected <show|hide|toggle>:<widget>[:<monitor>], got '" + text + "'.");
+    }
+
+    VisibilityRequest request;
+    const std::string op = text.substr(0, opEnd);
+    if (op == "show") {
+        request.Op = VisibilityOp::SHOW;
+    } else if (op == "hide") {
+        request.Op = VisibilityOp::HIDE;
+    } else if (op == "toggle") {
+        request.Op = VisibilityOp::TOGGLE;
+    } else {
+        throw std::invalid_argument("Invalid operation '" + op + "', expected show, hide or toggle.");
+    }
+
+    // Widget names may contain colons (popups), so the monitor is only split off if it's a number.
+    request.Widget = text.substr(opEnd + 1);
+    if (const size_t monitorStart = request.Widget.rfind(':'); monitorStart != std::string::npos) {
+        const std::string monitor = request.Widget.substr(monitorStart + 1);
+        if (!monitor.empty() && std::ranges::all_of(monitor, ::isdigit)) {
+            const int monitorId = std::stoi(monitor);
+            if (monitorId >= 256) {
+                throw std::invalid_argument("Invalid monitor ID: " + monitor);
+            }
+            request.MonitorId = static_cast<uint8_t>(monitorId);
+            request.Widget.resize(monitorStart);
+        }
+    }
+    if (request.Widget.empty()) {
+        throw std::invalid_argument("Missing widget name in '" + text + "'.");
+    }
+    return request;
+}
+
+std::future<std::vector<std::string>> WSS::Shell::ApplyVisibilityBatch(std::vector<VisibilityRequest> requests,
+                                                                      const bool waitForFrame) {
+    struct BatchState {
+        std::promise<std::vector<std::string>> Promise;
+        std::vector<std::string> Errors;
+        int PendingFrames = 0;
+    };
+    auto state = std::make_shared<BatchState>();
+    auto future = state->Promise.get_future();
+
+    DispatchToMainThread([this, state, requests = std::move(requests), waitForFrame]() {
+        // Counts as pending until all changes are applied, so a frame presented early doesn't complete the batch.
+        state->PendingFrames = 1;
+        const auto done = [state]() {
+            if (--state->PendingFrames == 0) {
+                state->Promise.set_value(std::move(state->Errors));
+            }
+        };
+
+        for (const auto& request : requests) {
+            const auto widget = GetWidget(request.Widget);
+            if (!widget) {
+                state->Errors.push_back("Widget '" + request.Widget + "' does not exist.");
+                continue;
+            }
+            if (waitForFrame) {
+                state->PendingFrames++;
+            }
+            // The first frame probe gives up after a while and reports -1.
+            const auto presented = [state, done, request](const double ms) {
+                if (ms < 0) {
+                    state->Errors.push_back("Timed out waiting for widget '" + request.Widget +
+                                            "' to present a frame on monitor " + std::to_string(request.MonitorId) + ".");
+                }
+                done();
+            };
+            if (!widget->ApplyVisibilityOp(request.MonitorId, request.Op, waitForFrame ? presented : nullptr)) {
+                state->Errors.push_back("Widget '" + request.Widget + "' has no window on monitor " +
+                                        std::to_string(request.MonitorId) + ".");
+                if (waitForFrame) {
+                    state->PendingFrames--;
+                }
+            }
+        }
+        done();
+    });
+    return future;
+}
+
+std::string WSS::Shell::HandleFastPathRequest(const std::string& request) {
+    std::istringstream tokens(request);
+    std::vector<VisibilityRequest> requests;
+    bool waitForFrame = false;
+    std::string token;
+    while (tokens >> token) {
+        if (token == "wait" && requests.empty()) {
+            waitForFrame = true;
+            continue;
+        }
+        requests.push_back(VisibilityRequest::Parse(token));
+    }
+    if (requests.empty()) {
+        throw std::invalid_argument("No operations in request.");
+    }
+
+    auto future = ApplyVisibilityBatch(std::move(requests), waitForFrame);
+    if (future.wait_for(std::chrono::seconds(3)) != std::future_status::ready) {
+        return "error: timed out";
+    }
+    const auto errors = future.get();
+    if (errors.empty()) {
+        return "ok";
+    }
+
+    std::string reply = "error:";
+    for (const auto& error : errors) {
+        reply += " " + error;
+    }
+    return reply;
+}
+
+void WSS::Shell::WatchConfig() {
+    m_ConfigWatcher = new QFileSystemWatcher(m_Application);
+    m_ConfigWatcher->addPath(QString::fromStdString(m_ConfigPath));
+
+    // Editors usually save by replacing the file, which drops it from the watcher, so it has to be re-added.
+    // Saves also tend to come in bursts, hence the debounce.
+    m_ConfigReloadTimer = new QTimer(m_Application);
+    m_ConfigReloadTimer->setSingleShot(true);
+    m_ConfigReloadTimer->setInterval(250);
+    QObject::connect(m_ConfigReloadTimer, &QTimer::timeout, [this]() {
+        if (!m_ConfigWatcher->files().contains(QString::fromStdString(m_ConfigPath))) {
+            m_ConfigWatcher->addPath(QString::fromStdString(m_ConfigPath));
+        }
+        ReloadConfig();
+    });
+    QObject::connect(m_ConfigWatcher, &QFileSystemWatcher::fileChanged, [this](const QString&) { m_ConfigReloadTimer->start(); });
+
+    WSS_DEBUG("Watching configuration file at {} for changes.", m_ConfigPath);
+}
+
+void WSS::Shell::ReloadConfig() {
+    toml::table config;
+    try {
+        config = toml::parse_file(m_ConfigPath);
+    } catch (const toml::parse_error& err) {
+        WSS_ERROR("Failed to parse configuration file at {}: {}. Keeping the current configuration.", m_ConfigPath,
+                  err.description());
+        return;
+    }
+
+    const toml::table* widgets = config["widgets"].as_table();
+    if (!widgets) {
+        WSS_ERROR("Widgets configuration must be a table. Keeping the current configuration.");
+        return;
+    }
+
+    WSS_INFO("Configuration file changed, reloading widgets...");
+    if (const toml::table* profiles = config["render_profiles"].as_table()) {
+        LoadRenderProfiles(*profiles);
+    } else {
+        LoadRenderProfiles(toml::table{});
+    }
+    auto widgetInfos = ParseWidgetsConfig(*widgets);
+
+    // A widget whose expressions don't evaluate keeps its current configuration, checked before
+    // anything is applied so the reload never stops halfway.
+    std::unordered_set<std::string> invalid;
+    std::erase_if(widgetInfos, [this, &invalid](const WidgetInfo& info) {
+        if (Widget::ValidateDimensions(info, m_Monitors.Resolve(info.MonitorSelectors))) {
+            return false;
+        }
+        WSS_ERROR("-- Keeping the current configuration of widget '{}'.", info.Name);
+        invalid.insert(info.Name);
+        return true;
+    });
+
+    std::vector<std::string> removed;
+    for (const auto& [name, widget] : m_Widgets) {
+        if (widget->IsSpawned() || invalid.contains(name)) {
+            continue;
+        }
+        if (std::ranges::none_of(widgetInfos, [&name](const WidgetInfo& info) { return info.Name == name; })) {
+            removed.push_back(name);
+        }
+    }
+    for (const auto& name : removed) {
+        WSS_INFO("-- Removing widget '{}'.", name);
+        EraseWidget(name);
+    }
+
+    for (auto& widgetInfo : widgetInfos) {
+        const auto widget = GetWidget(widgetInfo.Name);
+        if (!widget) {
+            WSS_INFO("-- Adding widget '{}'.", widgetInfo.Name);
+            CreateWidget(std::move(widgetInfo));
+        } else if (widget->RequiresRebuild(widgetInfo)) {
+            WSS_INFO("-- Rebuilding widget '{}' (route or monitors changed).", widgetInfo.Name);
+            CreateWidget(std::move(widgetInfo));
+        } else {
+            widget->Reconfigure(widgetInfo);
+        }
+    }
+
+    if (const toml::table* templates = config["templates"].as_table()) {
+        LoadTemplates(*templates);
+    } else {
+        LoadTemplates(toml::table{});
+    }
+
+    if (const toml::table* zones = config["zones"].as_table()) {
+        m_Zones.Load(*zones);
+    } else {
+        m_Zones.Load(toml::table{});
+    }
+
+    WSS_INFO("Reloaded configuration.");
+}
+
+/**
+ * Blocks until everything queued on the main thread so far has run, so dispatch replies are only
+ * sent once the requested action actually happened.
+ * @param callback Runs on the main thread before returning, whatever it throws is rethrown here.
+ * It must not capture anything by reference, it still runs after a timeout.
+ * @throws std::runtime_error If the main thread doesn't get to it in time.
+ */
+static void AwaitMainThread(std::function<void()> callback = nullptr) {
+    auto done = std::make_shared<std::promise<void>>();
+    WSS::DispatchToMainThread([done, callback = std::move(callback)]() {
+        try {
+            if (callback) {
+                callback();
+            }
+            done->set_value();
+        } catch (...) {
+            done->set_exception(std::current_exception());
+        }
+    });
+    auto future = done->get_future();
+    if (future.wait_for(std::chrono::seconds(3)) != std::future_status::ready) {
+        throw std::runtime_error("Timed out waiting for the main thread.");
+    }
+    future.get();
+}
+
+/**
+ * Applies visibility changes and blocks until they're done.
+ * @throws std::runtime_error With the collected errors if any change failed, or on timeout.
+ */
+static void AwaitVisibilityBatch(WSS::Shell& shell, std::vector<WSS::VisibilityRequest> requests, const bool waitForFrame = false) {
+    auto future = shell.ApplyVisibilityBatch(std::move(requests), waitForFrame);
+    if (future.wait_for(std::chrono::seconds(3)) != std::future_status::ready) {
+        throw std::runtime_error("Timed out waiting for the main thread.");
+    }
+    if (const auto errors = future.get(); !errors.empty()) {
+        throw std::runtime_error(std::accumulate(std::next(errors.begin()), errors.end(), errors.front(),
+                                                 [](const std::string& a, const std::string& b) { return a + " " + b; }));
+    }
+}
+
 static void HandleSignal(int signal) {
     if (signal == SIGINT || signal == SIGTERM) {
         WSS::IsRunning = false;
@@ -34,28 +952,36 @@ static void HandleSignal(int signal) {
     }
 }
 
+WSS::Shell::~Shell() {
+    // The servers call into the shell from their own threads, so they're stopped while everything
+    // they use still exists. Members are destroyed in reverse order afterwards.
+    m_FastPath.Stop();
+    m_ZMQRouter.Stop();
+    m_IPC.Stop();
+}
+
 int WSS::Shell::Init(const std::string& appId, const std::string& configPath) {
     int argc = 1;
     char* argv[] = {const_cast<char*>(appId.c_str()), nullptr};
 
     LayerShellQt::Shell::useLayerShell();
     QApplication app(argc, argv);
+    m_Application = &app;
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, [this]() { m_ViewPool.Clear(); });
 
     // std::signal(SIGINT, HandleSignal);
     // std::signal(SIGTERM, HandleSignal);
 
     LoadConfig(configPath);
 
-    // Yeah...
-    qputenv("QT_WEBENGINE_CHROMIUM_FLAGS", "--use-gl=egl --enable-zero-copy --ozone-platform=wayland -ozone-platform-hint=auto "
-                                           "--ignore-gpu-blocklist "
-                                           "--enable-gpu-rasterization --disable-frame-rate-limit --no-sandbox"
-                                           "--disable-software-rasterizer --disable-software-vsync --use-vulkan "
-                                           "--enable-unsafe-webgpu --disable-sync-preferences --disable-gpu-vsync "
-                                           "--disable-features=UseSkiaRenderer,UseChromeOSDirectVideoDecoder"
-                                           "--enable-native-gpu-memory-buffers --enable-gpu-memory-buffer-video-frames"
-                                           "--enable-features=Vulkan,VaapiVideoEncoder,VaapiVideoDecoder,CanvasOopRasterization");
-    qputenv("QTWEBENGINE_DISABLE_SANDBOX", "1");
+    // Chromium reads its flags once, they can't differ between pages.
+    const std::string chromiumFlags = BuildChromiumFlags();
+    WSS_DEBUG("Chromium flags: {}", chromiumFlags);
+    qputenv("QTWEBENGINE_CHROMIUM_FLAGS", QByteArray::fromStdString(chromiumFlags));
+    if (m_Settings.m_DisableSandbox) {
+        WSS_WARN("The renderer sandbox is disabled (disable_sandbox), pages run with the privileges of the shell.");
+        qputenv("QTWEBENGINE_DISABLE_SANDBOX", "1");
+    }
     qputenv("QT_QPA_PLATFORM", "wayland");
     qputenv("EGL_PLATFORM", "wayland");
 
@@ -102,225 +1028,155 @@ void WSS::Shell::OnActivate(RenderApplication* app, ActivateCallbackPtr data) {
     WSS_ASSERT(widgets != nullptr, "Widgets configuration must be a table.");
     WSS_ASSERT(!widgets->empty(), "Widgets configuration must not be empty.");
 
-    WSS_INFO("Found {} widgets in configuration.", widgets->size());
-    for (const auto& [widgetName, node] : *widgets) {
-        const auto info = node.as_table();
-        auto name = std::string(widgetName.str());
+    shell.m_Monitors.Start();
+    shell.CreateProfile();
 
-        WSS_DEBUG("Processing widget: {}", name);
-        if (!info) {
-            WSS_ERROR("Invalid widget configuration for '{}'. Expected a table.", name);
-            continue;
+    auto createWidgets = [&shell, config = std::move(config), configPath]() {
+        const toml::table* widgets = config["widgets"].as_table();
+        WSS_INFO("Found {} widgets in configuration.", widgets->size());
+        if (const toml::table* profiles = config["render_profiles"].as_table()) {
+            shell.LoadRenderProfiles(*profiles);
         }
 
-        std::string route = info->get("route") ? info->get("route")->value_or<std::string>("") : "";
-        std::string width = info->get("width") ? info->get("width")->value_or<std::string>("") : "";
-        std::string height = info->get("height") ? info->get("height")->value_or<std::string>("") : "";
-        std::string layer = info->get("layer") ? info->get("layer")->value_or<std::string>("") : "";
-        toml::array* anchor = info->get("anchor") ? info->get("anchor")->as_array() : nullptr;
-        toml::array* monitors = info->get("monitors") ? info->get("monitors")->as_array() : nullptr;
-        int exclusivityZone = info->get("exclusivity_zone") ? info->get("exclusivity_zone")->value_or<int>(0) : 0;
-        bool exclusivity = info->get("exclusivity") ? info->get("exclusivity")->value_or<bool>(false) : false;
-        bool hidden = info->get("hidden") ? info->get("hidden")->value_or<bool>(false) : false;
-
-        std::string marginTop = info->get("margin_top") ? info->get("margin_top")->value_or<std::string>("0") : "0";
-        std::string marginBottom = info->get("margin_bottom") ? info->get("margin_bottom")->value_or<std::string>("0") : "0";
-        std::string marginLeft = info->get("margin_left") ? info->get("margin_left")->value_or<std::string>("0") : "0";
-        std::string marginRight = info->get("margin_right") ? info->get("margin_right")->value_or<std::string>("0") : "0";
-
-        int _QtPadding =
-            info->get("__QT_auto_click_region_padding") ? info->get("__QT_auto_click_region_padding")->value_or<int>(0) : 0;
-
-        std::vector<WidgetMonitorInfo> monitorIds;
-        if (!monitors) {
-            WSS_ERROR("Monitors configuration is required for widget '{}'.", name);
-            continue;
+        for (auto& widgetInfo : shell.ParseWidgetsConfig(*widgets)) {
+            shell.CreateWidget(std::move(widgetInfo));
         }
-        for (const auto& a : *monitors) {
-            try {
-                uint8_t monitorId = a.value_or<uint8_t>(0);
-                if (monitorId < 0) {
-                    WSS_ERROR("Monitor ID '{}' cannot be negative in configuration for '{}'.", monitorId, name);
-                    continue;
-                }
-
-                std::unordered_map<std::string, WidgetClickRegionInfo> clickRegionMap;
-                auto clickRegions = info->get("click_regions")->as_array();
-                if (!clickRegions) {
-                    WSS_ERROR("Click regions configuration is required for widget '{}'.", name);
-                    continue;
-                }
-                for (const auto& region : *clickRegions) {
-                    if (!region.is_table()) {
-                        WSS_ERROR("Click region must be a table in configuration for '{}'.", name);
-                        continue;
-                    }
-                    auto regionTable = region.as_table();
-                    std::string regionName = regionTable->get("name")->value_or<std::string>("");
-                    int x = DimensionParser::Parse(DimensionParser::DimensionType::WIDTH,
-                                                   regionTable->get("x")->value_or<std::string>("0"), monitorId);
-                    int y = DimensionParser::Parse(DimensionParser::DimensionType::HEIGHT,
-                                                   regionTable->get("y")->value_or<std::string>("0"), monitorId);
-                    int regionWidth = DimensionParser::Parse(DimensionParser::DimensionType::WIDTH,
-                                                             regionTable->get("width")->value_or<std::string>("0"), monitorId);
-                    int regionHeight = DimensionParser::Parse(DimensionParser::DimensionType::HEIGHT,
-                                                              regionTable->get("height")->value_or<std::string>("0"), monitorId);
-
-                    clickRegionMap[regionName] = {.X = x, .Y = y, .Width = regionWidth, .Height = regionHeight};
-                }
 
-                monitorIds.push_back(
-                    {.MonitorId = monitorId,
-                     .Width = DimensionParser::Parse(DimensionParser::DimensionType::WIDTH, width, monitorId),
-                     .Height = DimensionParser::Parse(DimensionParser::DimensionType::HEIGHT, height, monitorId),
-                     .MarginTop = DimensionParser::Parse(DimensionParser::DimensionType::HEIGHT, marginTop, monitorId),
-                     .MarginBottom = DimensionParser::Parse(DimensionParser::DimensionType::HEIGHT, marginBottom, monitorId),
-                     .MarginLeft = DimensionParser::Parse(DimensionParser::DimensionType::WIDTH, marginLeft, monitorId),
-                     .MarginRight = DimensionParser::Parse(DimensionParser::DimensionType::WIDTH, marginRight, monitorId),
-                     .ClickRegionMap = std::move(clickRegionMap)});
-            } catch (const std::invalid_argument& e) {
-                WSS_ERROR("Invalid monitor ID in configuration for '{}': {}", name, e.what());
-            } catch (const std::out_of_range& e) {
-                WSS_ERROR("Monitor ID out of range in configuration for '{}': {}", name, e.what());
-            } catch (...) {
-                WSS_ERROR("Unknown error while processing monitor ID in configuration for '{}'.", name);
-            }
+        if (const toml::table* templates = config["templates"].as_table()) {
+            shell.LoadTemplates(*templates);
         }
 
-        uint8_t anchorBitmask = 0;
-        if (!anchor) {
-            WSS_ERROR("Anchor configuration is required for widget '{}'.", name);
-            continue;
-        }
-        for (const auto& a : *anchor) {
-            if (a.is_string()) {
-                auto anchorStr = a.value_or<std::string>("");
-                if (anchorStr == "top") {
-                    anchorBitmask |= static_cast<uint8_t>(WidgetAnchor::TOP);
-                } else if (anchorStr == "bottom") {
-                    anchorBitmask |= static_cast<uint8_t>(WidgetAnchor::BOTTOM);
-                } else if (anchorStr == "left") {
-                    anchorBitmask |= static_cast<uint8_t>(WidgetAnchor::LEFT);
-                } else if (anchorStr == "right") {
-                    anchorBitmask |= static_cast<uint8_t>(WidgetAnchor::RIGHT);
-                } else {
-                    WSS_ERROR("Invalid anchor '{}' in configuration for '{}'.", anchorStr, name);
-                }
-            } else {
-                WSS_ERROR("Anchor must be a string in configuration for '{}'.", name);
-            }
+        if (const toml::table* zones = config["zones"].as_table()) {
+            shell.m_Zones.Load(*zones);
         }
 
-        if (anchorBitmask == 0) {
-            WSS_ERROR("At least one anchor must be specified for widget '{}'.", name);
-            continue;
-        }
+        shell.m_ConfigPath = configPath;
+        shell.WatchConfig();
+    };
+    // The services start right away, the widgets once the cache is warm.
+    if (shell.m_Settings.m_Prewarm) {
+        shell.Prewarm(std::move(createWidgets));
+    } else {
+        createWidgets();
+    }
 
-        if (layer.empty()) {
-            WSS_ERROR("Layer is required for widget '{}'.", name);
-            continue;
-        }
+    shell.m_ZMQPub.Start();
+    shell.m_IPC.Start();
+    shell.m_IconTheme.Start(shell.m_Settings.m_IconTheme.empty() ? QIcon::themeName().toStdString()
+                                                                 : shell.m_Settings.m_IconTheme);
+    shell.m_Notifd.Start();
+    shell.m_Appd.Start();
+    shell.m_Statd.Start();
 
-        if (monitorIds.empty()) {
-            WSS_ERROR("At least one monitor ID is required for widget '{}'.", name);
-            continue;
-        }
+    shell.m_ZMQRouter.Listen("widget-set-visible", [&shell](const json& msg) -> json {
+        const std::string op = msg["visible"].get<bool>() ? "show:" : "hide:";
+        const int monitorId = msg["monitorId"];
+        AwaitVisibilityBatch(shell, {VisibilityRequest::Parse(op + msg["widgetName"].get<std::string>() + ":" +
+                                                              std::to_string(monitorId))});
+        return nullptr;
+    });
 
-        WidgetLayer widgetLayer;
-        if (layer == "top") {
-            widgetLayer = WidgetLayer::TOP;
-        } else if (layer == "bottom") {
-            widgetLayer = WidgetLayer::BOTTOM;
-        } else if (layer == "overlay") {
-            widgetLayer = WidgetLayer::OVERLAY;
-        } else if (layer == "background") {
-            widgetLayer = WidgetLayer::BACKGROUND;
-        } else {
-            WSS_ERROR("Invalid layer '{}' for widget '{}'.", layer, name);
-            continue;
-        }
+    shell.m_ZMQRouter.Listen("widget-toggle-visible", [&shell](const json& msg) -> json {
+        const int monitorId = msg["monitorId"];
+        AwaitVisibilityBatch(shell, {VisibilityRequest::Parse("toggle:" + msg["widgetName"].get<std::string>() + ":" +
+                                                              std::to_string(monitorId))});
+        return nullptr;
+    });
 
-        WidgetInfo widgetInfo{.Name = std::string(name),
-                              .Route = route,
-                              .Monitors = std::move(monitorIds),
-                              .Layer = widgetLayer,
-                              .AnchorBitmask = anchorBitmask,
-                              .ExclusivityZone = exclusivityZone,
-                              .Exclusivity = exclusivity,
-                              .DefaultHidden = hidden,
-                              ._QT_padding = _QtPadding};
-
-        WSS_DEBUG("Creating widget with info: Name='{}', Route='{}', Layer='{}', "
-                  "AnchorBitmask='{}', Exclusivity='{}', DefaultHidden='{}'",
-                  widgetInfo.Name, widgetInfo.Route, static_cast<int>(widgetInfo.Layer),
-                  static_cast<int>(widgetInfo.AnchorBitmask), widgetInfo.Exclusivity, widgetInfo.DefaultHidden);
-
-        for (const auto& monitor : widgetInfo.Monitors) {
-            WSS_DEBUG("-- Monitor ID: {}, Width: {}, Height: {}, Margins: (Top: {}, Bottom: {}, Left: "
-                      "{}, Right: {})",
-                      monitor.MonitorId, monitor.Width, monitor.Height, monitor.MarginTop, monitor.MarginBottom,
-                      monitor.MarginLeft, monitor.MarginRight);
-            for (const auto& [regionName, regionInfo] : monitor.ClickRegionMap) {
-                WSS_DEBUG("   -- Click Region: {}, X: {}, Y: {}, Width: {}, Height: {}", regionName, regionInfo.X, regionInfo.Y,
-                          regionInfo.Width, regionInfo.Height);
+    shell.m_ZMQRouter.Listen("widget-spawn", [&shell](const json& msg) -> json {
+        std::string templateName = msg["template"];
+        std::string name = msg.value("name", "");
+        auto monitors = MonitorSelector::FromJson(msg.value("monitors", json::array()));
+        auto result = std::make_shared<std::promise<void>>();
+        name = shell.SpawnWidget(templateName, name, monitors, [result](const std::string&, const std::string& error) {
+            if (error.empty()) {
+                result->set_value();
+            } else {
+                result->set_exception(std::make_exception_ptr(std::invalid_argument(error)));
             }
+        });
+        auto future = result->get_future();
+        if (future.wait_for(std::chrono::seconds(3)) != std::future_status::ready) {
+            throw std::runtime_error("Timed out waiting for the main thread.");
         }
+        future.get();
+        return {{"name", name}};
+    });
 
-        auto widget = std::make_shared<Widget>(widgetInfo);
-        widget->Create(shell);
-        shell.m_Widgets.emplace(name, std::move(widget));
-    }
-
-    shell.m_IPC.Start();
-    shell.m_Notifd.Start();
-    shell.m_Appd.Start();
+    shell.m_ZMQRouter.Listen("widget-destroy", [&shell](const json& msg) -> json {
+        shell.DestroyWidget(msg["name"]);
+        AwaitMainThread();
+        return nullptr;
+    });
 
-    // inline void ZMQRep::Listen(std::function<json(const std::string&)> listener) {
-    shell.m_ZMQRep.Listen("widget-set-visible", [&shell](const json& msg) {
-        try {
-            std::string widgetName = msg["widgetName"];
-            bool visible = msg["visible"];
-            int monitorId = msg["monitorId"];
+    shell.m_ZMQRouter.Listen("widget-benchmark-show", [&shell](const json& msg) -> json {
+        std::string widgetName = msg["widgetName"];
+        int monitorId = msg["monitorId"];
+        int iterations = msg.value("iterations", 20);
 
-            auto widget = shell.GetWidget(widgetName);
-            if (!widget) {
-                WSS_ERROR("Widget '{}' not found for visibility update.", widgetName);
-                return;
+        auto widget = shell.GetWidget(widgetName);
+        if (!widget) {
+            throw std::runtime_error("Widget '" + widgetName + "' not found.");
+        }
+        if (monitorId < 0 || monitorId >= 256) {
+            throw std::runtime_error("Invalid monitor ID: " + std::to_string(monitorId));
+        }
+        AwaitMainThread([widget, widgetName, monitorId]() {
+            if (!widget->GetWindow(static_cast<uint8_t>(monitorId))) {
+                throw std::runtime_error("Widget '" + widgetName + "' has no window on monitor " +
+                                         std::to_string(monitorId) + ".");
             }
+        });
 
-            if (monitorId < 0 || monitorId >= 256) {
-                WSS_ERROR("Invalid monitor ID: {} for widget '{}'.", monitorId, widgetName);
-                return;
+        json samples = json::array();
+        for (int i = 0; i < iterations; i++) {
+            // Give the compositor time to actually unmap the surface before measuring the next show.
+            widget->SetVisible(static_cast<uint8_t>(monitorId), false);
+            std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+            auto latency = std::make_shared<std::promise<double>>();
+            widget->MeasureShowLatency(static_cast<uint8_t>(monitorId), [latency](double ms) { latency->set_value(ms); });
+            if (auto future = latency->get_future(); future.wait_for(std::chrono::seconds(3)) == std::future_status::ready) {
+                samples.push_back(future.get());
+            } else {
+                samples.push_back(-1);
             }
-            widget->SetVisible(static_cast<uint8_t>(monitorId), visible);
-        } catch (const json::parse_error& e) {
-            WSS_ERROR("Failed to parse JSON message: {}", e.what());
-        } catch (const std::exception& e) {
-            WSS_ERROR("Exception in ZMQRep listener: {}", e.what());
         }
+
+        const bool keepMapped = widget->GetInfo().ShowMode == WidgetShowMode::KEEP_MAPPED;
+        return {{"showMode", keepMapped ? "keep-mapped" : "remap"}, {"samples", samples}};
     });
 
-    shell.m_ZMQRep.Listen("widget-toggle-visible", [&shell](const json& msg) {
-        try {
-            std::string widgetName = msg["widgetName"];
-            int monitorId = msg["monitorId"];
+    shell.m_ZMQRouter.Listen("stats", [&shell](const json& msg) -> json { return shell.m_Statd.GetStatsJson(); });
+    shell.m_ZMQRouter.Listen("memory-report", [&shell](const json& msg) -> json { return shell.m_Statd.GetMemoryReport(); });
+    shell.m_ZMQRouter.Listen("notifd-status", [&shell](const json& msg) -> json { return shell.m_Notifd.GetStatusJson(); });
+    shell.m_ZMQRouter.Listen("notifd-dnd", [&shell](const json& msg) -> json {
+        if (msg.contains("enabled")) {
+            shell.m_Notifd.SetDoNotDisturb(msg["enabled"].get<bool>());
+        } else if (msg.value("toggle", false)) {
+            shell.m_Notifd.SetDoNotDisturb(!shell.m_Notifd.IsDoNotDisturb());
+        }
+        return {{"enabled", shell.m_Notifd.IsDoNotDisturb()}};
+    });
 
-            auto widget = shell.GetWidget(widgetName);
-            if (!widget) {
-                WSS_ERROR("Widget '{}' not found for visibility update.", widgetName);
-                return;
-            }
+    shell.m_ZMQRouter.Listen("widget-batch", [&shell](const json& msg) -> json {
+        std::vector<VisibilityRequest> requests;
+        for (const auto& operation : msg["operations"]) {
+            requests.push_back(VisibilityRequest::Parse(operation.get<std::string>()));
+        }
+        AwaitVisibilityBatch(shell, std::move(requests), msg.value("wait", false));
+        return nullptr;
+    });
 
-            if (monitorId < 0 || monitorId >= 256) {
-                WSS_ERROR("Invalid monitor ID: {} for widget '{}'.", monitorId, widgetName);
-                return;
-            }
-            widget->ToggleVisible(static_cast<uint8_t>(monitorId));
-        } catch (const json::parse_error& e) {
-            WSS_ERROR("Failed to parse JSON message: {}", e.what());
-        } catch (const std::exception& e) {
-            WSS_ERROR("Exception in ZMQRep listener: {}", e.what());
+    shell.m_ZMQRouter.Listen("emit", [&shell](const json& msg) -> json {
+        const std::string topic = msg["topic"];
+        if (topic.empty()) {
+            throw std::invalid_argument("Topic must not be empty.");
         }
+        shell.m_IPC.Emit(topic, msg.value("payload", json()));
+        return nullptr;
     });
-    shell.m_ZMQRep.RunAsync();
+
+    shell.m_ZMQRouter.RunAsync();
+    shell.m_FastPath.RunAsync([&shell](const std::string& request) { return shell.HandleFastPathRequest(request); });
 }
\ No newline at end of file
@@ -5,9 +5,21 @@
 #include <pch.h>
 #include <widget.h>
 
-#include "dispatch/zmq_rep.h"
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QWebEngineProfile>
+#include <future>
+
+#include "dispatch/fastpath_server.h"
+#include "dispatch/zmq_pub.h"
+#include "dispatch/zmq_router.h"
 #include "ipc.h"
 #include "modules/appd.h"
+#include "modules/icontheme.h"
+#include "modules/statd.h"
+#include "monitors.h"
+#include "viewpool.h"
+#include "zones.h"
 
 typedef struct {
     WSS::Shell* shell;
@@ -20,26 +32,24 @@ typedef ActivateCallbackData* ActivateCallbackPtr;
 namespace WSS {
 
 static double GetScreenWidth(int monitorId) {
-    QList<QScreen*> screens = QGuiApplication::screens();
+    QScreen* screen = MonitorRegistry::GetScreen(monitorId);
 
-    if (monitorId < 0 || monitorId >= screens.size()) {
+    if (!screen) {
         qWarning("Monitor ID '%d' does not exist.", monitorId);
         return -1;
     }
 
-    QScreen* screen = screens.at(monitorId);
     return screen->geometry().width();
 }
 
 static double GetScreenHeight(int monitorId) {
-    QList<QScreen*> screens = QGuiApplication::screens();
+    QScreen* screen = MonitorRegistry::GetScreen(monitorId);
 
-    if (monitorId < 0 || monitorId >= screens.size()) {
+    if (!screen) {
         qWarning("Monitor ID '%d' does not exist.", monitorId);
         return -1;
     }
 
-    QScreen* screen = screens.at(monitorId);
     return screen->geometry().height();
 }
 
@@ -50,6 +60,47 @@ class ShellSettings {
     int m_FrontendPort;
     int m_IpcPort;
     int m_NotificationTimeout;
+    int m_NotificationImageCacheMb = 32;
+    double m_NotificationRate = 1.0; // Notifications per second and app, 0 means no limit
+    int m_NotificationBurst = 5;     // Notifications an app may send at once before the rate limit applies
+    int m_NotificationHistory = 500; // Notifications kept in the history, 0 disables it
+    bool m_GpuRasterization = true;
+    bool m_UnlockFrameRate = false;
+    bool m_UnsafeWebGpu = false;  // WebGPU is still experimental on Linux
+    bool m_DisableSandbox = false; // Only for systems where the renderer sandbox can't start
+    std::string m_CacheDir;
+    std::string m_DataDir;
+    std::string m_IconTheme; // Empty for the theme Qt detected
+    int m_CacheSizeMb = 256;
+    bool m_Prewarm = true;
+    int m_StatsIntervalMs = 5000;
+    int m_RendererMaxRssMb = 0;      // 0 means no limit
+    int m_RendererMaxCpuPercent = 0; // 0 means no limit
+    int m_RendererCpuSamples = 6;    // Consecutive samples above the CPU limit before recycling
+};
+
+/**
+ * Represents a widget template from the [templates] table.
+ * Templates have the same structure as widgets, but their widgets are spawned (and destroyed) at runtime.
+ */
+struct WidgetTemplate {
+    WidgetInfo Info;
+    int PoolSize = 0; // Number of pre-loaded pages kept around for fast spawning
+};
+
+/**
+ * Represents a single visibility change of a batch, written as `<show|hide|toggle>:<widget>[:<monitor>]`.
+ */
+struct VisibilityRequest {
+    VisibilityOp Op = VisibilityOp::SHOW;
+    std::string Widget;
+    uint8_t MonitorId = 0;
+
+    /**
+     * Parses a visibility change from its textual form.
+     * @throws std::invalid_argument If the operation or the monitor ID is invalid.
+     */
+    static VisibilityRequest Parse(const std::string& text);
 };
 
 /**
@@ -58,23 +109,120 @@ class ShellSettings {
  */
 class Shell {
     RenderApplication* m_Application = nullptr;
+    QWebEngineProfile* m_Profile = nullptr;
+
+    // Before everything that publishes events, so it outlives them.
+    ZMQPub m_ZMQPub;
 
     IPC m_IPC{this};
+    IconTheme m_IconTheme; // Before the modules using it, so it outlives them
     Notifd m_Notifd{this};
     Appd m_Appd{this};
+    Statd m_Statd{this};
+    MonitorRegistry m_Monitors{this};
+    ViewPool m_ViewPool{this};
+    ZoneManager m_Zones{this};
 
     ShellSettings m_Settings;
-    ZMQRep m_ZMQRep;
+    // Their threads call into the shell, so they're stopped first (see ~Shell).
+    ZMQRouter m_ZMQRouter;
+    FastPathServer m_FastPath;
 
     std::unordered_map<std::string, std::shared_ptr<Widget>> m_Widgets;
+    mutable std::mutex m_WidgetsMutex;
+
+    std::unordered_map<std::string, WidgetTemplate> m_Templates;
+    mutable std::mutex m_TemplatesMutex;
+    std::atomic<uint32_t> m_SpawnCounter{0};
+
+    std::unordered_map<std::string, WidgetRenderPolicy> m_RenderProfiles;
+
+    // Pages opened by a parent page for its popups, waiting for the popup's window. Main thread only.
+    std::unordered_map<std::string, QWebEnginePage*> m_PopupPages;
+
+    std::string m_ConfigPath;
+    QFileSystemWatcher* m_ConfigWatcher = nullptr;
+    QTimer* m_ConfigReloadTimer = nullptr;
 
     static void OnActivate(RenderApplication* app, ActivateCallbackPtr data);
 
     void LoadConfig(const std::string& configPath);
 
+    /**
+     * Creates the persistent web engine profile all pages share. Unlike the default (off-the-record)
+     * profile, it keeps the HTTP cache and Chromium's compiled code cache on disk in the configured
+     * cache directory, so the frontend bundle doesn't have to be downloaded and compiled from scratch
+     * on every start.
+     */
+    void CreateProfile();
+
+    /**
+     * Loads the frontend once in a hidden page, so the cache is populated and the renderer is warm
+     * before the first widget loads. Doesn't block, the event loop keeps running meanwhile.
+     * @param done Called on the main thread once the page loaded, or after a few seconds if it doesn't.
+     */
+    void Prewarm(std::function<void()> done);
+    std::optional<WidgetInfo> ParseWidgetConfig(const std::string& name, const toml::table& info) const;
+    std::vector<WidgetInfo> ParseWidgetsConfig(const toml::table& widgets) const;
+
+    /**
+     * Parses the [render_profiles] table. Widgets and templates refer to a profile with `render_profile`
+     * and can override single values of it.
+     * @param profiles The render profiles configuration, may be empty.
+     */
+    void LoadRenderProfiles(const toml::table& profiles);
+
+    /**
+     * Builds the Chromium command line from the settings. Chromium only reads it once per process,
+     * so everything in here applies to all pages.
+     */
+    [[nodiscard]] std::string BuildChromiumFlags() const;
+
+    /**
+     * Creates a widget from its configuration and registers it.
+     * An existing widget with the same name is replaced (and destroyed).
+     * @param widgetInfo The configuration of the widget.
+     */
+    void CreateWidget(WidgetInfo widgetInfo);
+
+    /**
+     * Removes a widget along with all popups it opened. Must be called on the main thread.
+     * @param name The name of the widget to remove.
+     */
+    void EraseWidget(const std::string& name);
+
+    /**
+     * Removes the popups a widget opened, e.g. when it's replaced. Must be called on the main thread.
+     * @param parentName The name of the widget that opened the popups.
+     */
+    void ErasePopups(const std::string& parentName);
+
+    /**
+     * Loads the widget templates and sizes the view pool accordingly.
+     * @param templates The [templates] table of the configuration.
+     */
+    void LoadTemplates(const toml::table& templates);
+
+    /**
+     * Watches the configuration file and reloads it (debounced) whenever it changes.
+     */
+    void WatchConfig();
+
+    /**
+     * Reloads the widget configuration and diffs it against the running widgets.
+     * Geometry, layer, anchor, margin, exclusivity and click region changes are applied in place,
+     * widgets are only rebuilt when their route or monitor set changes.
+     */
+    void ReloadConfig();
+
+    /**
+     * Handles a request line of the fast path socket (see dispatch/fastpath.h).
+     */
+    std::string HandleFastPathRequest(const std::string& request);
+
   public:
     Shell() = default;
-    ~Shell() = default;
+    ~Shell();
     Shell(const Shell&) = delete;
     Shell(Shell&&) = delete;
     Shell& operator=(Shell&&) = delete;
@@ -84,14 +232,117 @@ class Shell {
     [[nodiscard]] IPC& GetIPC() { return m_IPC; }
     [[nodiscard]] Notifd& GetNotifd() { return m_Notifd; }
     [[nodiscard]] Appd& GetAppd() { return m_Appd; }
+    [[nodiscard]] IconTheme& GetIconTheme() { return m_IconTheme; }
+    [[nodiscard]] Statd& GetStatd() { return m_Statd; }
+    [[nodiscard]] MonitorRegistry& GetMonitors() { return m_Monitors; }
+    [[nodiscard]] ViewPool& GetViewPool() { return m_ViewPool; }
+
+    /**
+     * Takes the page opened for a popup by its parent page, see OpenPopup(). Must be called on the main thread.
+     * The caller takes ownership of the page.
+     * @param name The widget name of the popup.
+     * @return The page, or nullptr if the popup has none waiting.
+     */
+    [[nodiscard]] QWebEnginePage* TakePopupPage(const std::string& name) {
+        const auto it = m_PopupPages.find(name);
+        if (it == m_PopupPages.end()) {
+            return nullptr;
+        }
+        QWebEnginePage* page = it->second;
+        m_PopupPages.erase(it);
+        return page;
+    }
+    [[nodiscard]] QWebEngineProfile* GetProfile() const { return m_Profile; }
+    [[nodiscard]] ZoneManager& GetZones() { return m_Zones; }
+    [[nodiscard]] ZMQPub& GetPublisher() { return m_ZMQPub; }
 
     [[nodiscard]] std::shared_ptr<Widget> GetWidget(const std::string& name) const {
+        std::lock_guard lock(m_WidgetsMutex);
         if (const auto it = m_Widgets.find(name); it != m_Widgets.end()) {
             return it->second;
         }
         return nullptr;
     }
 
+    /**
+     * Gets all widgets. The map is only modified on the main thread, so this must be called from there.
+     */
+    [[nodiscard]] const std::unordered_map<std::string, std::shared_ptr<Widget>>& GetWidgets() const { return m_Widgets; }
+
+    /**
+     * Called on the main thread once a spawn request was handled, with the name of the widget and an
+     * empty error if it was spawned, or the reason it wasn't.
+     */
+    using SpawnCallback = std::function<void(const std::string& name, const std::string& error)>;
+
+    /**
+     * Spawns a widget from a template. Can be called from any thread, the widget itself is created
+     * on the main thread shortly after.
+     * @param templateName The name of the template to spawn.
+     * @param name The name of the new widget, generated from the template name if empty.
+     * @param monitors The monitors to spawn the widget on, the template's monitors if empty.
+     * @param spawned Called once the widget exists, or with an error if the name was taken in the meantime.
+     * @return The name of the widget that is going to be spawned.
+     * @throws std::invalid_argument If the template does not exist or the name is already taken.
+     */
+    std::string SpawnWidget(const std::string& templateName, std::string name, const std::vector<MonitorSelector>& monitors,
+                            SpawnCallback spawned = nullptr);
+
+    /**
+     * Destroys a widget that was spawned from a template. Can be called from any thread.
+     * @param name The name of the widget to destroy.
+     * @throws std::invalid_argument If the widget does not exist or wasn't spawned from a template.
+     */
+    void DestroyWidget(const std::string& name);
+
+    /**
+     * Opens a popup surface attached to a widget. The popup is a separate, small layer surface
+     * positioned relative to the parent window, so the parent doesn't have to be large (and mostly
+     * transparent) just to make room for popovers. The popup's page is opened by the parent page
+     * (window.open), so Chromium keeps it in the parent's renderer process instead of starting another
+     * one. If the parent page doesn't open it within a second (e.g. it's frozen), the popup gets a page
+     * of its own. It goes away together with its parent. Can be called from any thread.
+     * @param parentName The name of the widget opening the popup.
+     * @param monitorId The monitor of the parent window the popup is attached to.
+     * @param popupName The name of the popup, unique per parent.
+     * @param route The route the popup loads.
+     * @param rect The geometry of the popup relative to the parent window.
+     * @param keyboard Whether the popup takes keyboard input on demand.
+     * @return The widget name of the popup, which is how its page identifies itself.
+     * @throws std::invalid_argument If the parent does not exist or has no window on that monitor.
+     */
+    std::string OpenPopup(const std::string& parentName, uint8_t monitorId, const std::string& popupName,
+                          const std::string& route, const QRect& rect, bool keyboard);
+
+    /**
+     * Closes a popup opened with OpenPopup(). Can be called from any thread.
+     * @param parentName The name of the widget that opened the popup.
+     * @param popupName The name of the popup.
+     */
+    void ClosePopup(const std::string& parentName, const std::string& popupName);
+
+    /**
+     * Applies several visibility changes within the same main loop iteration, so e.g. hiding one
+     * widget and showing another on every monitor reaches the compositor together.
+     * Can be called from any thread.
+     * @param requests The changes to apply, in order.
+     * @param waitForFrame Whether the result is only ready once all shown windows presented their first frame.
+     * @return The errors of the changes that couldn't be applied (or whose frame never came), empty if all of them were.
+     */
+    std::future<std::vector<std::string>> ApplyVisibilityBatch(std::vector<VisibilityRequest> requests, bool waitForFrame);
+
+    /**
+     * Gets the URL of the specified route on the frontend server.
+     * @param route The route, e.g. "/launcher".
+     */
+    [[nodiscard]] QUrl GetFrontendUrl(const std::string& route) const {
+        QString uri = QString("http://localhost:%1").arg(m_Settings.m_FrontendPort);
+        if (!route.empty()) {
+            uri += QString::fromStdString(route);
+        }
+        return QUrl(uri);
+    }
+
     [[nodiscard]] bool IsValid() const { return m_Application != nullptr; }
 
     [[nodiscard]] RenderApplication* GetApplication() const { return m_Application; }
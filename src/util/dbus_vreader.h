@@ -1,116 +1,189 @@
 #ifndef DBUS_VREADER_H
 #define DBUS_VREADER_H
 
-#include <iostream>
 #include <map>
+#include <nlohmann/json.hpp>
 #include <sdbus-c++/sdbus-c++.h>
 #include <string>
 #include <vector>
 
-static std::string ReadDbusVariant(const sdbus::Variant& var);
+/**
+ * Reads the next complete value of a message into JSON, descending into containers.
+ * Integers and booleans keep their type, strings, object paths and signatures become strings,
+ * arrays and structs become arrays and dictionaries become objects (non-string keys are stringified,
+ * as JSON requires). Byte arrays are read in one go, they can be large (e.g. image data).
+ * @param msg The message positioned at the value to read.
+ * @throws sdbus::Error If the message is malformed.
+ */
+inline nlohmann::json ReadDbusValue(sdbus::Message& msg) {
+    const auto [type, contents] = msg.peekType();
 
-inline std::string ReadDbusContainer(const std::vector<sdbus::Variant>& vec) {
-    std::string res = "[";
-    bool first = true;
-    for (const auto& elem : vec) {
-        if (!first)
-            res += ", ";
-        res += ReadDbusVariant(elem);
-        first = false;
-    }
-    res += "]";
-    return res;
-}
+    switch (type) {
+    case 'b': {
+        bool value = false;
+        msg >> value;
+        return value;
+    }
+    case 'y': {
+        uint8_t value = 0;
+        msg >> value;
+        return value;
+    }
+    case 'n': {
+        int16_t value = 0;
+        msg >> value;
+        return value;
+    }
+    case 'q': {
+        uint16_t value = 0;
+        msg >> value;
+        return value;
+    }
+    case 'i': {
+        int32_t value = 0;
+        msg >> value;
+        return value;
+    }
+    case 'u': {
+        uint32_t value = 0;
+        msg >> value;
+        return value;
+    }
+    case 'x': {
+        int64_t value = 0;
+        msg >> value;
+        return value;
+    }
+    case 't': {
+        uint64_t value = 0;
+        msg >> value;
+        return value;
+    }
+    case 'd': {
+        double value = 0;
+        msg >> value;
+        return value;
+    }
+    case 'h': {
+        sdbus::UnixFd value;
+        msg >> value;
+        return value.get();
+    }
+    case 's': {
+        std::string value;
+        msg >> value;
+        return value;
+    }
+    case 'o': {
+        sdbus::ObjectPath value;
+        msg >> value;
+        return std::string(std::move(value));
+    }
+    case 'g': {
+        sdbus::Signature value;
+        msg >> value;
+        return std::string(std::move(value));
+    }
+    case 'v': {
+        msg.enterVariant(contents);
+        nlohmann::json value = ReadDbusValue(msg);
+        msg.exitVariant();
+        return value;
+    }
+    case 'r': {
+        nlohmann::json value = nlohmann::json::array();
+        msg.enterStruct(contents);
+        while (!msg.isAtEnd(false)) {
+            value.push_back(ReadDbusValue(msg));
+        }
+        msg.exitStruct();
+        return value;
+    }
+    case 'a': {
+        const std::string element(contents);
+        if (element == "y") {
+            std::vector<uint8_t> bytes;
+            msg >> bytes;
+            return bytes;
+        }
 
-inline std::string ReadDbusMap(const std::map<std::string, sdbus::Variant>& m) {
-    std::string res = "{";
-    bool first = true;
-    for (const auto& [key, val] : m) {
-        if (!first)
-            res += ", ";
-        res += key + ": " + ReadDbusVariant(val);
-        first = false;
+        if (element.starts_with('{')) {
+            const std::string entry = element.substr(1, element.size() - 2);
+            nlohmann::json value = nlohmann::json::object();
+            msg.enterArray(contents);
+            while (!msg.isAtEnd(false)) {
+                msg.enterDictEntry(entry.c_str());
+                nlohmann::json key = ReadDbusValue(msg);
+                nlohmann::json item = ReadDbusValue(msg);
+                msg.exitDictEntry();
+                value[key.is_string() ? key.get<std::string>() : key.dump()] = std::move(item);
+            }
+            msg.exitArray();
+            return value;
+        }
+
+        nlohmann::json value = nlohmann::json::array();
+        msg.enterArray(contents);
+        while (!msg.isAtEnd(false)) {
+            value.push_back(ReadDbusValue(msg));
+        }
+        msg.exitArray();
+        return value;
+    }
+    default:
+        throw sdbus::Error(sdbus::Error::Name{"org.freedesktop.DBus.Error.InvalidSignature"},
+                           std::string("Unsupported D-Bus type '") + type + "'");
     }
-    res += "}";
-    return res;
 }
 
-static std::string ReadDbusVariant(const sdbus::Variant& var) {
-    std::string sig = var.peekValueType();
-
+/**
+ * Converts a variant into JSON, see ReadDbusValue for the mapping of the D-Bus types.
+ * Basic types are read straight from the variant, containers are walked through a copy of its message.
+ * @param var The variant to convert. An empty variant becomes null.
+ */
+inline nlohmann::json ReadDbusVariant(const sdbus::Variant& var) {
+    const std::string sig = var.isEmpty() ? "" : var.peekValueType();
     if (sig.empty())
-        return "<empty>";
-
-    char type = sig[0];
+        return nullptr;
 
-    switch (type) {
+    switch (sig[0]) {
     case 'b':
-        return var.get<bool>() ? "true" : "false";
+        return var.get<bool>();
     case 'y':
-        return std::to_string(var.get<uint8_t>());
-    case 'n':
-        return std::to_string(var.get<int16_t>());
-    case 'q':
-        return std::to_string(var.get<uint16_t>());
+        return var.get<uint8_t>();
     case 'i':
-        return std::to_string(var.get<int32_t>());
+        return var.get<int32_t>();
     case 'u':
-        return std::to_string(var.get<uint32_t>());
+        return var.get<uint32_t>();
     case 'x':
-        return std::to_string(var.get<int64_t>());
-    case 't':
-        return std::to_string(var.get<uint64_t>());
+        return var.get<int64_t>();
     case 'd':
-        return std::to_string(var.get<double>());
+        return var.get<double>();
     case 's':
-        return "\"" + var.get<std::string>() + "\"";
-    case 'o':
-        return "object-path:\"" + var.get<std::string>() + "\"";
-    case 'g':
-        return "signature:\"" + var.get<std::string>() + "\"";
-    case 'v':
-        // Variant containing a variant, unwrap recursively
-        return ReadDbusVariant(var.get<sdbus::Variant>());
-    case 'a': {
-        // array: check the second char to distinguish types
-        if (sig.length() > 1 && sig[1] == '{') {
-            // dictionary a{kv} usually a{sv}
-            try {
-                auto m = var.get<std::map<std::string, sdbus::Variant>>();
-                return ReadDbusMap(m);
-            } catch (...) {
-                return "<invalid dictionary>";
-            }
-        } else {
-            // array of something else (often vector<Variant>)
-            try {
-                auto vec = var.get<std::vector<sdbus::Variant>>();
-                return ReadDbusContainer(vec);
-            } catch (...) {
-                try {
-                    // fallback to array of strings for example
-                    auto vecStr = var.get<std::vector<std::string>>();
-                    std::string res = "[";
-                    bool first = true;
-                    for (const auto& s : vecStr) {
-                        if (!first)
-                            res += ", ";
-                        res += "\"" + s + "\"";
-                        first = false;
-                    }
-                    res += "]";
-                    return res;
-                } catch (...) {
-                    return "<invalid array>";
-                }
-            }
-        }
+        return var.get<std::string>();
+    default: {
+        auto msg = sdbus::createPlainMessage();
+        var.serializeTo(msg);
+        msg.seal();
+        msg.rewind(true);
+        return ReadDbusValue(msg);
     }
-    case '(': // struct
-        return "<struct>";
-    default:
-        return "<unsupported type>";
     }
 }
 
+/**
+ * Converts a dictionary of variants (e.g. notification hints or D-Bus properties) into a JSON object.
+ */
+inline nlohmann::json ReadDbusMap(const std::map<std::string, sdbus::Variant>& m) {
+    nlohmann::json res = nlohmann::json::object();
+    for (const auto& [key, val] : m) {
+        try {
+            res[key] = ReadDbusVariant(val);
+        } catch (const sdbus::Error&) {
+            res[key] = nullptr;
+        }
+    }
+    return res;
+}
+
 #endif // DBUS_VREADER_H
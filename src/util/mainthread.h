@@ -0,0 +1,29 @@
+#ifndef MAINTHREAD_H
+#define MAINTHREAD_H
+
+#include <pch.h>
+
+#include <QTimer>
+
+namespace WSS {
+
+/**
+ * Dispatches a callback to the main thread.
+ * Qt objects (windows, web views, layer surfaces) may only be touched from the main thread, so
+ * everything coming in from the IPC, ZMQ or D-Bus threads has to go through here.
+ * @param callback The callback function to be executed on the main thread.
+ */
+inline void DispatchToMainThread(const std::function<void()>& callback) {
+    const auto timer = new QTimer();
+    timer->moveToThread(qApp->thread());
+    timer->setSingleShot(true);
+    QObject::connect(timer, &QTimer::timeout, [=]() {
+        callback();
+        timer->deleteLater();
+    });
+    QMetaObject::invokeMethod(timer, "start", Qt::QueuedConnection, Q_ARG(int, 0));
+}
+
+} // namespace WSS
+
+#endif // MAINTHREAD_H
@@ -0,0 +1,186 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <pch.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <thread>
+
+namespace WSS {
+
+/**
+ * Runs keyed one-shot timers on a single thread, using a hashed timing wheel.
+ * Scheduling and cancelling are O(1) no matter how many timers are pending, and scheduling a key
+ * again replaces its timer, so a stale timer can never fire for a replaced entry.
+ * The thread sleeps on a timerfd that is only armed while timers are pending. Timers fire with the
+ * granularity of one tick, on the wheel's thread, outside of its lock (callbacks may schedule and
+ * cancel timers themselves).
+ */
+class TimerWheel {
+    struct Entry {
+        uint64_t Key;
+        uint64_t Rounds; // Full turns of the wheel left before the timer is due
+        std::function<void()> Callback;
+    };
+
+    const std::chrono::milliseconds m_Tick;
+    std::vector<std::list<Entry>> m_Slots;
+    std::unordered_map<uint64_t, std::pair<size_t, std::list<Entry>::iterator>> m_Index;
+    size_t m_Cursor = 0;
+    bool m_Armed = false;
+    std::mutex m_Mutex;
+
+    int m_TimerFd = -1;
+    int m_WakeFd = -1;
+    std::atomic_bool m_Running{false};
+    std::thread m_Thread;
+
+    void Arm(const bool armed) {
+        const auto tickNs = std::chrono::duration_cast<std::chrono::nanoseconds>(m_Tick).count();
+        itimerspec spec{};
+        if (armed) {
+            spec.it_interval = {.tv_sec = tickNs / 1000000000, .tv_nsec = tickNs % 1000000000};
+            spec.it_value = spec.it_interval;
+        }
+        timerfd_settime(m_TimerFd, 0, &spec, nullptr);
+        m_Armed = armed;
+    }
+
+    void Advance(const uint64_t ticks) {
+        std::vector<std::function<void()>> due;
+        {
+            std::lock_guard lock(m_Mutex);
+            for (uint64_t i = 0; i < ticks && !m_Index.empty(); i++) {
+                m_Cursor = (m_Cursor + 1) % m_Slots.size();
+                auto& slot = m_Slots[m_Cursor];
+                for (auto it = slot.begin(); it != slot.end();) {
+                    if (it->Rounds > 0) {
+                        it->Rounds--;
+                        ++it;
+                        continue;
+                    }
+                    due.push_back(std::move(it->Callback));
+                    m_Index.erase(it->Key);
+                    it = slot.erase(it);
+                }
+            }
+            if (m_Index.empty() && m_Armed) {
+                Arm(false);
+            }
+        }
+        for (auto& callback : due) {
+            callback();
+        }
+    }
+
+  public:
+    /**
+     * @param tick The granularity of the timers.
+     * @param slots The number of slots of the wheel. Timers further away than slots * tick take extra turns.
+     */
+    explicit TimerWheel(const std::chrono::milliseconds tick = std::chrono::milliseconds(10), const size_t slots = 512)
+        : m_Tick(tick), m_Slots(slots) {}
+
+    ~TimerWheel() { Stop(); }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) = delete;
+    TimerWheel& operator=(TimerWheel&&) = delete;
+
+    /**
+     * Starts the timer thread. Timers scheduled before are kept.
+     */
+    void Start() {
+        m_TimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        m_WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        {
+            std::lock_guard lock(m_Mutex);
+            if (!m_Index.empty()) {
+                Arm(true);
+            }
+        }
+
+        m_Running = true;
+        m_Thread = std::thread([this]() {
+            pollfd fds[] = {{.fd = m_TimerFd, .events = POLLIN, .revents = 0}, {.fd = m_WakeFd, .events = POLLIN, .revents = 0}};
+            while (m_Running) {
+                if (poll(fds, 2, -1) <= 0 || !(fds[0].revents & POLLIN)) {
+                    continue;
+                }
+                uint64_t expirations = 0;
+                if (read(m_TimerFd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                    Advance(expirations);
+                }
+            }
+        });
+    }
+
+    void Stop() {
+        if (!m_Running.exchange(false)) {
+            return;
+        }
+        const uint64_t one = 1;
+        if (write(m_WakeFd, &one, sizeof(one)) != sizeof(one)) {
+            WSS_ERROR("Failed to wake the timer thread: {}", strerror(errno));
+        }
+        if (m_Thread.joinable()) {
+            m_Thread.join();
+        }
+        close(m_TimerFd);
+        close(m_WakeFd);
+    }
+
+    /**
+     * Schedules a timer, replacing the pending timer with the same key if there is one.
+     * @param key The key to cancel or replace the timer with later.
+     * @param delay The time until the timer fires, rounded up to whole ticks.
+     * @param callback Called on the timer thread once the timer is due.
+     */
+    void Schedule(const uint64_t key, const std::chrono::milliseconds delay, std::function<void()> callback) {
+        const uint64_t ticks = std::max<uint64_t>(1, (delay.count() + m_Tick.count() - 1) / m_Tick.count());
+
+        std::lock_guard lock(m_Mutex);
+        if (const auto it = m_Index.find(key); it != m_Index.end()) {
+            m_Slots[it->second.first].erase(it->second.second);
+            m_Index.erase(it);
+        }
+
+        const size_t slot = (m_Cursor + ticks) % m_Slots.size();
+        auto& list = m_Slots[slot];
+        list.push_back({.Key = key, .Rounds = (ticks - 1) / m_Slots.size(), .Callback = std::move(callback)});
+        m_Index[key] = {slot, std::prev(list.end())};
+
+        if (!m_Armed && m_TimerFd >= 0) {
+            Arm(true);
+        }
+    }
+
+    /**
+     * Cancels a pending timer.
+     * @return False if there was no pending timer with this key (e.g. it fired already).
+     */
+    bool Cancel(const uint64_t key) {
+        std::lock_guard lock(m_Mutex);
+        const auto it = m_Index.find(key);
+        if (it == m_Index.end()) {
+            return false;
+        }
+        m_Slots[it->second.first].erase(it->second.second);
+        m_Index.erase(it);
+        return true;
+    }
+
+    [[nodiscard]] size_t GetPending() {
+        std::lock_guard lock(m_Mutex);
+        return m_Index.size();
+    }
+};
+} // namespace WSS
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,51 @@
+#ifndef WAYLAND_H
+#define WAYLAND_H
+
+#include <pch.h>
+#include <qpa/qplatformnativeinterface.h>
+#include <wayland-client.h>
+
+#include <QGuiApplication>
+#include <QRegion>
+#include <QWindow>
+
+namespace WSS {
+
+/**
+ * Sets the opaque region of the Wayland surface behind a window.
+ * The region is double-buffered state, it takes effect with the next frame Qt commits.
+ * An empty region clears it (the whole surface may be translucent again).
+ * @param window The window whose surface to update.
+ * @param region The opaque region in surface-local coordinates.
+ * @return False if the window has no surface (yet), e.g. because it's not mapped.
+ */
+inline bool SetSurfaceOpaqueRegion(QWindow* window, const QRegion& region) {
+    auto* nativeInterface = QGuiApplication::platformNativeInterface();
+    const auto* waylandApp = qGuiApp->nativeInterface<QNativeInterface::QWaylandApplication>();
+    if (!nativeInterface || !waylandApp || !window->handle()) {
+        return false;
+    }
+
+    auto* surface = static_cast<wl_surface*>(nativeInterface->nativeResourceForWindow("surface", window));
+    wl_compositor* compositor = waylandApp->compositor();
+    if (!surface || !compositor) {
+        return false;
+    }
+
+    if (region.isEmpty()) {
+        wl_surface_set_opaque_region(surface, nullptr);
+        return true;
+    }
+
+    wl_region* opaque = wl_compositor_create_region(compositor);
+    for (const QRect& rect : region) {
+        wl_region_add(opaque, rect.x(), rect.y(), rect.width(), rect.height());
+    }
+    wl_surface_set_opaque_region(surface, opaque);
+    wl_region_destroy(opaque);
+    return true;
+}
+
+} // namespace WSS
+
+#endif // WAYLAND_H
@@ -0,0 +1,82 @@
+#include "viewpool.h"
+
+#include <QTimer>
+#include <QUrlQuery>
+#include <format>
+
+#include "shell.h"
+
+QUrl WSS::ViewPool::GetPoolUrl(const std::string& route) const {
+    QUrl url = m_Shell->GetFrontendUrl(route);
+    QUrlQuery query;
+    query.addQueryItem("pooled", "1");
+    url.setQuery(query);
+    return url;
+}
+
+void WSS::ViewPool::Reserve(const std::string& route, const int size) {
+    auto& pool = m_Pools[route];
+    pool.Size = std::max(size, 0);
+
+    while (pool.Pages.size() > static_cast<size_t>(pool.Size)) {
+        pool.Pages.back()->deleteLater();
+        pool.Pages.pop_back();
+    }
+    Fill(route);
+}
+
+void WSS::ViewPool::Fill(const std::string& route) {
+    auto& pool = m_Pools[route];
+    while (pool.Pages.size() < static_cast<size_t>(pool.Size)) {
+        auto* page = new QWebEnginePage(m_Shell->GetProfile());
+        page->setBackgroundColor(Qt::transparent);
+        QObject::connect(page, &QWebEnginePage::loadFinished, page, [page](const bool ok) { page->setProperty("wssLoaded", ok); });
+        page->load(GetPoolUrl(route));
+        pool.Pages.push_back(page);
+    }
+    WSS_DEBUG("View pool for route '{}' holds {} pages.", route, pool.Pages.size());
+}
+
+QWebEnginePage* WSS::ViewPool::Acquire(const std::string& route, const std::string& widgetName, const uint8_t monitorId) {
+    const auto it = m_Pools.find(route);
+    if (it == m_Pools.end() || it->second.Pages.empty()) {
+        return nullptr;
+    }
+
+    QWebEnginePage* page = it->second.Pages.front();
+    it->second.Pages.pop_front();
+
+    QUrl url = m_Shell->GetFrontendUrl(route);
+    QUrlQuery query;
+    query.addQueryItem("widgetName", QString::fromStdString(widgetName));
+    query.addQueryItem("monitorId", QString::number(monitorId));
+    url.setQuery(query);
+
+    if (page->property("wssLoaded").toBool()) {
+        // The page is already running, so just tell it who it is. The URL is updated as well, in case
+        // the frontend reads the identity from there.
+        const std::string pathAndQuery = url.toString(QUrl::RemoveScheme | QUrl::RemoveAuthority).toStdString();
+        const std::string script =
+            std::format("history.replaceState(history.state, '', {});"
+                        "window.dispatchEvent(new CustomEvent('wss:assign', {{ detail: {} }}));",
+                        json(pathAndQuery).dump(), json({{"widgetName", widgetName}, {"monitorId", monitorId}}).dump());
+        page->runJavaScript(QString::fromStdString(script));
+    } else {
+        // Still loading: start over with the right URL. The renderer process is warm at least.
+        page->load(url);
+    }
+
+    WSS_DEBUG("Handed out a pooled page for route '{}' to widget '{}' on monitor ID: {}", route, widgetName, monitorId);
+    QTimer::singleShot(0, [this, route]() { Fill(route); });
+    return page;
+}
+
+void WSS::ViewPool::Clear() {
+    for (auto& [route, pool] : m_Pools) {
+        for (auto* page : pool.Pages) {
+            page->deleteLater();
+        }
+        pool.Pages.clear();
+    }
+    m_Pools.clear();
+}
@@ -0,0 +1,72 @@
+#ifndef VIEWPOOL_H
+#define VIEWPOOL_H
+
+#include <pch.h>
+
+#include <QWebEnginePage>
+#include <deque>
+
+namespace WSS {
+class Shell;
+}
+namespace WSS {
+
+/**
+ * Keeps a small number of pre-created, pre-loaded web pages per route around.
+ * A cold QWebEngineView has to spin up a renderer, fetch and parse the bundle and boot the page,
+ * which takes seconds. Widgets spawned at runtime take an already loaded page from the pool
+ * instead and only get their identity (widget name, monitor ID) assigned, which takes milliseconds.
+ *
+ * The page learns about its identity through a "wss:assign" DOM event; wss-js handles it by
+ * handshaking again. The pool is refilled in the background after every handout.
+ * All methods must be called on the main thread.
+ */
+class ViewPool {
+    struct Pool {
+        int Size = 0;
+        std::deque<QWebEnginePage*> Pages;
+    };
+
+    Shell* m_Shell = nullptr;
+    std::unordered_map<std::string, Pool> m_Pools;
+
+    void Fill(const std::string& route);
+    [[nodiscard]] QUrl GetPoolUrl(const std::string& route) const;
+
+  public:
+    explicit ViewPool(Shell* shell) : m_Shell(shell) {
+        WSS_ASSERT(m_Shell != nullptr, "Shell instance must not be null.");
+        WSS_DEBUG("ViewPool initialized with Shell instance.");
+    }
+
+    ~ViewPool() = default;
+
+    ViewPool(const ViewPool&) = delete;
+    ViewPool(ViewPool&&) = delete;
+    ViewPool& operator=(ViewPool&&) = delete;
+
+    /**
+     * Sets how many pre-loaded pages to keep around for the specified route and starts loading them.
+     * @param route The route of the pages.
+     * @param size The number of pages to keep loaded, 0 disables the pool for this route.
+     */
+    void Reserve(const std::string& route, int size);
+
+    /**
+     * Takes a pre-loaded page for the specified route out of the pool and assigns it an identity.
+     * The caller takes ownership of the page.
+     * @param route The route of the page.
+     * @param widgetName The name of the widget the page is for.
+     * @param monitorId The ID of the monitor the page is shown on.
+     * @return The page, or nullptr if the pool for this route is empty.
+     */
+    QWebEnginePage* Acquire(const std::string& route, const std::string& widgetName, uint8_t monitorId);
+
+    /**
+     * Destroys all pooled pages. Must happen before the QApplication goes away.
+     */
+    void Clear();
+};
+} // namespace WSS
+
+#endif // VIEWPOOL_H
@@ -3,15 +3,111 @@
 #include <qevent.h>
 
 #include <QApplication>
+#include <QAudioOutput>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QImageReader>
 #include <QMainWindow>
+#include <QMediaPlayer>
+#include <QPainter>
+#include <QPointer>
+#include <QQuickWidget>
 #include <QScreen>
 #include <QUrlQuery>
+#include <QVideoWidget>
+#include <QWebEngineScript>
+#include <QWebEngineScriptCollection>
 #include <QWebEngineSettings>
 #include <QWebEngineView>
 #include <QWindow>
 
 #include "shell.h"
+#include "util/dimparser.h"
+#include "util/wayland.h"
+
+/**
+ * Waits for the first frame a window presents after being shown.
+ * The first update request on the exposed window makes Qt paint and commit a frame. The update
+ * request after that only arrives once the compositor's frame callback for that commit fired,
+ * i.e. once the frame was actually presented.
+ */
+class FirstFrameProbe : public QObject {
+    std::chrono::steady_clock::time_point m_Start;
+    std::function<void(double)> m_Callback;
+    bool m_Committed = false;
+
+   public:
+    FirstFrameProbe(QWindow* window, const std::chrono::steady_clock::time_point start, std::function<void(double)> callback)
+        : QObject(window), m_Start(start), m_Callback(std::move(callback)) {
+        window->installEventFilter(this);
+        QTimer::singleShot(2000, this, [this]() { Finish(-1); });
+    }
+
+    void Finish(const double ms) {
+        if (!m_Callback) {
+            return;
+        }
+        auto callback = std::move(m_Callback);
+        m_Callback = nullptr;
+        callback(ms);
+        deleteLater();
+    }
+
+   protected:
+    bool eventFilter(QObject* watched, QEvent* event) override {
+        auto* window = static_cast<QWindow*>(watched);
+        if ((event->type() == QEvent::Expose || event->type() == QEvent::UpdateRequest) && window->isExposed()) {
+            if (m_Committed && event->type() == QEvent::UpdateRequest) {
+                Finish(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_Start).count());
+            } else {
+                m_Committed = true;
+                window->requestUpdate();
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * Caps requestAnimationFrame at window.__wssMaxFps (0 = uncapped). Frames in between are skipped, all
+ * callbacks of an allowed frame still run in that same frame. Safe to run again to change the cap.
+ */
+static constexpr auto RenderPolicyScript = R"JS(
+(() => {
+  window.__wssMaxFps = %1;
+  if (window.__wssRafCapped) return;
+  window.__wssRafCapped = true;
+
+  const raf = window.requestAnimationFrame.bind(window);
+  const cancel = window.cancelAnimationFrame.bind(window);
+  const pending = new Map();
+  let nextId = 1;
+  let lastFrame = -Infinity;
+
+  window.requestAnimationFrame = (callback) => {
+    const id = nextId++;
+    const tick = (time) => {
+      const fps = window.__wssMaxFps;
+      if (fps > 0 && time !== lastFrame && time - lastFrame < 1000 / fps - 1) {
+        pending.set(id, raf(tick));
+        return;
+      }
+      lastFrame = time;
+      pending.delete(id);
+      callback(time);
+    };
+    pending.set(id, raf(tick));
+    return id;
+  };
+
+  window.cancelAnimationFrame = (id) => {
+    if (pending.has(id)) {
+      cancel(pending.get(id));
+      pending.delete(id);
+    }
+  };
+})();
+)JS";
 
 class NoContextMenuWebEngineView : public QWebEngineView {
     Q_OBJECT
@@ -22,38 +118,806 @@ class NoContextMenuWebEngineView : public QWebEngineView {
     void contextMenuEvent(QContextMenuEvent* event) override { event->ignore(); }
 };
 
+/**
+ * Reloads a page whose render process crashed or was killed (e.g. by the OOM killer).
+ * Reloads are delayed with an exponential backoff, so a page that crashes right after loading
+ * doesn't keep the renderer restarting in a tight loop. The backoff resets once a page survived
+ * for a while.
+ */
+class RendererRecovery : public QObject {
+    static constexpr int BaseDelayMs = 1000;
+    static constexpr int MaxDelayMs = 60000;
+    static constexpr auto StableAfter = std::chrono::minutes(5);
+
+    QWebEngineView* m_View;
+    std::string m_Name;
+    int m_Attempts = 0;
+    std::chrono::steady_clock::time_point m_LastCrash;
+
+   public:
+    RendererRecovery(QWebEngineView* view, std::string name) : QObject(view), m_View(view), m_Name(std::move(name)) {
+        connect(view->page(), &QWebEnginePage::renderProcessTerminated, this,
+                [this](const QWebEnginePage::RenderProcessTerminationStatus status, const int exitCode) {
+                    if (status != QWebEnginePage::NormalTerminationStatus) {
+                        OnTerminated(exitCode);
+                    }
+                });
+    }
+
+    void OnTerminated(const int exitCode) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_LastCrash >= StableAfter) {
+            m_Attempts = 0;
+        }
+        m_LastCrash = now;
+
+        const int delay = std::min(BaseDelayMs << std::min(m_Attempts, 6), MaxDelayMs);
+        m_Attempts++;
+        WSS_ERROR("Renderer of widget '{}' terminated (exit code {}), reloading in {} ms (attempt {}).", m_Name, exitCode,
+                  delay, m_Attempts);
+        QTimer::singleShot(delay, m_View, [view = m_View]() { view->reload(); });
+    }
+};
+
+/**
+ * Draws an image scaled to cover the widget, cropping what doesn't fit.
+ */
+class ImageView : public QWidget {
+    QImage m_Image;
+
+   public:
+    ImageView(QImage image, QWidget* parent) : QWidget(parent), m_Image(std::move(image)) {
+        setAttribute(Qt::WA_TranslucentBackground);
+    }
+
+   protected:
+    void paintEvent(QPaintEvent*) override {
+        if (m_Image.isNull()) {
+            return;
+        }
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        const QSizeF scaled = QSizeF(m_Image.size()).scaled(size(), Qt::KeepAspectRatioByExpanding);
+        const QRectF target((width() - scaled.width()) / 2, (height() - scaled.height()) / 2, scaled.width(), scaled.height());
+        painter.drawImage(target, m_Image);
+    }
+};
+
+class MirrorSource;
+
+/**
+ * Shows the frames of a mirrored widget's page on another monitor and forwards input back to it.
+ */
+class MirrorView : public QWidget {
+    QPointer<MirrorSource> m_Source;
+    uint8_t m_MonitorId;
+    QImage m_Frame;
+
+   public:
+    MirrorView(MirrorSource* source, const uint8_t monitorId, QWidget* parent)
+        : QWidget(parent), m_Source(source), m_MonitorId(monitorId) {
+        setMouseTracking(true);
+        setFocusPolicy(Qt::StrongFocus);
+        setAttribute(Qt::WA_TranslucentBackground);
+    }
+
+    void SetFrame(const QImage& frame) {
+        m_Frame = frame;
+        update();
+    }
+
+   protected:
+    void paintEvent(QPaintEvent*) override {
+        QPainter painter(this);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.fillRect(rect(), Qt::transparent);
+        if (!m_Frame.isNull()) {
+            painter.drawImage(rect(), m_Frame);
+        }
+    }
+
+    bool event(QEvent* event) override;
+};
+
+/**
+ * Lives on the web view that renders a mirrored widget and hands its frames to the mirrors.
+ * Frames are taken whenever the view's render delegate swapped a frame, so an idle page costs nothing,
+ * but at most at the frame rate of the source's render policy: every capture is a read back from the
+ * GPU. Nothing is captured while no mirror is shown. Until the delegate exists (or if it isn't a
+ * QQuickWidget), the view is grabbed at a fixed rate. QtWebEngine replaces the delegate when the
+ * renderer restarts or the page navigates to another process, the source hooks into the new one.
+ * The source instance keeps rendering while it is hidden itself (see Widget::KeepsMapped). Mirrors show
+ * the last captured frame whenever the source doesn't render, e.g. while its renderer restarts.
+ */
+class MirrorSource : public QObject {
+    Q_OBJECT
+    QPointer<QWebEngineView> m_View;
+    QPointer<QQuickWidget> m_Delegate;
+    uint8_t m_MonitorId;
+    uint8_t m_LastInputMonitorId;
+    std::vector<QPointer<MirrorView>> m_Mirrors;
+    QTimer m_HookTimer;
+    QElapsedTimer m_SinceCapture;
+    int m_MinCaptureIntervalMs = 0;
+    bool m_CapturePending = false;
+    bool m_Forwarding = false;
+
+   public:
+    MirrorSource(QWebEngineView* view, const uint8_t monitorId)
+        : QObject(view), m_View(view), m_MonitorId(monitorId), m_LastInputMonitorId(monitorId) {
+        m_HookTimer.setInterval(33);
+        connect(&m_HookTimer, &QTimer::timeout, this, [this]() { Hook(); });
+        connect(view, &QWebEngineView::loadStarted, this, [this]() { Unhook(); });
+        connect(view, &QWebEngineView::renderProcessTerminated, this, [this]() { Unhook(); });
+        m_HookTimer.start();
+    }
+
+    void AddMirror(MirrorView* mirror) { m_Mirrors.emplace_back(mirror); }
+
+    /**
+     * Caps how often frames are captured for the mirrors, 0 means every swapped frame.
+     */
+    void SetMaxFps(const int maxFps) { m_MinCaptureIntervalMs = maxFps > 0 ? 1000 / maxFps : 0; }
+
+    /**
+     * Forwards an input event from a mirror to the page, with its coordinates mapped to the view.
+     */
+    bool Forward(QEvent* event, const uint8_t monitorId, const QSize& mirrorSize) {
+        QWidget* target = m_Delegate ? static_cast<QWidget*>(m_Delegate) : m_View ? m_View->focusProxy() : nullptr;
+        if (!target) {
+            return false;
+        }
+
+        const double scaleX = mirrorSize.width() > 0 ? static_cast<double>(target->width()) / mirrorSize.width() : 1;
+        const double scaleY = mirrorSize.height() > 0 ? static_cast<double>(target->height()) / mirrorSize.height() : 1;
+        const auto map = [&](const QPointF& pos) { return QPointF(pos.x() * scaleX, pos.y() * scaleY); };
+
+        m_Forwarding = true;
+        switch (event->type()) {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::MouseMove: {
+            const auto* mouse = static_cast<QMouseEvent*>(event);
+            if (event->type() == QEvent::MouseButtonPress) {
+                TagInput(monitorId);
+            }
+            const QPointF pos = map(mouse->position());
+            QMouseEvent forwarded(mouse->type(), pos, pos, target->mapToGlobal(pos), mouse->button(), mouse->buttons(),
+                                  mouse->modifiers(), mouse->pointingDevice());
+            QCoreApplication::sendEvent(target, &forwarded);
+            break;
+        }
+        case QEvent::Wheel: {
+            const auto* wheel = static_cast<QWheelEvent*>(event);
+            const QPointF pos = map(wheel->position());
+            QWheelEvent forwarded(pos, target->mapToGlobal(pos), wheel->pixelDelta(), wheel->angleDelta(), wheel->buttons(),
+                                  wheel->modifiers(), wheel->phase(), wheel->inverted(), wheel->source(),
+                                  wheel->pointingDevice());
+            QCoreApplication::sendEvent(target, &forwarded);
+            break;
+        }
+        case QEvent::KeyPress:
+        case QEvent::KeyRelease:
+            TagInput(monitorId);
+            QCoreApplication::sendEvent(target, event);
+            break;
+        case QEvent::Leave:
+            QCoreApplication::sendEvent(target, event);
+            break;
+        default:
+            m_Forwarding = false;
+            return false;
+        }
+        m_Forwarding = false;
+        return true;
+    }
+
+   protected:
+    bool eventFilter(QObject*, QEvent* event) override {
+        // Input that reaches the page directly comes from the monitor it renders on.
+        if (!m_Forwarding && (event->type() == QEvent::MouseButtonPress || event->type() == QEvent::KeyPress)) {
+            TagInput(m_MonitorId);
+        }
+        return false;
+    }
+
+   private:
+    void Hook() {
+        if (!m_View) {
+            return;
+        }
+        if (auto* delegate = qobject_cast<QQuickWidget*>(m_View->focusProxy())) {
+            m_Delegate = delegate;
+            connect(delegate, &QQuickWidget::frameSwapped, this, [this]() { ScheduleCapture(); });
+            connect(delegate, &QObject::destroyed, this, [this]() { Unhook(); });
+            delegate->installEventFilter(this);
+            m_HookTimer.stop();
+            WSS_DEBUG("Mirror source on monitor ID {} hooked into the render delegate.", m_MonitorId);
+        }
+        ScheduleCapture();
+    }
+
+    /**
+     * Drops the current render delegate and looks for its replacement.
+     */
+    void Unhook() {
+        if (m_Delegate) {
+            disconnect(m_Delegate, nullptr, this, nullptr);
+            m_Delegate->removeEventFilter(this);
+            m_Delegate = nullptr;
+        }
+        if (!m_HookTimer.isActive()) {
+            m_HookTimer.start();
+        }
+    }
+
+    void ScheduleCapture() {
+        if (m_CapturePending) {
+            return;
+        }
+        m_CapturePending = true;
+        const qint64 sinceCapture = m_SinceCapture.isValid() ? m_SinceCapture.elapsed() : m_MinCaptureIntervalMs;
+        const int delay = static_cast<int>(std::max<qint64>(m_MinCaptureIntervalMs - sinceCapture, 0));
+        QTimer::singleShot(delay, this, [this]() {
+            m_CapturePending = false;
+            Capture();
+        });
+    }
+
+    void Capture() {
+        std::erase_if(m_Mirrors, [](const QPointer<MirrorView>& mirror) { return mirror.isNull(); });
+        // Hidden keep-mapped mirrors are still mapped, at zero opacity.
+        const auto shown = [](const QPointer<MirrorView>& mirror) {
+            return mirror->isVisible() && mirror->window()->windowOpacity() > 0;
+        };
+        if (!m_View || std::ranges::none_of(m_Mirrors, shown)) {
+            return;
+        }
+        m_SinceCapture.start();
+
+        const QImage frame = m_Delegate ? m_Delegate->grabFramebuffer() : m_View->grab().toImage();
+        for (const auto& mirror : m_Mirrors) {
+            mirror->SetFrame(frame);
+        }
+    }
+
+    /**
+     * Tells the page which monitor the following input comes from (window.__wssInputMonitorId and a
+     * `wss:input-monitor` event). Only sent when it changes.
+     */
+    void TagInput(const uint8_t monitorId) {
+        if (monitorId == m_LastInputMonitorId || !m_View) {
+            return;
+        }
+        m_LastInputMonitorId = monitorId;
+        m_View->page()->runJavaScript(
+            QString("window.__wssInputMonitorId = %1;"
+                    "window.dispatchEvent(new CustomEvent('wss:input-monitor', { detail: { monitorId: %1 } }));")
+                .arg(monitorId));
+    }
+};
+
+bool MirrorView::event(QEvent* event) {
+    if (m_Source && m_Source->Forward(event, m_MonitorId, size())) {
+        return true;
+    }
+    return QWidget::event(event);
+}
+
 void WSS::Widget::Create(Shell& shell) {
-    const size_t monitors = m_Info.Monitors.size();
+    for (const uint8_t monitorId : shell.GetMonitors().Resolve(m_Info.MonitorSelectors)) {
+        CreateInstance(shell, monitorId);
+    }
+
+    if (m_Windows.empty()) {
+        WSS_WARN("None of the monitors configured for widget '{}' are connected.", m_Info.Name);
+    }
+}
+
+void WSS::Widget::SyncMonitors(Shell& shell) {
+    const auto monitorIds = shell.GetMonitors().Resolve(m_Info.MonitorSelectors);
+
+    std::vector<uint8_t> stale;
+    for (const auto& [monitorId, window] : m_Windows) {
+        if (std::ranges::find(monitorIds, monitorId) == monitorIds.end()) {
+            stale.push_back(monitorId);
+        }
+    }
+    for (const uint8_t monitorId : stale) {
+        DestroyInstance(monitorId);
+    }
+
+    // Mirrors can't outlive the instance they show, a new one takes over rendering below.
+    if (m_Info.Mirror && !m_MirrorSourceId) {
+        std::vector<uint8_t> mirrors;
+        for (const auto& [monitorId, mirror] : m_Mirrors) {
+            mirrors.push_back(monitorId);
+        }
+        for (const uint8_t monitorId : mirrors) {
+            DestroyInstance(monitorId);
+        }
+    }
+
+    for (const uint8_t monitorId : monitorIds) {
+        if (!m_Windows.contains(monitorId)) {
+            CreateInstance(shell, monitorId);
+        }
+    }
+}
+
+WSS::WidgetMonitorInfo WSS::Widget::ComputeMonitorInfo(const uint8_t monitorId) const {
+    return EvaluateMonitorInfo(m_Info, monitorId);
+}
+
+WSS::WidgetMonitorInfo WSS::Widget::EvaluateMonitorInfo(const WidgetInfo& info, const uint8_t monitorId) {
+    using Type = DimensionParser::DimensionType;
+    const auto& dimensions = info.Dimensions;
+
+    const auto evaluate = [monitorId](const std::vector<WidgetClickRegionSpec>& specs) {
+        std::unordered_map<std::string, WidgetClickRegionInfo> regionMap;
+        for (const auto& region : specs) {
+            regionMap[region.Name] = {.X = DimensionParser::Parse(Type::WIDTH, region.X, monitorId),
+                                      .Y = DimensionParser::Parse(Type::HEIGHT, region.Y, monitorId),
+                                      .Width = DimensionParser::Parse(Type::WIDTH, region.Width, monitorId),
+                                      .Height = DimensionParser::Parse(Type::HEIGHT, region.Height, monitorId)};
+        }
+        return regionMap;
+    };
+
+    return {.MonitorId = monitorId,
+            .Width = DimensionParser::Parse(Type::WIDTH, dimensions.Width, monitorId),
+            .Height = DimensionParser::Parse(Type::HEIGHT, dimensions.Height, monitorId),
+            .MarginTop = DimensionParser::Parse(Type::HEIGHT, dimensions.MarginTop, monitorId),
+            .MarginBottom = DimensionParser::Parse(Type::HEIGHT, dimensions.MarginBottom, monitorId),
+            .MarginLeft = DimensionParser::Parse(Type::WIDTH, dimensions.MarginLeft, monitorId),
+            .MarginRight = DimensionParser::Parse(Type::WIDTH, dimensions.MarginRight, monitorId),
+            .ClickRegionMap = evaluate(info.ClickRegions),
+            .OpaqueRegionMap = evaluate(info.OpaqueRegions)};
+}
+
+bool WSS::Widget::ValidateDimensions(const WidgetInfo& info, const std::vector<uint8_t>& monitorIds) {
+    try {
+        for (const uint8_t monitorId : monitorIds) {
+            EvaluateMonitorInfo(info, monitorId);
+        }
+    } catch (const std::exception& e) {
+        WSS_ERROR("Invalid dimensions for widget '{}': {}", info.Name, e.what());
+        return false;
+    }
+    return true;
+}
+
+void WSS::Widget::ApplyClickRegions(const uint8_t monitorId) const {
+    auto* window = GetWindow(monitorId);
+    if (!window) {
+        return;
+    }
+
+    // Since Qt mask doesn't really work with empty regions, we start with a 1x1 region as a workaround.
+    QRegion inputRegion(0, 0, 1, 1);
+    for (const auto& [name, info] : GetMonitorInfo(monitorId).ClickRegionMap) {
+        if (info.X == 0 && info.Y == 0 && info.Width == 0 && info.Height == 0) {
+            continue;
+        }
+
+        const int padding = info._QT_padding > 0 ? info._QT_padding : 0;
+        const QRect rect(info.X - padding, info.Y - padding, info.Width + 2 * padding, info.Height + 2 * padding);
+        inputRegion += rect;
+    }
+
+    window->setMask(inputRegion);
+    window->update();
+}
+
+void WSS::Widget::ApplyOpaqueRegions(const uint8_t monitorId) const {
+    auto* window = GetWindow(monitorId);
+    if (!window || !window->windowHandle()) {
+        return;
+    }
+    const auto& monitorInfo = GetMonitorInfo(monitorId);
+    if (m_Info.OpaqueRegions.empty() && monitorInfo.OpaqueRegionMap.empty()) {
+        return;
+    }
+
+    // Qt has no API for this, so it goes straight to the surface. Hidden (keep-mapped) windows must not
+    // claim to be opaque, they're fully transparent.
+    QRegion opaqueRegion;
+    if (IsShown(monitorId)) {
+        const QRect bounds(0, 0, window->width(), window->height());
+        for (const auto& [name, info] : monitorInfo.OpaqueRegionMap) {
+            opaqueRegion += QRect(info.X, info.Y, info.Width, info.Height).intersected(bounds);
+        }
+    }
+    if (!SetSurfaceOpaqueRegion(window->windowHandle(), opaqueRegion)) {
+        WSS_DEBUG("Surface of widget '{}' on monitor ID: {} isn't created yet, opaque region deferred.", m_Info.Name,
+                  monitorId);
+        return;
+    }
+    window->update();
+}
+
+void WSS::Widget::UpdateGeometry(const uint8_t monitorId) {
+    auto* window = GetWindow(monitorId);
+    const auto it = std::ranges::find_if(m_Info.Monitors,
+                                         [monitorId](const WidgetMonitorInfo& info) { return info.MonitorId == monitorId; });
+    if (!window || it == m_Info.Monitors.end()) {
+        return;
+    }
+
+    // Called from screen signals, a monitor whose size breaks an expression keeps the previous geometry.
+    WidgetMonitorInfo monitorInfo;
+    try {
+        monitorInfo = ComputeMonitorInfo(monitorId);
+    } catch (const std::exception& e) {
+        WSS_ERROR("Invalid dimensions for widget '{}' on monitor ID {}: {}", m_Info.Name, monitorId, e.what());
+        return;
+    }
+    // Keep the click and opaque regions pages have registered at runtime.
+    for (const auto& [regionName, regionInfo] : it->ClickRegionMap) {
+        monitorInfo.ClickRegionMap.try_emplace(regionName, regionInfo);
+    }
+    for (const auto& [regionName, regionInfo] : it->OpaqueRegionMap) {
+        monitorInfo.OpaqueRegionMap.try_emplace(regionName, regionInfo);
+    }
+    *it = std::move(monitorInfo);
+
+    window->resize(it->Width, it->Height);
+    if (auto* lsh = LayerShellQt::Window::get(window->windowHandle())) {
+        lsh->setMargins(QMargins(it->MarginLeft, it->MarginTop, it->MarginRight, it->MarginBottom));
+    }
+    ApplyClickRegions(monitorId);
+    ApplyOpaqueRegions(monitorId);
+
+    WSS_DEBUG("Updated geometry of widget '{}' on monitor ID: {} to {}x{}", m_Info.Name, monitorId, it->Width, it->Height);
+}
 
-    for (int i = 0; i < monitors; ++i) {
-        auto monitorInfo = m_Info.Monitors[i];
+LayerShellQt::Window::Anchors WSS::Widget::GetLayerAnchors() const {
+    LayerShellQt::Window::Anchors anchors;
+    anchors.setFlag(LayerShellQt::Window::AnchorTop, IsAnchoredTo(WidgetAnchor::TOP));
+    anchors.setFlag(LayerShellQt::Window::AnchorBottom, IsAnchoredTo(WidgetAnchor::BOTTOM));
+    anchors.setFlag(LayerShellQt::Window::AnchorLeft, IsAnchoredTo(WidgetAnchor::LEFT));
+    anchors.setFlag(LayerShellQt::Window::AnchorRight, IsAnchoredTo(WidgetAnchor::RIGHT));
+    return anchors;
+}
+
+QRect WSS::Widget::GetInstanceGeometry(const uint8_t monitorId) const {
+    const auto& info = GetMonitorInfo(monitorId);
+    const QScreen* screen = MonitorRegistry::GetScreen(monitorId);
+    const QSize screenSize = screen ? screen->geometry().size() : QSize(info.Width, info.Height);
+
+    const bool left = IsAnchoredTo(WidgetAnchor::LEFT);
+    const bool right = IsAnchoredTo(WidgetAnchor::RIGHT);
+    const bool top = IsAnchoredTo(WidgetAnchor::TOP);
+    const bool bottom = IsAnchoredTo(WidgetAnchor::BOTTOM);
 
-        QString name = QString("wss.widget.%1.%2").arg(QString::fromStdString(m_Info.Name)).arg(monitorInfo.MonitorId);
+    // Anchored to both opposite edges means the surface is stretched between them.
+    const int width = left && right ? screenSize.width() - info.MarginLeft - info.MarginRight : info.Width;
+    const int height = top && bottom ? screenSize.height() - info.MarginTop - info.MarginBottom : info.Height;
+
+    const int x = left    ? info.MarginLeft
+                  : right ? screenSize.width() - info.MarginRight - width
+                          : (screenSize.width() - width) / 2;
+    const int y = top      ? info.MarginTop
+                  : bottom ? screenSize.height() - info.MarginBottom - height
+                           : (screenSize.height() - height) / 2;
+    return {x, y, width, height};
+}
 
-        auto* window = new QWidget;
-        window->setWindowTitle(name);
-        window->setObjectName(name);
-        window->setWindowFlag(Qt::FramelessWindowHint);
-        window->setWindowFlag(Qt::WindowStaysOnTopHint);
-        window->setAttribute(Qt::WA_TranslucentBackground);
-        window->setAttribute(Qt::WA_TransparentForMouseEvents, true);
-        window->setScreen(QGuiApplication::screens().at(monitorInfo.MonitorId));
+bool WSS::Widget::IsShown(const uint8_t monitorId) const {
+    auto* window = GetWindow(monitorId);
+    if (!window || !window->isVisible()) {
+        return false;
+    }
+    // Windows that stay mapped while hidden don't take input instead.
+    return !window->windowHandle()->flags().testFlag(Qt::WindowTransparentForInput);
+}
+
+bool WSS::Widget::KeepsMapped(const uint8_t monitorId) const {
+    return m_Info.ShowMode == WidgetShowMode::KEEP_MAPPED || (m_MirrorSourceId == monitorId && !m_Mirrors.empty());
+}
+
+void WSS::Widget::ApplyVisibility(const uint8_t monitorId, const bool visible) const {
+    auto* window = GetWindow(monitorId);
+    if (!window) {
+        return;
+    }
+
+    // Frozen pages have to be woken up before they're shown, and can only be frozen once hidden.
+    auto* page = GetWebView(monitorId) ? GetWebView(monitorId)->page() : nullptr;
+    if (page && visible && page->lifecycleState() != QWebEnginePage::LifecycleState::Active) {
+        page->setLifecycleState(QWebEnginePage::LifecycleState::Active);
+    }
+
+    if (KeepsMapped(monitorId)) {
+        // Keep the layer surface alive, so showing doesn't wait for the compositor to configure it again.
+        // Hidden means no input (empty input region), no keyboard focus and zero opacity. The content
+        // stays visible: a hidden view would make Chromium treat the page as hidden and drop its
+        // frames, and the first frame after showing would have to be rendered from scratch.
         window->show();
-        window->hide();
+        window->windowHandle()->setFlag(Qt::WindowTransparentForInput, !visible);
+        window->setWindowOpacity(visible ? 1.0 : 0.0);
+        if (auto* lsh = LayerShellQt::Window::get(window->windowHandle())) {
+            const auto it = m_KeyboardInteractive.find(monitorId);
+            const bool interactive = visible && it != m_KeyboardInteractive.end() && it->second;
+            lsh->setKeyboardInteractivity(interactive ? LayerShellQt::Window::KeyboardInteractivityOnDemand
+                                                      : LayerShellQt::Window::KeyboardInteractivityNone);
+        }
+    } else {
+        window->setVisible(visible);
+        if (visible) {
+            // In case it was kept mapped as a mirror source before its mirrors went away.
+            window->windowHandle()->setFlag(Qt::WindowTransparentForInput, false);
+            window->setWindowOpacity(1.0);
+        }
+    }
+
+    // If the window is hidden then there's no need for exclusivity.
+    // TODO: Determine if that's ever something a user would wish to omit.
+    if (m_Info.Exclusivity) {
+        SetExclusivity(monitorId, visible, m_Info.ExclusivityZone);
+    }
+
+    // Remapped surfaces are new surfaces, and keep-mapped ones lose their opaque region while hidden.
+    ApplyOpaqueRegions(monitorId);
+
+    // The page of a mirrored widget keeps rendering for the mirrors.
+    if (page && !visible && m_Info.Render.FreezeWhenHidden && m_Mirrors.empty()) {
+        page->setLifecycleState(QWebEnginePage::LifecycleState::Frozen);
+    }
+
+    if (m_VisibilityListener) {
+        m_VisibilityListener(monitorId, visible);
+    }
+}
 
-        window->clearFocus();
-        auto* webview = new NoContextMenuWebEngineView(window);
+void WSS::Widget::ApplyRenderPolicy(const uint8_t monitorId) const {
+    auto* view = GetWebView(monitorId);
+    if (!view) {
+        return;
+    }
+
+    const QScreen* screen = MonitorRegistry::GetScreen(monitorId);
+    const int refreshRate = screen ? qRound(screen->refreshRate()) : 60;
+    int maxFps = m_Info.Render.MaxFps;
+    if (m_Info.Render.FollowRefreshRate && (maxFps == 0 || maxFps > refreshRate)) {
+        maxFps = refreshRate;
+    }
+
+    // Mirrors don't need frames faster than the source renders them.
+    if (auto* mirrorSource = view->findChild<MirrorSource*>()) {
+        mirrorSource->SetMaxFps(maxFps);
+    }
+
+    const QString source = QString(RenderPolicyScript).arg(maxFps);
+    QWebEngineScriptCollection& scripts = view->page()->scripts();
+    for (const auto& script : scripts.find("wss-render-policy")) {
+        scripts.remove(script);
+    }
+    QWebEngineScript script;
+    script.setName("wss-render-policy");
+    script.setSourceCode(source);
+    script.setInjectionPoint(QWebEngineScript::DocumentCreation);
+    script.setWorldId(QWebEngineScript::MainWorld);
+    script.setRunsOnSubFrames(false);
+    scripts.insert(script);
+
+    // The script only runs on the next load, pooled pages and policy changes need it right away.
+    view->page()->runJavaScript(source);
+
+    if (!m_Info.Render.FreezeWhenHidden && view->page()->lifecycleState() == QWebEnginePage::LifecycleState::Frozen) {
+        view->page()->setLifecycleState(QWebEnginePage::LifecycleState::Active);
+    }
+
+    WSS_DEBUG("Render policy of widget '{}' on monitor ID: {}: max {} fps, freeze when hidden: {}", m_Info.Name, monitorId,
+              maxFps, m_Info.Render.FreezeWhenHidden);
+}
 
-        // Load the URL
-        QString uri = QString("http://localhost:%1").arg(shell.GetSettings().m_FrontendPort);
-        if (!m_Info.Route.empty()) {
-            uri += QString::fromStdString(m_Info.Route);
+void WSS::Widget::MeasureShowLatency(const uint8_t monitorId, std::function<void(double)> callback) const {
+    const auto start = std::chrono::steady_clock::now();
+    DispatchToMainThread([=, this, self = weak_from_this()]() {
+        if (self.expired() || !GetWindow(monitorId)) {
+            callback(-1);
+            return;
         }
 
-        QUrl url(uri);
+        auto* window = GetWindow(monitorId);
+        new FirstFrameProbe(window->windowHandle(), start, callback);
+        ApplyVisibility(monitorId, true);
+        window->windowHandle()->requestUpdate();
+    });
+}
+
+bool WSS::Widget::ApplyVisibilityOp(const uint8_t monitorId, const VisibilityOp op,
+                                    std::function<void(double)> presented) const {
+    auto* window = GetWindow(monitorId);
+    if (!window) {
+        return false;
+    }
+
+    const bool visible = op == VisibilityOp::TOGGLE ? !IsShown(monitorId) : op == VisibilityOp::SHOW;
+    if (presented && visible) {
+        new FirstFrameProbe(window->windowHandle(), std::chrono::steady_clock::now(), std::move(presented));
+    }
+    ApplyVisibility(monitorId, visible);
+    if (presented && !visible) {
+        presented(0);
+    } else if (presented) {
+        window->windowHandle()->requestUpdate();
+    }
+    return true;
+}
+
+void WSS::Widget::Reconfigure(const WidgetInfo& info) {
+    // Drop the click regions of the old configuration, so removed regions don't stick around as runtime ones.
+    for (auto& monitorInfo : m_Info.Monitors) {
+        for (const auto& region : m_Info.ClickRegions) {
+            monitorInfo.ClickRegionMap.erase(region.Name);
+        }
+        for (const auto& region : m_Info.OpaqueRegions) {
+            monitorInfo.OpaqueRegionMap.erase(region.Name);
+        }
+    }
+
+    m_Info.Dimensions = info.Dimensions;
+    m_Info.ClickRegions = info.ClickRegions;
+    m_Info.OpaqueRegions = info.OpaqueRegions;
+    m_Info.Layer = info.Layer;
+    m_Info.AnchorBitmask = info.AnchorBitmask;
+    m_Info.ExclusivityZone = info.ExclusivityZone;
+    m_Info.Exclusivity = info.Exclusivity;
+    m_Info.DefaultHidden = info.DefaultHidden;
+    m_Info.Render = info.Render;
+    m_Info.MaxRssMb = info.MaxRssMb;
+    m_Info._QT_padding = info._QT_padding;
+
+    for (const auto& [monitorId, window] : m_Windows) {
+        if (auto* lsh = LayerShellQt::Window::get(window->windowHandle())) {
+            lsh->setLayer(static_cast<LayerShellQt::Window::Layer>(m_Info.Layer));
+            lsh->setAnchors(GetLayerAnchors());
+            if (IsShown(monitorId)) {
+                lsh->setExclusiveZone(m_Info.Exclusivity ? m_Info.ExclusivityZone : 0);
+            }
+        }
+        UpdateGeometry(monitorId);
+        ApplyRenderPolicy(monitorId);
+    }
+
+    WSS_DEBUG("Reconfigured widget '{}' in place.", m_Info.Name);
+}
+
+bool WSS::Widget::MergeDimensions(const WidgetDimensions& dimensions) {
+    using Type = DimensionParser::DimensionType;
+    WidgetDimensions merged = m_Info.Dimensions;
+    const auto merge = [](std::string& target, const std::string& value) {
+        if (!value.empty()) {
+            target = value;
+        }
+    };
+    merge(merged.Width, dimensions.Width);
+    merge(merged.Height, dimensions.Height);
+    merge(merged.MarginTop, dimensions.MarginTop);
+    merge(merged.MarginBottom, dimensions.MarginBottom);
+    merge(merged.MarginLeft, dimensions.MarginLeft);
+    merge(merged.MarginRight, dimensions.MarginRight);
+
+    // Evaluate everything up front, a bad expression must not leave the widget half resized.
+    try {
+        for (const auto& [monitorId, window] : m_Windows) {
+            DimensionParser::Parse(Type::WIDTH, merged.Width, monitorId);
+            DimensionParser::Parse(Type::HEIGHT, merged.Height, monitorId);
+            DimensionParser::Parse(Type::HEIGHT, merged.MarginTop, monitorId);
+            DimensionParser::Parse(Type::HEIGHT, merged.MarginBottom, monitorId);
+            DimensionParser::Parse(Type::WIDTH, merged.MarginLeft, monitorId);
+            DimensionParser::Parse(Type::WIDTH, merged.MarginRight, monitorId);
+        }
+    } catch (const std::exception& e) {
+        WSS_ERROR("Invalid dimensions for widget '{}': {}", m_Info.Name, e.what());
+        return false;
+    }
+
+    m_Info.Dimensions = std::move(merged);
+    ScheduleGeometryFlush();
+    return true;
+}
+
+void WSS::Widget::ScheduleGeometryFlush() {
+    if (m_GeometryFlushPending) {
+        return;
+    }
+    m_GeometryFlushPending = true;
+
+    // Wait for one frame of the fastest monitor the widget is on.
+    qreal refreshRate = 60;
+    for (const auto& [monitorId, window] : m_Windows) {
+        if (const QScreen* screen = MonitorRegistry::GetScreen(monitorId)) {
+            refreshRate = std::max(refreshRate, screen->refreshRate());
+        }
+    }
+
+    QTimer::singleShot(std::max(1, qRound(1000.0 / refreshRate)), qApp, [this, self = weak_from_this()]() {
+        if (self.expired()) {
+            return;
+        }
+        m_GeometryFlushPending = false;
+
+        for (const auto& [monitorId, window] : m_Windows) {
+            UpdateGeometry(monitorId);
+            if (auto* lsh = LayerShellQt::Window::get(window->windowHandle()); lsh && IsShown(monitorId)) {
+                lsh->setExclusiveZone(m_Info.Exclusivity ? m_Info.ExclusivityZone : 0);
+            }
+        }
+    });
+}
+
+void WSS::Widget::SetSize(const std::string& width, const std::string& height) {
+    DispatchToMainThread([=, this, self = weak_from_this()]() {
+        if (self.expired()) {
+            return;
+        }
+        WidgetDimensions dimensions{.Width = width, .Height = height, .MarginTop = "", .MarginBottom = "",
+                                    .MarginLeft = "", .MarginRight = ""};
+        MergeDimensions(dimensions);
+    });
+}
+
+void WSS::Widget::SetMargins(const std::string& top, const std::string& bottom, const std::string& left,
+                             const std::string& right) {
+    DispatchToMainThread([=, this, self = weak_from_this()]() {
+        if (self.expired()) {
+            return;
+        }
+        WidgetDimensions dimensions{.Width = "", .Height = "", .MarginTop = top, .MarginBottom = bottom,
+                                    .MarginLeft = left, .MarginRight = right};
+        MergeDimensions(dimensions);
+    });
+}
+
+void WSS::Widget::SetExclusiveZone(const int zone) {
+    DispatchToMainThread([=, this, self = weak_from_this()]() {
+        if (self.expired()) {
+            return;
+        }
+        m_Info.ExclusivityZone = zone;
+        m_Info.Exclusivity = zone != 0;
+        ScheduleGeometryFlush();
+    });
+}
+
+void WSS::Widget::DestroyInstance(const uint8_t monitorId) {
+    if (auto* window = GetWindow(monitorId)) {
+        window->hide();
+        window->deleteLater();
+    }
+
+    m_Windows.erase(monitorId);
+    m_Views.erase(monitorId);
+    m_Mirrors.erase(monitorId);
+    if (m_MirrorSourceId == monitorId) {
+        m_MirrorSourceId.reset();
+    }
+    std::erase_if(m_Info.Monitors, [monitorId](const WidgetMonitorInfo& info) { return info.MonitorId == monitorId; });
+
+    WSS_DEBUG("Destroyed widget '{}' on monitor ID: {}", m_Info.Name, monitorId);
+}
+
+WSS::WebView* WSS::Widget::CreateWebView(Shell& shell, Window* window, const uint8_t monitorId) {
+    auto* webview = new NoContextMenuWebEngineView(window);
+
+    // Load the URL, or take a page that is already loading: the one a popup's parent page opened for it,
+    // or one from the pool if there is one for this route.
+    if (QWebEnginePage* page = shell.TakePopupPage(m_Info.Name)) {
+        page->setParent(webview);
+        webview->setPage(page);
+    } else if (QWebEnginePage* page = shell.GetViewPool().Acquire(m_Info.Route, m_Info.Name, monitorId)) {
+        page->setParent(webview);
+        webview->setPage(page);
+    } else {
+        webview->setPage(new QWebEnginePage(shell.GetProfile(), webview));
+        QUrl url = shell.GetFrontendUrl(m_Info.Route);
         QUrlQuery query;
         query.addQueryItem("widgetName", QString::fromStdString(m_Info.Name));
-        query.addQueryItem("monitorId", QString::number(monitorInfo.MonitorId));
+        query.addQueryItem("monitorId", QString::number(monitorId));
         url.setQuery(query);
 
         WSS_DEBUG("Loading URI: {}", url.toString().toStdString());
@@ -62,84 +926,180 @@ void WSS::Widget::Create(Shell& shell) {
         } else {
             webview->load(QUrl("chrome://gpu"));
         }
+    }
 
-        // Web engine settings
-        QWebEngineSettings* settings = webview->settings();
-        settings->setAttribute(QWebEngineSettings::JavascriptEnabled, true);
-        settings->setAttribute(QWebEngineSettings::WebGLEnabled, true);
-        settings->setAttribute(QWebEngineSettings::Accelerated2dCanvasEnabled, true);
+    // Web engine settings
+    QWebEngineSettings* settings = webview->settings();
+    settings->setAttribute(QWebEngineSettings::JavascriptEnabled, true);
+    settings->setAttribute(QWebEngineSettings::WebGLEnabled, true);
+    settings->setAttribute(QWebEngineSettings::Accelerated2dCanvasEnabled, true);
+    // Popups are opened through their parent page, without a user gesture (see Shell::OpenPopup).
+    // Pages of widgets that don't declare popups can't open windows at all.
+    settings->setAttribute(QWebEngineSettings::JavascriptCanOpenWindows, m_Info.Popups);
 
-        // Transparent background support
-        if (m_Info.Route != "_DEBUG") {
-            webview->setAttribute(Qt::WA_TranslucentBackground);
-            webview->setStyleSheet("background: transparent");
-            webview->page()->setBackgroundColor(Qt::transparent);
-        }
+    // Transparent background support
+    if (m_Info.Route != "_DEBUG") {
+        webview->setAttribute(Qt::WA_TranslucentBackground);
+        webview->setStyleSheet("background: transparent");
+        webview->page()->setBackgroundColor(Qt::transparent);
+    }
 
-        // webview->setAttribute(Qt::WA_TransparentForMouseEvents, true);
+    // webview->setAttribute(Qt::WA_TransparentForMouseEvents, true);
 
-        // Move window to monitor
-        const auto screens = QGuiApplication::screens();
-        if (monitorInfo.MonitorId < screens.size()) {
-            const QRect geometry = screens[monitorInfo.MonitorId]->geometry();
+    new RendererRecovery(webview, m_Info.Name);
 
-            int x = geometry.x() + monitorInfo.MarginLeft;
-            int y = geometry.y() + monitorInfo.MarginTop;
-            window->move(x, y);
+    if (m_Info.Mirror) {
+        new MirrorSource(webview, monitorId);
+        m_MirrorSourceId = monitorId;
+    }
+    return webview;
+}
+
+/**
+ * Expands a leading ~ to the home directory.
+ */
+static QString ExpandPath(const std::string& path) {
+    if (path.starts_with("~/")) {
+        if (const char* home = std::getenv("HOME")) {
+            return QString::fromStdString(std::string(home) + path.substr(1));
         }
+    }
+    return QString::fromStdString(path);
+}
 
-        window->setLayout(new QVBoxLayout);
-        window->layout()->setContentsMargins(0, 0, 0, 0);
-        window->layout()->addWidget(webview);
-        window->resize(monitorInfo.Width, monitorInfo.Height);
-        window->setContentsMargins(0, 0, 0, 0);
+QWidget* WSS::Widget::CreateNativeView(Window* window) const {
+    const QString source = ExpandPath(m_Info.Source);
 
-        QWindow* lwin = window->windowHandle();
-        if (LayerShellQt::Window* lsh = LayerShellQt::Window::get(lwin)) {
-            lsh->setScope("wss.shell");
-            lsh->setLayer(static_cast<LayerShellQt::Window::Layer>(m_Info.Layer));
-            lsh->setScreenConfiguration(LayerShellQt::Window::ScreenFromQWindow);
-
-            lsh->setMargins(
-                QMargins(monitorInfo.MarginLeft, monitorInfo.MarginTop, monitorInfo.MarginRight, monitorInfo.MarginBottom));
-            LayerShellQt::Window::Anchors anchors;
-            anchors.setFlag(LayerShellQt::Window::AnchorTop, IsAnchoredTo(WidgetAnchor::TOP));
-            anchors.setFlag(LayerShellQt::Window::AnchorBottom, IsAnchoredTo(WidgetAnchor::BOTTOM));
-            anchors.setFlag(LayerShellQt::Window::AnchorLeft, IsAnchoredTo(WidgetAnchor::LEFT));
-            anchors.setFlag(LayerShellQt::Window::AnchorRight, IsAnchoredTo(WidgetAnchor::RIGHT));
-            lsh->setAnchors(anchors);
-            lsh->setKeyboardInteractivity(LayerShellQt::Window::KeyboardInteractivityNone);
-
-            if (m_Info.DefaultHidden) {
-                window->hide();
-            } else {
-                window->show();
-                if (m_Info.Exclusivity) {
-                    lsh->setExclusiveZone(m_Info.ExclusivityZone);
-                }
-            }
+    switch (m_Info.Kind) {
+    case WidgetKind::IMAGE: {
+        QImageReader reader(source);
+        reader.setAutoTransform(true);
+        QImage image = reader.read();
+        if (image.isNull()) {
+            WSS_ERROR("Failed to load image '{}' for widget '{}': {}", m_Info.Source, m_Info.Name,
+                      reader.errorString().toStdString());
         }
-
-        QRegion inputRegion;
-        if (monitorInfo.ClickRegionMap.empty()) {
-            // Since Qt mask doesn't really work with empty regions, we create a 1x1 region as a workaround.
-            inputRegion = QRegion(0, 0, 1, 1);
-        } else {
-            for (const auto& [regionName, regionInfo] : monitorInfo.ClickRegionMap) {
-                if (regionInfo.X == 0 && regionInfo.Y == 0 && regionInfo.Width == 0 && regionInfo.Height == 0) {
-                    continue;
-                }
-                const QRect rect(regionInfo.X, regionInfo.Y, regionInfo.Width, regionInfo.Height);
-                inputRegion += rect;
-            }
+        return new ImageView(std::move(image), window);
+    }
+    case WidgetKind::VIDEO: {
+        auto* video = new QVideoWidget(window);
+        video->setAspectRatioMode(Qt::KeepAspectRatioByExpanding);
+        auto* player = new QMediaPlayer(video);
+        auto* audio = new QAudioOutput(player);
+        audio->setMuted(true);
+        player->setAudioOutput(audio);
+        player->setVideoOutput(video);
+        player->setLoops(QMediaPlayer::Infinite);
+        player->setSource(QUrl::fromLocalFile(source));
+        QObject::connect(player, &QMediaPlayer::errorOccurred, player, [name = m_Info.Name](QMediaPlayer::Error, const QString& error) {
+            WSS_ERROR("Failed to play video for widget '{}': {}", name, error.toStdString());
+        });
+        player->play();
+        return video;
+    }
+    case WidgetKind::QML: {
+        auto* quick = new QQuickWidget(window);
+        quick->setAttribute(Qt::WA_AlwaysStackOnTop);
+        quick->setClearColor(Qt::transparent);
+        quick->setResizeMode(QQuickWidget::SizeRootObjectToView);
+        quick->setSource(QUrl::fromLocalFile(source));
+        for (const auto& error : quick->errors()) {
+            WSS_ERROR("QML error in widget '{}': {}", m_Info.Name, error.toString().toStdString());
         }
-        window->setMask(inputRegion);
-        window->update();
+        return quick;
+    }
+    case WidgetKind::SPACER:
+    case WidgetKind::WEB:
+        break;
+    }
+
+    auto* spacer = new QWidget(window);
+    spacer->setAttribute(Qt::WA_TranslucentBackground);
+    return spacer;
+}
+
+QWidget* WSS::Widget::CreateMirrorView(Window* window, const uint8_t monitorId) const {
+    auto* source = GetWebView(*m_MirrorSourceId)->findChild<MirrorSource*>();
+    auto* mirror = new MirrorView(source, monitorId, window);
+    if (source) {
+        source->AddMirror(mirror);
+    }
+    return mirror;
+}
+
+void WSS::Widget::CreateInstance(Shell& shell, const uint8_t monitorId) {
+    QScreen* screen = MonitorRegistry::GetScreen(monitorId);
+    if (!screen) {
+        WSS_ERROR("Cannot create widget '{}' on monitor ID {}: monitor is not connected.", m_Info.Name, monitorId);
+        return;
+    }
+
+    try {
+        m_Info.Monitors.push_back(ComputeMonitorInfo(monitorId));
+    } catch (const std::exception& e) {
+        WSS_ERROR("Cannot create widget '{}' on monitor ID {}: {}", m_Info.Name, monitorId, e.what());
+        return;
+    }
+    const auto& monitorInfo = m_Info.Monitors.back();
+
+    QString name = QString("wss.widget.%1.%2").arg(QString::fromStdString(m_Info.Name)).arg(monitorInfo.MonitorId);
 
-        m_Windows.emplace(monitorInfo.MonitorId, window);
-        m_Views.emplace(monitorInfo.MonitorId, webview);
+    auto* window = new QWidget;
+    window->setWindowTitle(name);
+    window->setObjectName(name);
+    window->setWindowFlag(Qt::FramelessWindowHint);
+    window->setWindowFlag(Qt::WindowStaysOnTopHint);
+    window->setAttribute(Qt::WA_TranslucentBackground);
+    window->setAttribute(Qt::WA_TransparentForMouseEvents, true);
+    window->setScreen(screen);
+    window->show();
+    window->hide();
 
-        WSS_DEBUG("Created widget '{}' on monitor ID: {}", m_Info.Name, monitorInfo.MonitorId);
+    window->clearFocus();
+    // Mirrors show the frames of the instance that renders the page instead of running it again.
+    const bool web = m_Info.Kind == WidgetKind::WEB;
+    const bool mirrored = web && m_Info.Mirror && m_MirrorSourceId && GetWebView(*m_MirrorSourceId);
+    QWidget* content;
+    if (!web) {
+        content = CreateNativeView(window);
+    } else if (mirrored) {
+        content = CreateMirrorView(window, monitorInfo.MonitorId);
+    } else {
+        content = CreateWebView(shell, window, monitorInfo.MonitorId);
     }
+
+    // Move window to monitor
+    const QRect geometry = screen->geometry();
+    window->move(geometry.x() + monitorInfo.MarginLeft, geometry.y() + monitorInfo.MarginTop);
+
+    window->setLayout(new QVBoxLayout);
+    window->layout()->setContentsMargins(0, 0, 0, 0);
+    window->layout()->addWidget(content);
+    window->resize(monitorInfo.Width, monitorInfo.Height);
+    window->setContentsMargins(0, 0, 0, 0);
+
+    QWindow* lwin = window->windowHandle();
+    if (LayerShellQt::Window* lsh = LayerShellQt::Window::get(lwin)) {
+        lsh->setScope("wss.shell");
+        lsh->setLayer(static_cast<LayerShellQt::Window::Layer>(m_Info.Layer));
+        lsh->setScreenConfiguration(LayerShellQt::Window::ScreenFromQWindow);
+
+        lsh->setMargins(
+            QMargins(monitorInfo.MarginLeft, monitorInfo.MarginTop, monitorInfo.MarginRight, monitorInfo.MarginBottom));
+        lsh->setAnchors(GetLayerAnchors());
+        lsh->setKeyboardInteractivity(LayerShellQt::Window::KeyboardInteractivityNone);
+    }
+
+    m_Windows.emplace(monitorInfo.MonitorId, window);
+    if (mirrored) {
+        m_Mirrors.emplace(monitorInfo.MonitorId, content);
+    } else if (web) {
+        m_Views.emplace(monitorInfo.MonitorId, static_cast<WebView*>(content));
+    }
+    ApplyClickRegions(monitorInfo.MonitorId);
+    ApplyRenderPolicy(monitorInfo.MonitorId);
+    ApplyVisibility(monitorInfo.MonitorId, !m_Info.DefaultHidden);
+
+    WSS_DEBUG("Created widget '{}' on monitor ID: {}{}", m_Info.Name, monitorInfo.MonitorId, mirrored ? " (mirror)" : "");
 }
 #include "widget.moc"
\ No newline at end of file
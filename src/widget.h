@@ -2,6 +2,8 @@
 #define WIDGET_H
 
 #include "modules/appd.h"
+#include "monitors.h"
+#include "util/mainthread.h"
 
 #include <QTimer>
 #include <pch.h>
@@ -37,6 +39,27 @@ enum class WidgetLayer : uint8_t {
     BACKGROUND = LayerShellQt::Window::LayerBackground,
 };
 
+/**
+ * Defines how a widget is shown and hidden.
+ */
+enum class WidgetShowMode : uint8_t {
+    // Hiding unmaps the layer surface, showing maps it again. The compositor has to configure the
+    // surface before the first frame, which adds noticeable latency.
+    REMAP,
+    // The layer surface stays mapped. Hidden means a fully transparent window without input, keyboard
+    // focus or exclusive zone. The page keeps rendering, so showing only takes a single frame.
+    KEEP_MAPPED,
+};
+
+/**
+ * Defines a visibility change requested through the dispatch sockets.
+ */
+enum class VisibilityOp : uint8_t {
+    SHOW,
+    HIDE,
+    TOGGLE,
+};
+
 /**
  * Represents the clickable region information for a widget.
  * Useful for making widgets that are larger than the clickable area to make space for popovers etc.
@@ -63,20 +86,95 @@ typedef struct {
     int MarginLeft;
     int MarginRight;
     std::unordered_map<std::string, WidgetClickRegionInfo> ClickRegionMap;
+    std::unordered_map<std::string, WidgetClickRegionInfo> OpaqueRegionMap;
 } WidgetMonitorInfo;
 
+/**
+ * Represents the dimensions of a widget as written in the configuration.
+ * The expressions (e.g. "50%", "1/3 - 20") are evaluated separately for every monitor the widget is
+ * shown on, and again whenever the geometry of that monitor changes.
+ */
+struct WidgetDimensions {
+    std::string Width;
+    std::string Height;
+    std::string MarginTop = "0";
+    std::string MarginBottom = "0";
+    std::string MarginLeft = "0";
+    std::string MarginRight = "0";
+
+    bool operator==(const WidgetDimensions&) const = default;
+};
+
+/**
+ * Represents a clickable region as written in the configuration.
+ * Like WidgetDimensions, it is evaluated per monitor.
+ */
+struct WidgetClickRegionSpec {
+    std::string Name;
+    std::string X = "0";
+    std::string Y = "0";
+    std::string Width = "0";
+    std::string Height = "0";
+
+    bool operator==(const WidgetClickRegionSpec&) const = default;
+};
+
+/**
+ * Defines what a widget shows. Everything but WEB is drawn natively, without a Chromium renderer.
+ */
+enum class WidgetKind : uint8_t {
+    WEB,    // A page of the frontend (default)
+    IMAGE,  // A still image, scaled to cover the window (e.g. wallpapers)
+    VIDEO,  // A muted, looping video, scaled to cover the window
+    QML,    // A QML scene, for simple native surfaces
+    SPACER, // Nothing, e.g. to only reserve an exclusive zone
+};
+
+/**
+ * Defines how the pages of a widget render.
+ * MaxFps and FollowRefreshRate cap requestAnimationFrame per page, which is what JS animations and most
+ * frameworks are driven by. CSS transitions and animations and compositor animations are scheduled by
+ * Chromium itself and can't be capped per page: they run at Chromium's global frame rate, which is the
+ * 60 Hz lock unless `unlock_frame_rate` in [settings] lifts it for all pages at once.
+ * There is no idle throttling beyond FreezeWhenHidden: a visible page that doesn't change doesn't
+ * produce frames to begin with.
+ */
+struct WidgetRenderPolicy {
+    int MaxFps = 0;                // 0 means no cap besides the refresh rate (if followed)
+    bool FollowRefreshRate = true; // Cap at the refresh rate of the monitor the instance is on
+    bool FreezeWhenHidden = false; // Freeze the page (timers, rAF, IPC handlers) while the widget is hidden
+
+    bool operator==(const WidgetRenderPolicy&) const = default;
+};
+
 /**
  * Represents the information required to create a widget in WSS.
+ * Monitors holds the evaluated information of the instances that currently exist, while
+ * MonitorSelectors, Dimensions and ClickRegions hold the configuration they're computed from.
+ * Templates use the same structure, their widgets are spawned and destroyed at runtime.
  */
 typedef struct {
     std::string Name;
     std::string Route;
+    WidgetKind Kind = WidgetKind::WEB;
+    std::string Source; // File shown by image, video and qml widgets
+    std::string Template; // Name of the template the widget was spawned from, empty for configured widgets
+    std::string Parent;   // Name of the widget that opened this popup, empty for everything but popups
+    std::vector<MonitorSelector> MonitorSelectors;
+    WidgetDimensions Dimensions;
+    std::vector<WidgetClickRegionSpec> ClickRegions;
+    std::vector<WidgetClickRegionSpec> OpaqueRegions; // Areas the page promises to fill with opaque pixels
     std::vector<WidgetMonitorInfo> Monitors;
     WidgetLayer Layer;
     uint8_t AnchorBitmask;
     int ExclusivityZone;
     bool Exclusivity;
     bool DefaultHidden;
+    WidgetShowMode ShowMode = WidgetShowMode::REMAP;
+    bool Mirror = false; // Render the page once and show its frames on the other monitors
+    bool Popups = false; // The page opens popups, which share its renderer process (see Shell::OpenPopup)
+    WidgetRenderPolicy Render;
+    int MaxRssMb = 0; // Renderer memory limit of the instances, 0 uses `renderer_max_rss_mb` from [settings]
     int _QT_padding = 0; // Padding for Qt compatibility, not used in GTK
 } WidgetInfo;
 
@@ -84,26 +182,91 @@ typedef struct {
  * Represents a widget in the WSS.
  * A widget can be anchored to specific sides of the screen and can have multiple windows and web
  * views associated with it.
+ * Widgets are always owned by a std::shared_ptr, so callbacks queued on the main thread can tell
+ * whether the widget still exists by the time they run.
+ * Instances come and go at runtime (monitor hotplug, config reloads), so the windows and views may
+ * only be looked up on the main thread. Methods that can be called from any thread say so, they do
+ * their lookups once they're on the main thread.
  */
-class Widget {
+class Widget : public std::enable_shared_from_this<Widget> {
     std::unordered_map<uint8_t, Window*> m_Windows;
     std::unordered_map<uint8_t, WebView*> m_Views;
+    // Instances of a mirrored widget that show the frames of m_MirrorSourceId instead of running a page.
+    std::unordered_map<uint8_t, QWidget*> m_Mirrors;
+    std::optional<uint8_t> m_MirrorSourceId;
     WidgetInfo m_Info;
 
+    // Keyboard interactivity requested per monitor, restored when a keep-mapped widget is shown again.
+    mutable std::unordered_map<uint8_t, bool> m_KeyboardInteractive;
+
+    // Set while runtime geometry changes wait for the next frame, so a burst of them results in a single commit.
+    bool m_GeometryFlushPending = false;
+
+    std::function<void(uint8_t, bool)> m_VisibilityListener;
+
     /**
-     * Dispatches a callback to the main thread.
-     * @param callback The callback function to be executed on the main thread.
+     * Evaluates the configured dimensions and click regions for the specified monitor.
+     * @param monitorId The ID of the monitor to evaluate the configuration for.
+     * @return The monitor information for the specified monitor ID.
      */
-    static void DispatchToMainThread(const std::function<void()>& callback) {
-        const auto timer = new QTimer();
-        timer->moveToThread(qApp->thread());
-        timer->setSingleShot(true);
-        QObject::connect(timer, &QTimer::timeout, [=]() {
-            callback();
-            timer->deleteLater();
-        });
-        QMetaObject::invokeMethod(timer, "start", Qt::QueuedConnection, Q_ARG(int, 0));
-    }
+    [[nodiscard]] WidgetMonitorInfo ComputeMonitorInfo(uint8_t monitorId) const;
+    /**
+     * Evaluates the dimensions and click regions of a widget configuration for the specified monitor.
+     * @throws std::invalid_argument If one of the expressions can't be evaluated.
+     */
+    [[nodiscard]] static WidgetMonitorInfo EvaluateMonitorInfo(const WidgetInfo& info, uint8_t monitorId);
+
+    /**
+     * Rebuilds the input region of the window on the specified monitor from its click regions.
+     * @param monitorId The ID of the monitor to update the input region for.
+     */
+    void ApplyClickRegions(uint8_t monitorId) const;
+
+    /**
+     * Sends the opaque regions of the window on the specified monitor to the compositor, so it can
+     * skip blending whatever is below them. Hidden windows have no opaque region.
+     * @param monitorId The ID of the monitor to update the opaque region for.
+     */
+    void ApplyOpaqueRegions(uint8_t monitorId) const;
+
+    /**
+     * Builds the layer shell anchors from the anchor bitmask of this widget.
+     */
+    [[nodiscard]] LayerShellQt::Window::Anchors GetLayerAnchors() const;
+
+    /**
+     * Shows or hides the window on the specified monitor according to the show mode of this widget.
+     * Must be called on the main thread.
+     * @param monitorId The ID of the monitor to set visibility for.
+     * @param visible Whether the window should be visible or not.
+     */
+    void ApplyVisibility(uint8_t monitorId, bool visible) const;
+
+    /**
+     * Merges runtime dimension changes into the configuration and schedules a geometry flush.
+     * Empty fields are left as they are. Must be called on the main thread.
+     * @param dimensions The changed dimensions.
+     * @return False if one of the expressions can't be evaluated, in which case nothing is changed.
+     */
+    bool MergeDimensions(const WidgetDimensions& dimensions);
+
+    /**
+     * Applies the current dimensions and exclusive zone to all windows once per frame, no matter how
+     * many changes were made in the meantime. Must be called on the main thread.
+     */
+    void ScheduleGeometryFlush();
+
+    /**
+     * Applies the render policy to the page on the specified monitor. Must be called on the main thread.
+     * @param monitorId The ID of the monitor to apply the policy on.
+     */
+    void ApplyRenderPolicy(uint8_t monitorId) const;
+
+    WebView* CreateWebView(Shell& shell, Window* window, uint8_t monitorId);
+    QWidget* CreateMirrorView(Window* window, uint8_t monitorId) const;
+    QWidget* CreateNativeView(Window* window) const;
+    void CreateInstance(Shell& shell, uint8_t monitorId);
+    void DestroyInstance(uint8_t monitorId);
 
   public:
     explicit Widget(WidgetInfo info) : m_Info(std::move(info)) { WSS_DEBUG("Creating widget: {}", m_Info.Name); }
@@ -124,14 +287,117 @@ class Widget {
         }
     }
 
+    /**
+     * Creates a window and web view on every connected monitor the widget is configured for.
+     * @param shell The shell that owns this widget.
+     */
     void Create(Shell& shell);
 
+    /**
+     * Brings the widget instances in line with the currently connected monitors.
+     * Instances on monitors that are gone (or no longer match) are destroyed and instances on newly
+     * matching monitors are created. All other instances are left untouched.
+     * Must be called on the main thread.
+     * @param shell The shell that owns this widget.
+     */
+    void SyncMonitors(Shell& shell);
+
+    /**
+     * Checks that the dimensions and click regions of a widget configuration can be evaluated on all
+     * the specified monitors, logging the error otherwise.
+     * @param info The widget configuration.
+     * @param monitorIds The monitors the widget would be shown on.
+     */
+    [[nodiscard]] static bool ValidateDimensions(const WidgetInfo& info, const std::vector<uint8_t>& monitorIds);
+
+    /**
+     * Checks whether switching to the specified configuration requires the widget to be rebuilt.
+     * That's the case when the content (route, kind or source), the monitor set, the show mode,
+     * mirroring or popup support changes, everything else can be applied in place.
+     * @param info The new widget configuration.
+     */
+    [[nodiscard]] bool RequiresRebuild(const WidgetInfo& info) const {
+        return info.Route != m_Info.Route || info.Kind != m_Info.Kind || info.Source != m_Info.Source ||
+               info.MonitorSelectors != m_Info.MonitorSelectors || info.ShowMode != m_Info.ShowMode ||
+               info.Mirror != m_Info.Mirror || info.Popups != m_Info.Popups;
+    }
+
+    /**
+     * Applies a new configuration to the existing windows in place.
+     * Updates geometry, layer, anchors, margins, exclusivity and click regions through the layer shell
+     * without touching the web views. The caller must check RequiresRebuild() first.
+     * Must be called on the main thread.
+     * @param info The new widget configuration.
+     */
+    void Reconfigure(const WidgetInfo& info);
+
+    /**
+     * Re-evaluates the dimensions, margins and click regions of the instance on the specified
+     * monitor and applies them to the existing window in place.
+     * Click regions set at runtime (through IPC) are kept.
+     * Must be called on the main thread.
+     * @param monitorId The ID of the monitor whose geometry changed.
+     */
+    void UpdateGeometry(uint8_t monitorId);
+
+    /**
+     * Changes the size of the widget at runtime, e.g. for drawers or growing notification stacks.
+     * The expressions are evaluated per monitor, like the ones in the configuration. Empty strings
+     * keep the current value. The layer surfaces are resized in place, changes made within the same
+     * frame are committed together. The configuration wins again on the next reload.
+     * Can be called from any thread.
+     * @param width The new width expression.
+     * @param height The new height expression.
+     */
+    void SetSize(const std::string& width, const std::string& height);
+
+    /**
+     * Changes the margins of the widget at runtime. Works like SetSize().
+     * Can be called from any thread.
+     */
+    void SetMargins(const std::string& top, const std::string& bottom, const std::string& left, const std::string& right);
+
+    /**
+     * Changes the exclusive zone of the widget at runtime. A zone of 0 disables exclusivity.
+     * Committed together with pending size and margin changes. Can be called from any thread.
+     * @param zone The new exclusive zone.
+     */
+    void SetExclusiveZone(int zone);
+
+    /**
+     * Gets the configuration of the widget. The identity (name, template, parent) and what requires a
+     * rebuild (see RequiresRebuild()) never changes and can be read from any thread. Everything else
+     * is changed by reloads and runtime changes, and must only be read on the main thread.
+     */
     [[nodiscard]] const WidgetInfo& GetInfo() const { return m_Info; }
 
+    /**
+     * Checks whether the widget was created at runtime (spawned from a template or opened as a popup),
+     * as opposed to configured in [widgets].
+     */
+    [[nodiscard]] bool IsSpawned() const { return !m_Info.Template.empty() || !m_Info.Parent.empty(); }
+
+    /**
+     * Checks whether the widget is a popup surface attached to another widget.
+     */
+    [[nodiscard]] bool IsPopup() const { return !m_Info.Parent.empty(); }
+
+    /**
+     * Gets the geometry of the window on the specified monitor, relative to the monitor.
+     * Computed from anchors, margins and size the same way the compositor places layer surfaces.
+     * Must be called on the main thread.
+     * @param monitorId The ID of the monitor to get the geometry for.
+     */
+    [[nodiscard]] QRect GetInstanceGeometry(uint8_t monitorId) const;
+
     [[nodiscard]] bool IsAnchoredTo(WidgetAnchor anchor) const {
         return (m_Info.AnchorBitmask & static_cast<uint8_t>(anchor)) != 0;
     }
 
+    /**
+     * Gets the window of the instance on the specified monitor, or null if there is none.
+     * Must be called on the main thread, the window can be destroyed as soon as it returns to the event loop.
+     */
     [[nodiscard]] Window* GetWindow(const uint8_t monitorId) const {
         if (const auto it = m_Windows.find(monitorId); it != m_Windows.end()) {
             return it->second;
@@ -139,6 +405,10 @@ class Widget {
         return nullptr;
     }
 
+    /**
+     * Gets the web view of the instance on the specified monitor, or null if it doesn't run a page.
+     * Must be called on the main thread.
+     */
     [[nodiscard]] WebView* GetWebView(const uint8_t monitorId) const {
         if (const auto it = m_Views.find(monitorId); it != m_Views.end()) {
             return it->second;
@@ -146,6 +416,12 @@ class Widget {
         return nullptr;
     }
 
+    /**
+     * Gets the web views of all instances that run a page, by monitor ID. Mirrors and native views are not included.
+     * Must be called on the main thread.
+     */
+    [[nodiscard]] const std::unordered_map<uint8_t, WebView*>& GetWebViews() const { return m_Views; }
+
     [[nodiscard]] bool IsValid() const { return !m_Windows.empty() || !m_Views.empty(); }
 
     /**
@@ -180,33 +456,63 @@ class Widget {
 
     /**
      * Sets the clickable region for the specified monitor ID.
-     * If the region does not exist, it will be created.
+     * If the region does not exist, it will be created. The padding of the region is the one of the
+     * widget. Can be called from any thread.
      * @param monitorId The ID of the monitor to update the clickable region for.
      * @param regionName The name of the clickable region to update.
      * @param regionInfo The new clickable region information.
      */
     void SetClickableRegion(const uint8_t monitorId, const std::string& regionName,
                             const WidgetClickRegionInfo& regionInfo) const {
-        auto& monitorInfo = const_cast<WidgetMonitorInfo&>(GetMonitorInfo(monitorId));
-        monitorInfo.ClickRegionMap[regionName] = regionInfo;
+        DispatchToMainThread([=, this, self = weak_from_this()]() {
+            // The widget might have been removed by a config reload in the meantime.
+            if (self.expired()) {
+                return;
+            }
+            const auto it = std::ranges::find_if(
+                m_Info.Monitors, [monitorId](const WidgetMonitorInfo& info) { return info.MonitorId == monitorId; });
+            if (it == m_Info.Monitors.end() || !GetWindow(monitorId)) {
+                WSS_ERROR("Attempted to update clickable region for an invalid or non-existent window on monitor ID: {}",
+                          monitorId);
+                return;
+            }
 
-        if (auto* window = GetWindow(monitorId); window) {
-            QRegion inputRegion(0, 0, 1, 1);
-            for (const auto& [name, info] : monitorInfo.ClickRegionMap) {
-                if (info.X == 0 && info.Y == 0 && info.Width == 0 && info.Height == 0) {
-                    continue;
-                }
+            auto& region = const_cast<WidgetMonitorInfo&>(*it).ClickRegionMap[regionName];
+            region = regionInfo;
+            region._QT_padding = m_Info._QT_padding;
+            ApplyClickRegions(monitorId);
+        });
+    }
 
-                const int padding = info._QT_padding > 0 ? info._QT_padding : 0;
-                const QRect rect(info.X - padding, info.Y - padding, info.Width + 2 * padding, info.Height + 2 * padding);
-                inputRegion += rect;
+    /**
+     * Sets an opaque region for the specified monitor ID, like SetClickableRegion().
+     * A region with zero size removes it. Pages should only declare areas they fill completely
+     * with opaque content, the compositor won't draw what's behind them.
+     * @param monitorId The ID of the monitor to update the opaque region for.
+     * @param regionName The name of the opaque region to update.
+     * @param regionInfo The new opaque region information.
+     */
+    void SetOpaqueRegion(const uint8_t monitorId, const std::string& regionName, const WidgetClickRegionInfo& regionInfo) const {
+        DispatchToMainThread([=, this, self = weak_from_this()]() {
+            if (self.expired()) {
+                return;
+            }
+            const auto it = std::ranges::find_if(
+                m_Info.Monitors, [monitorId](const WidgetMonitorInfo& info) { return info.MonitorId == monitorId; });
+            if (it == m_Info.Monitors.end() || !GetWindow(monitorId)) {
+                WSS_ERROR("Attempted to update opaque region for an invalid or non-existent window on monitor ID: {}",
+                          monitorId);
+                return;
             }
 
-            window->setMask(inputRegion);
-            window->update();
-        } else {
-            WSS_ERROR("Attempted to update clickable region for an invalid or non-existent window on monitor ID: {}", monitorId);
-        }
+            auto& regions = const_cast<WidgetMonitorInfo&>(*it).OpaqueRegionMap;
+            if (regionInfo.Width <= 0 || regionInfo.Height <= 0) {
+                regions.erase(regionName);
+            } else {
+                regions[regionName] = regionInfo;
+            }
+            ApplyOpaqueRegions(monitorId);
+        });
     }
 
     /**
@@ -233,69 +539,112 @@ class Widget {
     /**
      * Sets the visibility of the window for the specified monitor ID.
      * If the window is hidden and exclusivity is enabled, it will also set the exclusivity for that
-     * window.
+     * window. Can be called from any thread.
      * @param monitorId The ID of the monitor to set visibility for.
      * @param visible Whether the window should be visible or not.
      */
     void SetVisible(const uint8_t monitorId, const bool visible) const {
-        if (auto* window = GetWindow(monitorId); window) {
-            WSS_DEBUG("Window was: {} on monitor ID: {}", window->isVisible() ? "visible" : "hidden", monitorId);
-            DispatchToMainThread([=]() {
-                window->setVisible(visible);
-
-                // If the window is hidden then there's no need for exclusivity.
-                // TODO: Determine if that's ever something a user would wish to omit.
-                if (m_Info.Exclusivity) {
-                    SetExclusivity(monitorId, visible);
-                    if (m_Info.ExclusivityZone) {
-                        SetExclusivity(monitorId, visible, m_Info.ExclusivityZone);
-                    }
-                }
-            });
-            return;
-        }
-        WSS_WARN("Attempted to set visibility for an invalid or non-existent window on monitor ID: {}", monitorId);
+        DispatchToMainThread([=, this, self = weak_from_this()]() {
+            if (self.expired()) {
+                return;
+            }
+            if (!GetWindow(monitorId)) {
+                WSS_WARN("Attempted to set visibility for an invalid or non-existent window on monitor ID: {}", monitorId);
+                return;
+            }
+            ApplyVisibility(monitorId, visible);
+        });
     }
 
     /**
-     * Toggles the visibility of the window for the specified monitor ID.
+     * Toggles the visibility of the window for the specified monitor ID. Can be called from any thread.
      * @param monitorId The ID of the monitor to toggle visibility for.
      */
     void ToggleVisible(const uint8_t monitorId) const {
-        if (auto* window = GetWindow(monitorId); window) {
-            DispatchToMainThread([=]() {
-                const bool isVisible = window->isVisible();
-                window->setVisible(!isVisible);
-                WSS_DEBUG("Toggled visibility for window on monitor ID: {} to {}", monitorId, !isVisible);
-
-                if (m_Info.Exclusivity) {
-                    SetExclusivity(monitorId, !isVisible);
-                    if (m_Info.ExclusivityZone) {
-                        SetExclusivity(monitorId, !isVisible, m_Info.ExclusivityZone);
-                    }
-                }
-            });
-        } else {
-            WSS_WARN("Attempted to toggle visibility for an invalid or non-existent window on monitor ID: {}", monitorId);
-        }
+        DispatchToMainThread([=, this, self = weak_from_this()]() {
+            if (self.expired()) {
+                return;
+            }
+            if (!GetWindow(monitorId)) {
+                WSS_WARN("Attempted to toggle visibility for an invalid or non-existent window on monitor ID: {}", monitorId);
+                return;
+            }
+            const bool isVisible = IsShown(monitorId);
+            ApplyVisibility(monitorId, !isVisible);
+            WSS_DEBUG("Toggled visibility for window on monitor ID: {} to {}", monitorId, !isVisible);
+        });
     }
 
+    /**
+     * Sets the listener that is told about every visibility change, on the main thread.
+     * Must be set before Create() to also get the initial visibility of the instances.
+     * @param listener Called with the monitor ID and whether the instance is now shown.
+     */
+    void SetVisibilityListener(std::function<void(uint8_t, bool)> listener) { m_VisibilityListener = std::move(listener); }
+
+    /**
+     * Applies a visibility change right away. Unlike SetVisible() and ToggleVisible() this doesn't queue
+     * the change, so several widgets can be changed within the same main loop iteration.
+     * Must be called on the main thread.
+     * @param monitorId The ID of the monitor to change visibility on.
+     * @param op The change to apply.
+     * @param presented Called with the time in milliseconds until the first frame was presented if the
+     * window ends up shown (-1 on timeout), or with 0 right away if it ends up hidden. May be empty.
+     * @return False if the widget has no window on that monitor.
+     */
+    bool ApplyVisibilityOp(uint8_t monitorId, VisibilityOp op, std::function<void(double)> presented = nullptr) const;
+
+    /**
+     * Checks whether the window on the specified monitor is currently shown.
+     * For windows that stay mapped while hidden (see KeepsMapped()), this reflects the logical visibility.
+     * Must be called on the main thread.
+     * @param monitorId The ID of the monitor to check.
+     */
+    [[nodiscard]] bool IsShown(uint8_t monitorId) const;
+
+    /**
+     * Checks whether the window on the specified monitor stays mapped (at zero opacity) while hidden:
+     * the windows of keep-mapped widgets, and the source instance of a mirrored widget, whose page has
+     * to keep rendering for the mirrors. Must be called on the main thread.
+     * @param monitorId The ID of the monitor to check.
+     */
+    [[nodiscard]] bool KeepsMapped(uint8_t monitorId) const;
+
+    /**
+     * Measures the show latency of the window on the specified monitor: the time from this call
+     * until the compositor presented the first frame after showing it. The window should be hidden
+     * beforehand, it is left visible afterwards.
+     * @param monitorId The ID of the monitor to measure on.
+     * @param callback Called on the main thread with the latency in milliseconds, or -1 on failure or timeout.
+     */
+    void MeasureShowLatency(uint8_t monitorId, std::function<void(double)> callback) const;
+
     /**
      * Sets the keyboard interactivity for the window on the specified monitor ID.
+     * Hidden keep-mapped windows only get it once they're shown again. Can be called from any thread.
      * @param monitorId The ID of the monitor to set keyboard interactivity for.
      * @param interactive Whether the window should be interactive with keyboard input or not.
      */
     void SetKeyboardInteractivity(const uint8_t monitorId, const bool interactive) const {
-        if (auto* window = GetWindow(monitorId); window) {
+        DispatchToMainThread([=, this, self = weak_from_this()]() {
+            if (self.expired()) {
+                return;
+            }
+            m_KeyboardInteractive[monitorId] = interactive;
+            auto* window = GetWindow(monitorId);
+            if (!window) {
+                return;
+            }
             auto* layer = LayerShellQt::Window::get(window->windowHandle());
-            if (layer) {
-                layer->setKeyboardInteractivity(interactive ? LayerShellQt::Window::KeyboardInteractivityOnDemand
-                                                            : LayerShellQt::Window::KeyboardInteractivityNone);
-                window->update();
-            } else {
+            if (!layer) {
                 WSS_WARN("LayerShellQt::Window not found for monitor ID: {}", monitorId);
+                return;
             }
-        }
+            const bool applied = interactive && (!KeepsMapped(monitorId) || IsShown(monitorId));
+            layer->setKeyboardInteractivity(applied ? LayerShellQt::Window::KeyboardInteractivityOnDemand
+                                                    : LayerShellQt::Window::KeyboardInteractivityNone);
+            window->update();
+        });
     }
 
     /**
@@ -0,0 +1,230 @@
+#include "zones.h"
+
+#include "shell.h"
+#include "util/dimparser.h"
+#include "util/mainthread.h"
+
+void WSS::ZoneManager::Load(const toml::table& zones) {
+    std::vector<ZoneSpec> specs;
+    for (const auto& [zoneName, node] : zones) {
+        auto name = std::string(zoneName.str());
+        const auto info = node.as_table();
+        if (!info) {
+            WSS_ERROR("Invalid zone configuration for '{}'. Expected a table.", name);
+            continue;
+        }
+
+        const toml::array* monitors = (*info)["monitors"].as_array();
+        if (!monitors) {
+            WSS_ERROR("Monitors configuration is required for zone '{}'.", name);
+            continue;
+        }
+
+        ZoneSpec spec{.Name = name,
+                      .MonitorSelectors = MonitorSelector::FromToml(*monitors, name),
+                      .Edge = (*info)["edge"].value_or<std::string>(""),
+                      .Thickness = (*info)["thickness"].value_or<std::string>("1"),
+                      .X = (*info)["x"].value_or<std::string>("0"),
+                      .Y = (*info)["y"].value_or<std::string>("0"),
+                      .Width = (*info)["width"].value_or<std::string>("0"),
+                      .Height = (*info)["height"].value_or<std::string>("0"),
+                      .Widget = (*info)["widget"].value_or<std::string>(""),
+                      .DwellMs = (*info)["dwell_ms"].value_or<int>(0),
+                      .HideOnLeave = (*info)["hide_on_leave"].value_or<bool>(false),
+                      .LeaveDelayMs = (*info)["leave_delay_ms"].value_or<int>(0)};
+
+        if (!spec.Edge.empty() && spec.Edge != "top" && spec.Edge != "bottom" && spec.Edge != "left" &&
+            spec.Edge != "right") {
+            WSS_ERROR("Invalid edge '{}' in configuration for zone '{}'.", spec.Edge, name);
+            continue;
+        }
+
+        const std::string action = (*info)["action"].value_or<std::string>("none");
+        if (action == "show") {
+            spec.Action = ZoneAction::SHOW;
+        } else if (action == "toggle") {
+            spec.Action = ZoneAction::TOGGLE;
+        } else if (action != "none") {
+            WSS_ERROR("Invalid action '{}' in configuration for zone '{}'.", action, name);
+            continue;
+        }
+        if (spec.Action != ZoneAction::NONE && spec.Widget.empty()) {
+            WSS_ERROR("Zone '{}' has an action but no widget to apply it to.", name);
+            continue;
+        }
+
+        specs.push_back(std::move(spec));
+    }
+
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Specs = std::move(specs);
+    }
+    Rebuild();
+    WSS_INFO("Loaded {} trigger zones.", m_Specs.size());
+}
+
+void WSS::ZoneManager::Index(const size_t zoneIndex, const QRect& rect) {
+    const int left = rect.left() / CellSize - (rect.left() < 0 ? 1 : 0);
+    const int top = rect.top() / CellSize - (rect.top() < 0 ? 1 : 0);
+    const int right = rect.right() / CellSize - (rect.right() < 0 ? 1 : 0);
+    const int bottom = rect.bottom() / CellSize - (rect.bottom() < 0 ? 1 : 0);
+    for (int cellX = left; cellX <= right; cellX++) {
+        for (int cellY = top; cellY <= bottom; cellY++) {
+            m_Grid[CellKey(cellX, cellY)].push_back(zoneIndex);
+        }
+    }
+}
+
+void WSS::ZoneManager::Rebuild() {
+    using Type = DimensionParser::DimensionType;
+    std::lock_guard lock(m_Mutex);
+
+    m_Zones.clear();
+    m_Grid.clear();
+    m_Generation++;
+
+    for (size_t specIndex = 0; specIndex < m_Specs.size(); specIndex++) {
+        const auto& spec = m_Specs[specIndex];
+        for (const uint8_t monitorId : m_Shell->GetMonitors().Resolve(spec.MonitorSelectors)) {
+            const QScreen* screen = MonitorRegistry::GetScreen(monitorId);
+            if (!screen) {
+                continue;
+            }
+            const QRect screenRect = screen->geometry();
+
+            QRect rect;
+            try {
+                if (spec.Edge.empty()) {
+                    rect = QRect(DimensionParser::Parse(Type::WIDTH, spec.X, monitorId),
+                                 DimensionParser::Parse(Type::HEIGHT, spec.Y, monitorId),
+                                 DimensionParser::Parse(Type::WIDTH, spec.Width, monitorId),
+                                 DimensionParser::Parse(Type::HEIGHT, spec.Height, monitorId));
+                } else {
+                    const bool horizontal = spec.Edge == "top" || spec.Edge == "bottom";
+                    const int thickness =
+                        DimensionParser::Parse(horizontal ? Type::HEIGHT : Type::WIDTH, spec.Thickness, monitorId);
+                    if (spec.Edge == "top") {
+                        rect = QRect(0, 0, screenRect.width(), thickness);
+                    } else if (spec.Edge == "bottom") {
+                        rect = QRect(0, screenRect.height() - thickness, screenRect.width(), thickness);
+                    } else if (spec.Edge == "left") {
+                        rect = QRect(0, 0, thickness, screenRect.height());
+                    } else {
+                        rect = QRect(screenRect.width() - thickness, 0, thickness, screenRect.height());
+                    }
+                }
+            } catch (const std::exception& e) {
+                WSS_ERROR("Invalid dimensions for zone '{}': {}", spec.Name, e.what());
+                continue;
+            }
+            if (rect.isEmpty()) {
+                WSS_WARN("Zone '{}' is empty on monitor ID {}, skipping it.", spec.Name, monitorId);
+                continue;
+            }
+
+            rect.translate(screenRect.topLeft());
+            m_Zones.push_back({.SpecIndex = specIndex, .MonitorId = monitorId, .Rect = rect, .ActiveRect = rect});
+            Index(m_Zones.size() - 1, rect);
+        }
+    }
+
+    WSS_DEBUG("Indexed {} trigger zone instances in {} grid cells.", m_Zones.size(), m_Grid.size());
+}
+
+void WSS::ZoneManager::Fire(const size_t zoneIndex) {
+    auto& zone = m_Zones[zoneIndex];
+    const auto& spec = m_Specs[zone.SpecIndex];
+    zone.Fired = true;
+
+    const auto widget = m_Shell->GetWidget(spec.Widget);
+    if (!widget) {
+        WSS_WARN("Widget '{}' of zone '{}' does not exist.", spec.Widget, spec.Name);
+        return;
+    }
+    if (spec.Action == ZoneAction::SHOW) {
+        widget->SetVisible(zone.MonitorId, true);
+    } else if (spec.Action == ZoneAction::TOGGLE) {
+        widget->ToggleVisible(zone.MonitorId);
+    }
+
+    // Queued after the visibility change, so the widget is laid out by the time its area is looked up.
+    DispatchToMainThread([this, zoneIndex, generation = m_Generation, widgetName = spec.Widget,
+                          monitorId = zone.MonitorId]() {
+        const auto widget = m_Shell->GetWidget(widgetName);
+        const QScreen* screen = MonitorRegistry::GetScreen(monitorId);
+        if (!widget || !screen || !widget->IsShown(monitorId)) {
+            return;
+        }
+        const QRect widgetRect = widget->GetInstanceGeometry(monitorId).translated(screen->geometry().topLeft());
+
+        std::lock_guard lock(m_Mutex);
+        if (generation == m_Generation && m_Zones[zoneIndex].Fired) {
+            m_Zones[zoneIndex].ActiveRect = m_Zones[zoneIndex].Rect.united(widgetRect);
+        }
+    });
+}
+
+void WSS::ZoneManager::Release(Zone& zone) {
+    const auto& spec = m_Specs[zone.SpecIndex];
+    zone.Fired = false;
+    zone.LeavePending = false;
+    zone.ActiveRect = zone.Rect;
+
+    if (spec.HideOnLeave) {
+        if (const auto widget = m_Shell->GetWidget(spec.Widget)) {
+            widget->SetVisible(zone.MonitorId, false);
+        }
+    }
+}
+
+void WSS::ZoneManager::Test(const int x, const int y) {
+    const auto now = std::chrono::steady_clock::now();
+    const QPoint point(x, y);
+
+    std::lock_guard lock(m_Mutex);
+    if (m_Zones.empty()) {
+        return;
+    }
+
+    // Zones in the cell of the cursor, plus the ones that are active and might have to be left.
+    std::vector<size_t> candidates;
+    const int cellX = x / CellSize - (x < 0 ? 1 : 0);
+    const int cellY = y / CellSize - (y < 0 ? 1 : 0);
+    if (const auto it = m_Grid.find(CellKey(cellX, cellY)); it != m_Grid.end()) {
+        candidates = it->second;
+    }
+    for (size_t i = 0; i < m_Zones.size(); i++) {
+        if ((m_Zones[i].Inside || m_Zones[i].Fired) && std::ranges::find(candidates, i) == candidates.end()) {
+            candidates.push_back(i);
+        }
+    }
+
+    for (const size_t i : candidates) {
+        auto& zone = m_Zones[i];
+        const auto& spec = m_Specs[zone.SpecIndex];
+        const bool inside = (zone.Fired ? zone.ActiveRect : zone.Rect).contains(point);
+
+        if (inside && !zone.Inside) {
+            zone.Inside = true;
+            zone.EnteredAt = now;
+            zone.LeavePending = false;
+            m_Shell->GetIPC().Broadcast("zone-enter", {{"zone", spec.Name}, {"monitorId", zone.MonitorId}});
+        } else if (!inside && zone.Inside) {
+            zone.Inside = false;
+            zone.LeftAt = now;
+            m_Shell->GetIPC().Broadcast("zone-leave", {{"zone", spec.Name}, {"monitorId", zone.MonitorId}});
+            if (zone.Fired) {
+                zone.LeavePending = true;
+            }
+        }
+
+        if (zone.Inside && !zone.Fired && spec.Action != ZoneAction::NONE &&
+            now - zone.EnteredAt >= std::chrono::milliseconds(spec.DwellMs)) {
+            Fire(i);
+        }
+        if (zone.LeavePending && now - zone.LeftAt >= std::chrono::milliseconds(spec.LeaveDelayMs)) {
+            Release(zone);
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef ZONES_H
+#define ZONES_H
+
+#include <pch.h>
+
+#include <QRect>
+
+#include "monitors.h"
+
+namespace WSS {
+class Shell;
+}
+namespace WSS {
+
+/**
+ * Defines what happens to the target widget of a trigger zone when the cursor dwells in it.
+ */
+enum class ZoneAction : uint8_t {
+    NONE,   // Only zone-enter / zone-leave events are sent.
+    SHOW,   // The widget is shown on the monitor of the zone.
+    TOGGLE, // The visibility of the widget is toggled on the monitor of the zone.
+};
+
+/**
+ * Represents a trigger zone as written in the configuration.
+ * A zone is either a strip along a screen edge (`edge = "bottom"`, `thickness = "2"`) or a rectangle
+ * (`x`, `y`, `width`, `height`), evaluated per monitor like widget dimensions.
+ */
+struct ZoneSpec {
+    std::string Name;
+    std::vector<MonitorSelector> MonitorSelectors;
+    std::string Edge; // "top", "bottom", "left" or "right", empty for rectangles
+    std::string Thickness = "1";
+    std::string X = "0";
+    std::string Y = "0";
+    std::string Width = "0";
+    std::string Height = "0";
+    std::string Widget; // Target widget of the action, may be empty for event-only zones
+    ZoneAction Action = ZoneAction::NONE;
+    int DwellMs = 0;
+    bool HideOnLeave = false;
+    int LeaveDelayMs = 0;
+};
+
+/**
+ * Hit-tests cursor positions against the configured trigger zones.
+ * Instead of every page receiving the raw cursor stream and hit-testing in JS, only zone-enter and
+ * zone-leave events are broadcast, and dwell actions (showing a dock etc.) are run directly.
+ *
+ * Zones are evaluated per monitor into global rectangles and stored in a coarse grid, so a cursor
+ * sample only looks at the zones in its cell. While an action of a zone is in effect, the zone is
+ * extended by the area of its target widget, so moving the cursor from an edge strip onto the
+ * widget it opened doesn't count as leaving.
+ *
+ * Load() and Rebuild() must be called on the main thread, Test() can be called from any thread.
+ */
+class ZoneManager {
+    struct Zone {
+        size_t SpecIndex;
+        uint8_t MonitorId;
+        QRect Rect;
+        QRect ActiveRect;
+        bool Inside = false;
+        bool Fired = false;
+        std::chrono::steady_clock::time_point EnteredAt;
+        std::chrono::steady_clock::time_point LeftAt;
+        bool LeavePending = false;
+    };
+
+    static constexpr int CellSize = 256;
+
+    Shell* m_Shell = nullptr;
+
+    std::mutex m_Mutex;
+    std::vector<ZoneSpec> m_Specs;
+    std::vector<Zone> m_Zones;
+    std::unordered_map<uint64_t, std::vector<size_t>> m_Grid;
+    // Bumped on every rebuild, so queued main thread callbacks don't touch zones that were replaced.
+    uint64_t m_Generation = 0;
+
+    static uint64_t CellKey(int cellX, int cellY) {
+        return static_cast<uint64_t>(static_cast<uint32_t>(cellX)) << 32 | static_cast<uint32_t>(cellY);
+    }
+
+    void Index(size_t zoneIndex, const QRect& rect);
+    void Fire(size_t zoneIndex);
+    void Release(Zone& zone);
+
+  public:
+    explicit ZoneManager(Shell* shell) : m_Shell(shell) {
+        WSS_ASSERT(m_Shell != nullptr, "Shell instance must not be null.");
+        WSS_DEBUG("ZoneManager initialized with Shell instance.");
+    }
+
+    ZoneManager(const ZoneManager&) = delete;
+    ZoneManager(ZoneManager&&) = delete;
+    ZoneManager& operator=(ZoneManager&&) = delete;
+
+    /**
+     * Parses the [zones] table of the configuration and rebuilds the index.
+     * @param zones The zones configuration, may be empty.
+     */
+    void Load(const toml::table& zones);
+
+    /**
+     * Evaluates the zones against the currently connected monitors again.
+     * Called on hotplug and geometry changes.
+     */
+    void Rebuild();
+
+    /**
+     * Tests a cursor position (in global compositor coordinates) against the zones and sends
+     * enter / leave events and runs dwell actions as needed. Should be called for every cursor sample,
+     * also when the cursor didn't move, since dwell and leave delays are checked here too.
+     * @param x The X coordinate of the cursor.
+     * @param y The Y coordinate of the cursor.
+     */
+    void Test(int x, int y);
+
+    /**
+     * Checks whether any zones are configured, so the cursor doesn't have to be polled otherwise.
+     */
+    [[nodiscard]] bool IsEmpty() {
+        std::lock_guard lock(m_Mutex);
+        return m_Zones.empty();
+    }
+};
+} // namespace WSS
+
+#endif // ZONES_H
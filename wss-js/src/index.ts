@@ -5,14 +5,227 @@ export interface ShellMessage {
   payload: ShellPayload;
 }
 
+export interface ShellIdentity {
+  widgetName: string;
+  monitorId: number;
+}
+
 type Listener<T = any> = (message: T) => void;
 
 export class ShellIPC {
   private static instance: ShellIPC;
   private socket: WebSocket | null = null;
   private listeners: Map<string, Set<Listener>> = new Map();
+  private identity: ShellIdentity | null = null;
+
+  private constructor() {
+    // Pages pre-loaded by the shell's view pool get their identity assigned once a widget is
+    // spawned from them, so handshake again with the new identity.
+    if (typeof window !== "undefined") {
+      window.addEventListener("wss:assign", (event) => {
+        const identity = (event as CustomEvent<ShellIdentity>).detail;
+        if (this.isReady()) {
+          this.handshake(identity);
+        } else {
+          this.identity = identity;
+        }
+        const callbacks = this.listeners.get("wss-assign");
+        if (callbacks) {
+          for (const cb of callbacks) {
+            cb(identity);
+          }
+        }
+      });
+    }
+  }
 
-  private constructor() {}
+  /**
+   * Reads the identity of this page (widget name and monitor ID) from the URL.
+   * Returns null for pages that are still waiting in the shell's view pool.
+   */
+  public static getIdentity(): ShellIdentity | null {
+    const params = new URLSearchParams(window.location.search);
+    const widgetName = params.get("widgetName");
+    const monitorId = params.get("monitorId");
+    if (widgetName === null || monitorId === null) {
+      return null;
+    }
+    return { widgetName, monitorId: Number(monitorId) };
+  }
+
+  /**
+   * Identifies this page to the shell. Called again automatically when the identity changes.
+   */
+  public handshake(identity: ShellIdentity | null = ShellIPC.getIdentity()): void {
+    if (!identity) return;
+    this.identity = identity;
+    this.send("handshake", identity);
+  }
+
+  public getCurrentIdentity(): ShellIdentity | null {
+    return this.identity;
+  }
+
+  /**
+   * Subscribes this page to broadcast topics that aren't sent by default,
+   * e.g. the raw cursor stream ("mouse-position-update"). Prefer trigger zones where possible,
+   * their "zone-enter" / "zone-leave" events are always delivered.
+   */
+  public subscribe(...topics: string[]): void {
+    this.send("ipc-subscribe", { topics });
+  }
+
+  public unsubscribe(...topics: string[]): void {
+    this.send("ipc-unsubscribe", { topics });
+  }
+
+  /**
+   * Declares an area of this widget that is always fully opaque (e.g. a solid bar background), so the
+   * compositor can skip blending what's behind it. Kept until it's set again, a zero size removes it.
+   * Never declare areas with any transparency, they will show garbage behind them.
+   */
+  public setOpaqueRegion(region: { name: string; x: number; y: number; width: number; height: number }): void {
+    this.send("window-update-opaque-region", region);
+  }
+
+  /**
+   * Resizes this widget in place. Values are pixels or expressions like in the configuration
+   * ("50%", "1/3 - 20"), evaluated by the shell per monitor. Omitted values are kept.
+   * Changes sent within the same frame are applied together.
+   */
+  public setGeometry(geometry: { width?: number | string; height?: number | string }): void {
+    this.send("widget-set-geometry", geometry);
+  }
+
+  /**
+   * Changes the margins of this widget in place. Works like setGeometry().
+   */
+  public setMargins(margins: {
+    top?: number | string;
+    bottom?: number | string;
+    left?: number | string;
+    right?: number | string;
+  }): void {
+    this.send("widget-set-margins", margins);
+  }
+
+  /**
+   * Changes the exclusive zone of this widget, 0 disables exclusivity.
+   */
+  public setExclusiveZone(zone: number): void {
+    this.send("widget-set-exclusive-zone", { zone });
+  }
+
+  /**
+   * Opens a popup surface next to this widget. The rectangle is relative to this widget's window,
+   * so the widget itself can stay as small as its visible content. The popup is closed together
+   * with this widget.
+   */
+  public openPopup(popup: {
+    name: string;
+    route: string;
+    x?: number;
+    y?: number;
+    width: number;
+    height: number;
+    keyboard?: boolean;
+  }): void {
+    this.send("popup-open", popup);
+  }
+
+  /**
+   * Closes a popup opened by this widget, or this popup itself if no name is given.
+   */
+  public closePopup(name?: string): void {
+    this.send("popup-close", { name: name ?? "" });
+  }
+
+  /**
+   * Shows another widget (or this one if no name is given), on this page's monitor unless another one is given.
+   * Failures are reported as "widget-control-error" messages.
+   */
+  public showWidget(widget?: string, monitorId?: number): void {
+    this.send("widget-show", { widget, monitorId });
+  }
+
+  /**
+   * Hides a widget, see showWidget().
+   */
+  public hideWidget(widget?: string, monitorId?: number): void {
+    this.send("widget-hide", { widget, monitorId });
+  }
+
+  /**
+   * Toggles a widget, see showWidget().
+   */
+  public toggleWidget(widget?: string, monitorId?: number): void {
+    this.send("widget-toggle", { widget, monitorId });
+  }
+
+  /**
+   * Lets a widget (or this one) take keyboard input on demand, see showWidget().
+   */
+  public setKeyboardInteractivity(interactive: boolean, widget?: string, monitorId?: number): void {
+    this.send("widget-set-keyboard-interactivity", { interactive, widget, monitorId });
+  }
+
+  /**
+   * Sends a message to the pages of another widget, all of its instances unless a monitor is given.
+   * They receive it as "widget-message" with the sender's identity in "from".
+   */
+  public sendToWidget(widget: string, payload: ShellPayload, monitorId?: number): void {
+    this.send("widget-message", { widget, payload, monitorId });
+  }
+
+  /**
+   * Turns do-not-disturb on or off for all pages. While it is on, only critical notifications are
+   * delivered, the others arrive as one "notifd-notification-batch" message when it ends.
+   * Every page is told about the change through "notifd-dnd-changed".
+   */
+  public setDoNotDisturb(enabled: boolean): void {
+    this.send("notifd-set-dnd", { enabled });
+  }
+
+  /**
+   * Requests a page of the notification history, newest first. The shell answers with a
+   * "notifd-history-response" message: { items, nextCursor, apps } (or groups by app instead of
+   * items if `grouped` is set). Pass nextCursor as `before` to load the next page.
+   */
+  public requestNotificationHistory(query: {
+    before?: number;
+    limit?: number;
+    appName?: string;
+    minUrgency?: number;
+    since?: number;
+    grouped?: boolean;
+    requestId?: string;
+  } = {}): void {
+    this.send("notifd-history-request", query);
+  }
+
+  /**
+   * Deletes the notification history.
+   */
+  public clearNotificationHistory(): void {
+    this.send("notifd-history-clear", {});
+  }
+
+  /**
+   * Follows a custom topic pushed in by scripts (`wss dispatch emit <topic> <value>`).
+   * The callback gets the current value right away if there is one, and every change after that.
+   */
+  public watch<T>(topic: string, callback: Listener<T>): void {
+    this.listen<T>(`custom:${topic}`, callback);
+    this.subscribe(`custom:${topic}`);
+  }
+
+  /**
+   * Requests the renderer statistics of all widgets (PID, resident memory, CPU usage and how often
+   * an instance was recycled). The shell answers with a "stats-response" message.
+   */
+  public requestStats(): void {
+    this.send("stats-request", {});
+  }
 
   static connect(url: string): Promise<ShellIPC> {
     return new Promise((resolve, reject) => {